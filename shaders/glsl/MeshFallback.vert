@@ -2,37 +2,20 @@
 
 #extension GL_GOOGLE_include_directive : require
 #extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
 
 #include "input_structures.glsl"
 
 layout (location = 0) out vec3 outColor;
 
-struct Vertex {
-	vec3 position;
-	float uv_x;
-	vec3 normal;
-	float uv_y;
-	vec4 color;
-	vec4 tangent;
-};
-
-layout(buffer_reference, std430) readonly buffer VertexBuffer{
-	Vertex vertices[];
-};
-
-//push constants block
-layout( push_constant ) uniform constants
-{
-	mat4 render_matrix;
-	VertexBuffer vertexBuffer;
-} PushConstants;
+#include "vertex_formats.glsl"
 
 void main()
 {
-	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+	Vertex v = loadVertex(gl_VertexIndex);
 
 	vec4 position = vec4(v.position, 1.0f);
-	vec4 worldPos = PushConstants.render_matrix * position;
+	vec4 worldPos = loadWorldMatrix() * position;
 
 	gl_Position = sceneData.viewproj * worldPos;
 
@@ -78,9 +78,10 @@ void main()
 	mat3 TBN = mat3(T, B, N);
 
 	// Sample normal from normal map (stored in tangent space)
-	vec3 normalMap = texture(normalTex, inUV).xyz;
-	// Transform from [0,1] range to [-1,1] range
-	normalMap = normalMap * 2.0 - 1.0;
+	// Transform from [0,1] range to [-1,1] range, z is rebuilt from x and y
+	// so two channel (BC5) normal maps work as well
+	vec2 normalXY = texture(normalTex, inUV).xy * 2.0 - 1.0;
+	vec3 normalMap = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
 	// Transform normal from tangent space to world space
 	N = normalize(TBN * normalMap);
 
@@ -2,6 +2,7 @@
 
 #extension GL_GOOGLE_include_directive : require
 #extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
 
 #include "input_structures.glsl"
 
@@ -12,44 +13,27 @@ layout (location = 3) out vec3 outWorldPos;
 layout (location = 4) out vec3 outTangent;
 layout (location = 5) out vec3 outBitangent;
 
-struct Vertex {
-
-	vec3 position;
-	float uv_x;
-	vec3 normal;
-	float uv_y;
-	vec4 color;
-	vec4 tangent;
-}; 
-
-layout(buffer_reference, std430) readonly buffer VertexBuffer{ 
-	Vertex vertices[];
-};
-
-//push constants block
-layout( push_constant ) uniform constants
-{
-	mat4 render_matrix;
-	VertexBuffer vertexBuffer;
-} PushConstants;
+#include "vertex_formats.glsl"
 
 void main()
 {
-	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+	Vertex v = loadVertex(gl_VertexIndex);
+
+	mat4 worldMatrix = loadWorldMatrix();
 
 	vec4 position = vec4(v.position, 1.0f);
-	vec4 worldPos = PushConstants.render_matrix * position;
+	vec4 worldPos = worldMatrix * position;
 
 	gl_Position = sceneData.viewproj * worldPos;
 
 	outWorldPos = worldPos.xyz;
-	outNormal = normalize((PushConstants.render_matrix * vec4(v.normal, 0.f)).xyz);
+	outNormal = normalize((worldMatrix * vec4(v.normal, 0.f)).xyz);
 	outColor = v.color.xyz * materialData.colorFactors.xyz;
 	outUV.x = v.uv_x;
 	outUV.y = v.uv_y;
 
 	// Transform tangent to world space
-	vec3 T = normalize((PushConstants.render_matrix * vec4(v.tangent.xyz, 0.0)).xyz);
+	vec3 T = normalize((worldMatrix * vec4(v.tangent.xyz, 0.0)).xyz);
 	// Re-orthogonalize T with respect to N using Gram-Schmidt process
 	T = normalize(T - dot(T, outNormal) * outNormal);
 	// Calculate bitangent using handedness (w component)
@@ -0,0 +1,111 @@
+// Vertex layouts a mesh can be stored in, see VertexFormat in Types.hpp.
+// Requires GL_EXT_buffer_reference and GL_EXT_buffer_reference_uvec2.
+
+#define VERTEX_FORMAT_FULL 0
+#define VERTEX_FORMAT_PACKED 1
+
+struct Vertex {
+
+	vec3 position;
+	float uv_x;
+	vec3 normal;
+	float uv_y;
+	vec4 color;
+	vec4 tangent;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer{ 
+	Vertex vertices[];
+};
+
+// 20 bytes: unorm16 position, octahedral normal/tangent, half uvs
+struct PackedVertex {
+
+	uint positionXY;
+	uint positionZ; // high 16 bits: tangent handedness, 1 = negative
+	uint normal;
+	uint tangent;
+	uint uv;
+};
+
+layout(buffer_reference, std430) readonly buffer PackedVertexBuffer{ 
+	PackedVertex vertices[];
+};
+
+// optional RGBA8 color per vertex for packed meshes
+layout(buffer_reference, std430) readonly buffer ColorBuffer{ 
+	uint colors[];
+};
+
+// EXT_mesh_gpu_instancing transforms, relative to render_matrix
+layout(buffer_reference, std430) readonly buffer InstanceBuffer{ 
+	mat4 transforms[];
+};
+
+// the instances that survived culling, indexed by gl_InstanceIndex
+layout(buffer_reference, std430) readonly buffer VisibleInstanceBuffer{ 
+	uint indices[];
+};
+
+//push constants block
+layout( push_constant ) uniform constants
+{
+	mat4 render_matrix;
+	VertexBuffer vertexBuffer;
+	ColorBuffer colorBuffer;
+	vec3 positionOffset;
+	uint vertexFormat;
+	vec3 positionScale;
+	InstanceBuffer instanceBuffer; // 0 if the draw is not instanced
+	VisibleInstanceBuffer visibleInstances;
+} PushConstants;
+
+mat4 loadWorldMatrix()
+{
+	if (uvec2(PushConstants.instanceBuffer) == uvec2(0))
+	{
+		return PushConstants.render_matrix;
+	}
+
+	uint instance = PushConstants.visibleInstances.indices[gl_InstanceIndex];
+	return PushConstants.render_matrix * PushConstants.instanceBuffer.transforms[instance];
+}
+
+vec3 decodeOctahedral(uint packed)
+{
+	vec2 e = unpackSnorm2x16(packed);
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(v);
+}
+
+Vertex loadVertex(int index)
+{
+	if (PushConstants.vertexFormat == VERTEX_FORMAT_FULL)
+	{
+		return PushConstants.vertexBuffer.vertices[index];
+	}
+
+	PackedVertex p = PackedVertexBuffer(PushConstants.vertexBuffer).vertices[index];
+
+	Vertex v;
+	uvec3 q = uvec3(p.positionXY & 0xFFFFu, p.positionXY >> 16, p.positionZ & 0xFFFFu);
+	v.position = PushConstants.positionOffset + vec3(q) * PushConstants.positionScale;
+
+	v.normal = decodeOctahedral(p.normal);
+	v.tangent = vec4(decodeOctahedral(p.tangent), (p.positionZ >> 16) != 0u ? -1.0 : 1.0);
+
+	vec2 uv = unpackHalf2x16(p.uv);
+	v.uv_x = uv.x;
+	v.uv_y = uv.y;
+
+	v.color = vec4(1.0);
+	if (uvec2(PushConstants.colorBuffer) != uvec2(0))
+	{
+		v.color = unpackUnorm4x8(PushConstants.colorBuffer.colors[index]);
+	}
+	return v;
+}
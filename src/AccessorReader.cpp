@@ -0,0 +1,318 @@
+#include <AccessorReader.hpp>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstring>
+
+// SSE2 is part of every x86-64 target, other targets use the scalar loops
+#if defined(__SSE2__) || defined(_M_X64)
+#define ACCESSOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Elements of an accessor as they sit in its buffer view
+	struct StridedData
+	{
+		const std::byte* m_data {nullptr};
+		size_t           m_stride {0};
+		size_t           m_count {0};
+	};
+
+	// False for sparse accessors, ones without a buffer view and ones that
+	// don't fit their view
+	bool getStridedData(const fastgltf::Asset&    asset,
+	                    const fastgltf::Accessor& accessor,
+	                    const GltfBuffers&        buffers,
+	                    StridedData&              data)
+	{
+		if (accessor.sparse.has_value() || !accessor.bufferViewIndex.has_value())
+		{
+			return false;
+		}
+
+		const size_t viewIndex = *accessor.bufferViewIndex;
+		const size_t elementSize =
+		fastgltf::getElementByteSize(accessor.type, accessor.componentType);
+		const fastgltf::BufferView& view  = asset.bufferViews[viewIndex];
+		std::span<const std::byte>  bytes = buffers.getBufferView(asset, viewIndex);
+
+		data.m_stride = view.byteStride.has_value() ? *view.byteStride : elementSize;
+		data.m_count  = accessor.count;
+		if (data.m_stride < elementSize || accessor.byteOffset > bytes.size())
+		{
+			return false;
+		}
+		if (data.m_count > 0 &&
+		    (data.m_count - 1) * data.m_stride + elementSize >
+		    bytes.size() - accessor.byteOffset)
+		{
+			return false;
+		}
+
+		data.m_data = bytes.data() + accessor.byteOffset;
+		return true;
+	}
+
+	bool getFloatData(const fastgltf::Asset&    asset,
+	                  const fastgltf::Accessor& accessor,
+	                  const GltfBuffers&        buffers,
+	                  fastgltf::AccessorType    type,
+	                  size_t                    vertexCount,
+	                  StridedData&              data)
+	{
+		return accessor.type == type &&
+		       accessor.componentType == fastgltf::ComponentType::Float &&
+		       getStridedData(asset, accessor, buffers, data) &&
+		       data.m_count == vertexCount;
+	}
+
+	// Copy Size bytes of every element into the vertices at fieldOffset. The
+	// constant size turns each copy into one or two vector moves.
+	template <size_t Size>
+	void gatherField(const StridedData& src, std::span<Vertex> vertices, size_t fieldOffset)
+	{
+		std::byte* dst = reinterpret_cast<std::byte*>(vertices.data()) + fieldOffset;
+		for (size_t i = 0; i < src.m_count; i++)
+		{
+			memcpy(dst + i * sizeof(Vertex), src.m_data + i * src.m_stride, Size);
+		}
+	}
+
+	template <typename T>
+	void widenIndicesScalar(const std::byte* src,
+	                        size_t           first,
+	                        size_t           count,
+	                        uint32_t*        dst,
+	                        uint32_t         offset)
+	{
+		for (size_t i = first; i < count; i++)
+		{
+			T index;
+			memcpy(&index, src + i * sizeof(T), sizeof(T));
+			dst[i] = static_cast<uint32_t>(index) + offset;
+		}
+	}
+
+	void widenIndices8(const std::byte* src, size_t count, uint32_t* dst, uint32_t offset)
+	{
+		size_t i = 0;
+#ifdef ACCESSOR_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i add  = _mm_set1_epi32(static_cast<int>(offset));
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*) (src + i));
+			__m128i lo    = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi    = _mm_unpackhi_epi8(bytes, zero);
+
+			__m128i* out = (__m128i*) (dst + i);
+			_mm_storeu_si128(out + 0, _mm_add_epi32(_mm_unpacklo_epi16(lo, zero), add));
+			_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_unpackhi_epi16(lo, zero), add));
+			_mm_storeu_si128(out + 2, _mm_add_epi32(_mm_unpacklo_epi16(hi, zero), add));
+			_mm_storeu_si128(out + 3, _mm_add_epi32(_mm_unpackhi_epi16(hi, zero), add));
+		}
+#endif
+		widenIndicesScalar<uint8_t>(src, i, count, dst, offset);
+	}
+
+	void widenIndices16(const std::byte* src, size_t count, uint32_t* dst, uint32_t offset)
+	{
+		size_t i = 0;
+#ifdef ACCESSOR_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i add  = _mm_set1_epi32(static_cast<int>(offset));
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i shorts = _mm_loadu_si128((const __m128i*) (src + i * 2));
+
+			__m128i* out = (__m128i*) (dst + i);
+			_mm_storeu_si128(out + 0, _mm_add_epi32(_mm_unpacklo_epi16(shorts, zero), add));
+			_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_unpackhi_epi16(shorts, zero), add));
+		}
+#endif
+		widenIndicesScalar<uint16_t>(src, i, count, dst, offset);
+	}
+
+	void widenIndices32(const std::byte* src, size_t count, uint32_t* dst, uint32_t offset)
+	{
+		size_t i = 0;
+#ifdef ACCESSOR_SSE2
+		const __m128i add = _mm_set1_epi32(static_cast<int>(offset));
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i ints = _mm_loadu_si128((const __m128i*) (src + i * 4));
+			_mm_storeu_si128((__m128i*) (dst + i), _mm_add_epi32(ints, add));
+		}
+#endif
+		widenIndicesScalar<uint32_t>(src, i, count, dst, offset);
+	}
+} // namespace
+
+bool accessorutil::readIndices(const fastgltf::Asset&    asset,
+                               const fastgltf::Accessor& accessor,
+                               const GltfBuffers&        buffers,
+                               std::span<uint32_t>       indices,
+                               uint32_t                  offset)
+{
+	StridedData src;
+	if (accessor.type != fastgltf::AccessorType::Scalar ||
+	    !getStridedData(asset, accessor, buffers, src) ||
+	    src.m_count != indices.size())
+	{
+		return false;
+	}
+
+	// index buffer views are tightly packed
+	const size_t indexSize = fastgltf::getComponentByteSize(accessor.componentType);
+	if (src.m_stride != indexSize)
+	{
+		return false;
+	}
+
+	switch (accessor.componentType)
+	{
+		case fastgltf::ComponentType::UnsignedByte:
+			widenIndices8(src.m_data, src.m_count, indices.data(), offset);
+			return true;
+		case fastgltf::ComponentType::UnsignedShort:
+			widenIndices16(src.m_data, src.m_count, indices.data(), offset);
+			return true;
+		case fastgltf::ComponentType::UnsignedInt:
+			widenIndices32(src.m_data, src.m_count, indices.data(), offset);
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool accessorutil::readPositions(const fastgltf::Asset&    asset,
+                                 const fastgltf::Accessor& accessor,
+                                 const GltfBuffers&        buffers,
+                                 std::span<Vertex>         vertices,
+                                 glm::vec3&                minPosition,
+                                 glm::vec3&                maxPosition)
+{
+	StridedData src;
+	if (!getFloatData(
+	    asset, accessor, buffers, fastgltf::AccessorType::Vec3, vertices.size(), src))
+	{
+		return false;
+	}
+
+	minPosition = glm::vec3(FLT_MAX);
+	maxPosition = glm::vec3(-FLT_MAX);
+
+	size_t i = 0;
+#ifdef ACCESSOR_SSE2
+	// the rest of the vertex, as the scalar loop below writes it
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 normal  = _mm_set_ps(0.f, 0.f, 0.f, 1.f); // and m_uv_y
+	const __m128 color   = _mm_set1_ps(1.f);
+	const __m128 tangent = _mm_setzero_ps();
+
+	__m128 minV = _mm_set1_ps(FLT_MAX);
+	__m128 maxV = _mm_set1_ps(-FLT_MAX);
+
+	// a 16 byte load of any element but the last stays inside the view, the
+	// fourth lane is masked to become m_uv_x
+	for (; i + 1 < src.m_count; i++)
+	{
+		__m128 position = _mm_and_ps(
+		_mm_loadu_ps((const float*) (src.m_data + i * src.m_stride)), xyzMask);
+		minV = _mm_min_ps(minV, position);
+		maxV = _mm_max_ps(maxV, position);
+
+		float* out = reinterpret_cast<float*>(&vertices[i]);
+		_mm_storeu_ps(out + 0, position);
+		_mm_storeu_ps(out + 4, normal);
+		_mm_storeu_ps(out + 8, color);
+		_mm_storeu_ps(out + 12, tangent);
+	}
+
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, minV);
+	minPosition = glm::vec3(lanes[0], lanes[1], lanes[2]);
+	_mm_store_ps(lanes, maxV);
+	maxPosition = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#endif
+	for (; i < src.m_count; i++)
+	{
+		Vertex& vertex = vertices[i];
+		memcpy(&vertex.m_position, src.m_data + i * src.m_stride, sizeof(glm::vec3));
+		vertex.m_normal  = {1, 0, 0};
+		vertex.m_color   = glm::vec4 {1.f};
+		vertex.m_uv_x    = 0;
+		vertex.m_uv_y    = 0;
+		vertex.m_tangent = {0, 0, 0, 0};
+
+		minPosition = glm::min(minPosition, vertex.m_position);
+		maxPosition = glm::max(maxPosition, vertex.m_position);
+	}
+	return true;
+}
+
+bool accessorutil::readNormals(const fastgltf::Asset&    asset,
+                               const fastgltf::Accessor& accessor,
+                               const GltfBuffers&        buffers,
+                               std::span<Vertex>         vertices)
+{
+	StridedData src;
+	if (!getFloatData(
+	    asset, accessor, buffers, fastgltf::AccessorType::Vec3, vertices.size(), src))
+	{
+		return false;
+	}
+	gatherField<sizeof(glm::vec3)>(src, vertices, offsetof(Vertex, m_normal));
+	return true;
+}
+
+bool accessorutil::readTexcoords(const fastgltf::Asset&    asset,
+                                 const fastgltf::Accessor& accessor,
+                                 const GltfBuffers&        buffers,
+                                 std::span<Vertex>         vertices)
+{
+	StridedData src;
+	if (!getFloatData(
+	    asset, accessor, buffers, fastgltf::AccessorType::Vec2, vertices.size(), src))
+	{
+		return false;
+	}
+
+	// the two halves of the uv are split across the vertex
+	gatherField<sizeof(float)>(src, vertices, offsetof(Vertex, m_uv_x));
+	src.m_data += sizeof(float);
+	gatherField<sizeof(float)>(src, vertices, offsetof(Vertex, m_uv_y));
+	return true;
+}
+
+bool accessorutil::readColors(const fastgltf::Asset&    asset,
+                              const fastgltf::Accessor& accessor,
+                              const GltfBuffers&        buffers,
+                              std::span<Vertex>         vertices)
+{
+	StridedData src;
+	if (!getFloatData(
+	    asset, accessor, buffers, fastgltf::AccessorType::Vec4, vertices.size(), src))
+	{
+		return false;
+	}
+	gatherField<sizeof(glm::vec4)>(src, vertices, offsetof(Vertex, m_color));
+	return true;
+}
+
+bool accessorutil::readTangents(const fastgltf::Asset&    asset,
+                                const fastgltf::Accessor& accessor,
+                                const GltfBuffers&        buffers,
+                                std::span<Vertex>         vertices)
+{
+	StridedData src;
+	if (!getFloatData(
+	    asset, accessor, buffers, fastgltf::AccessorType::Vec4, vertices.size(), src))
+	{
+		return false;
+	}
+	gatherField<sizeof(glm::vec4)>(src, vertices, offsetof(Vertex, m_tangent));
+	return true;
+}
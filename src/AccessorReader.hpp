@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GltfBuffers.hpp>
+#include <Types.hpp>
+
+#include <cstdint>
+#include <span>
+
+#include <fastgltf/core.hpp>
+
+// Bulk readers for the accessors of mesh primitives, copying straight from
+// the buffer views into the vertex and index arrays instead of going through
+// a callback per element. Each returns false if the accessor needs more than
+// a plain copy (sparse, normalized or quantized data, a count that doesn't
+// match); the caller then falls back to fastgltf::iterateAccessor.
+namespace accessorutil
+{
+	// Widen 8, 16 or 32 bit indices to 32 bits and add offset to each
+	bool readIndices(const fastgltf::Asset&    asset,
+	                 const fastgltf::Accessor& accessor,
+	                 const GltfBuffers&        buffers,
+	                 std::span<uint32_t>       indices,
+	                 uint32_t                  offset);
+
+	// Float positions, written along with the default of every other
+	// attribute so this has to come first. Also returns their min/max.
+	bool readPositions(const fastgltf::Asset&    asset,
+	                   const fastgltf::Accessor& accessor,
+	                   const GltfBuffers&        buffers,
+	                   std::span<Vertex>         vertices,
+	                   glm::vec3&                minPosition,
+	                   glm::vec3&                maxPosition);
+
+	// Float attributes into vertices that already hold their positions
+	bool readNormals(const fastgltf::Asset&    asset,
+	                 const fastgltf::Accessor& accessor,
+	                 const GltfBuffers&        buffers,
+	                 std::span<Vertex>         vertices);
+	bool readTexcoords(const fastgltf::Asset&    asset,
+	                   const fastgltf::Accessor& accessor,
+	                   const GltfBuffers&        buffers,
+	                   std::span<Vertex>         vertices);
+	bool readColors(const fastgltf::Asset&    asset,
+	                const fastgltf::Accessor& accessor,
+	                const GltfBuffers&        buffers,
+	                std::span<Vertex>         vertices);
+	bool readTangents(const fastgltf::Asset&    asset,
+	                  const fastgltf::Accessor& accessor,
+	                  const GltfBuffers&        buffers,
+	                  std::span<Vertex>         vertices);
+} // namespace accessorutil
@@ -18,6 +18,7 @@
 
 #include <VkBootstrap.h>
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -95,6 +96,12 @@ void AgniEngine::cleanup()
 {
 	if (m_isInitialized)
 	{
+		// a stress run still uploads from its own threads
+		if (m_uploadStressRun.valid())
+		{
+			m_uploadStressRun.wait();
+		}
+
 		vkDeviceWaitIdle(m_device);
 
 		for (int i = 0; i < FRAME_OVERLAP; i++)
@@ -151,6 +158,7 @@ void AgniEngine::draw()
 
 	getCurrentFrame().m_deletionQueue.flush();
 	getCurrentFrame().m_frameDescriptors.clearPools(m_device);
+	m_resourceManager.getUploadQueue().collect();
 	VK_CHECK(vkResetFences(m_device, 1, &getCurrentFrame().m_renderFence));
 
 	// request image from the swapchain
@@ -201,7 +209,19 @@ void AgniEngine::draw()
 	VkSemaphoreSubmitInfo signalInfo = vkinit::semaphoreSubmitInfo(
 	VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, getCurrentFrame().m_renderSemaphore);
 
-	VkSubmitInfo2 submit = vkinit::submitInfo(&cmdinfo, &signalInfo, &waitInfo);
+	// uploads queued since the last frame are submitted now, the frame reads
+	// their buffers and images only once they are done
+	UploadQueue& uploadQueue = m_resourceManager.getUploadQueue();
+	uploadQueue.flush();
+	VkSemaphoreSubmitInfo waitInfos[] = {
+	waitInfo, uploadQueue.getWaitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)};
+
+	VkSubmitInfo2 submit = vkinit::submitInfo(&cmdinfo, &signalInfo, waitInfos);
+	submit.waitSemaphoreInfoCount = 2;
+
+	// the graphics queue is shared with uploads and immediate submits of
+	// other threads
+	auto queueLock = uploadQueue.lockQueues();
 
 	// submit command buffer to the queue and execute it.
 	//  _renderFence will now block until the graphic commands finish execution
@@ -226,6 +246,7 @@ void AgniEngine::draw()
 	presentInfo.pImageIndices = &swapchainImageIndex;
 
 	VkResult presentResult = vkQueuePresentKHR(m_graphicsQueue, &presentInfo);
+	queueLock.unlock();
 	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		m_swapchainManager.requestResize();
@@ -300,6 +321,9 @@ void AgniEngine::run()
 			resizeSwapchain();
 		}
 
+		// pick up scenes that were saved since they were loaded
+		m_assetLoader.reloadChangedScenes(this, m_renderer.getLoadedScenes());
+
 		// imgui new frame
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplSDL3_NewFrame();
@@ -315,12 +339,81 @@ void AgniEngine::run()
 			ImGui::Text("update time %f ms", m_renderer.getStats().m_sceneUpdateTime);
 			ImGui::Text("triangles %i", m_renderer.getStats().m_triangleCount);
 			ImGui::Text("draws %i", m_renderer.getStats().m_drawcallCount);
+			ImGui::Text("meshlets %i", m_renderer.getStats().m_meshletCount);
+			ImGui::Text("lod surfaces %i", m_renderer.getStats().m_lodSurfaceCount);
+			ImGui::Text("instances %i", m_renderer.getStats().m_instanceCount);
+
+			const StagingStats staging =
+			m_resourceManager.getUploadQueue().getStagingStats();
+			ImGui::Text("staging %.1f / %.1f MB (peak %.1f)",
+			            staging.m_ringUsed / (1024.f * 1024.f),
+			            staging.m_ringSize / (1024.f * 1024.f),
+			            staging.m_peakRingUsed / (1024.f * 1024.f));
+			ImGui::Text("staging allocations %llu (dedicated %llu)",
+			            (unsigned long long) staging.m_ringAllocations,
+			            (unsigned long long) staging.m_dedicatedAllocations);
+			ImGui::Text("staging stalls %llu", (unsigned long long) staging.m_stalls);
+
+			const SharedResourceStats shared =
+			m_resourceManager.getSharedResourceStats();
+			ImGui::Text("shared images %llu / %llu",
+			            (unsigned long long) shared.m_imageHits,
+			            (unsigned long long) shared.m_imageRequests);
+			ImGui::Text("shared meshes %llu / %llu",
+			            (unsigned long long) shared.m_meshHits,
+			            (unsigned long long) shared.m_meshRequests);
+			ImGui::Text("shared saves %.1f MB", shared.m_bytesSaved / (1024.f * 1024.f));
+
+			const GeometryArenaStats geometry =
+			m_resourceManager.getGeometryArena().getStats();
+			ImGui::Text("geometry %.1f / %.1f MB in %u pages",
+			            geometry.m_usedBytes / (1024.f * 1024.f),
+			            geometry.m_capacity / (1024.f * 1024.f),
+			            geometry.m_pageCount);
+			ImGui::Text("geometry ranges %llu",
+			            (unsigned long long) geometry.m_allocationCount);
+
+			// thousands of small uploads from every core at once, run off the
+			// render thread so frames keep coming while it waits on the GPU
+			if (m_uploadStressRun.valid() &&
+			    m_uploadStressRun.wait_for(std::chrono::seconds(0)) ==
+			    std::future_status::ready)
+			{
+				m_uploadStress = m_uploadStressRun.get();
+			}
+			const bool stressRunning = m_uploadStressRun.valid();
+			ImGui::BeginDisabled(stressRunning);
+			if (ImGui::Button(stressRunning ? "Upload stress test running..."
+			                                : "Upload stress test"))
+			{
+				m_uploadStressRun = std::async(
+				std::launch::async,
+				uploadstress::run,
+				std::ref(m_resourceManager),
+				std::max(2u, std::thread::hardware_concurrency()),
+				1024u);
+			}
+			ImGui::EndDisabled();
+			if (m_uploadStress.m_resourceCount > 0)
+			{
+				ImGui::Text("stress %u resources on %u threads in %.1f ms",
+				            m_uploadStress.m_resourceCount,
+				            m_uploadStress.m_threadCount,
+				            m_uploadStress.m_totalTime);
+				ImGui::Text("stress %.0f resources/s, %.1f MB/s",
+				            m_uploadStress.m_resourceCount * 1000.f /
+				            m_uploadStress.m_totalTime,
+				            m_uploadStress.m_bytes / (1024.f * 1024.f) * 1000.f /
+				            m_uploadStress.m_totalTime);
+			}
 		}
 		ImGui::End();
 
 		if (ImGui::Begin("background"))
 		{
 			ImGui::SliderFloat("Render Scale", &m_renderer.getRenderScale(), 0.3f, 1.f);
+			ImGui::Checkbox("Meshlet Culling", &m_renderer.getMeshletCulling());
+			ImGui::SliderFloat("LOD Pixel Error", &m_renderer.getLodPixelError(), 0.f, 16.f);
 
 			// MSAA sample count selector
 			const char* msaaSampleNames[] = {
@@ -411,7 +504,9 @@ void AgniEngine::initVulkan()
 
 	SDL_Vulkan_CreateSurface(m_window, m_instance, nullptr, &m_surface);
 
-	VkPhysicalDeviceFeatures deviceFeatures {.sampleRateShading = VK_TRUE};
+	// multi draw indirect for the culled meshlet draws
+	VkPhysicalDeviceFeatures deviceFeatures {.sampleRateShading = VK_TRUE,
+	                                         .multiDrawIndirect = VK_TRUE};
 
 
 	// vulkan 1.3 features
@@ -425,6 +520,8 @@ void AgniEngine::initVulkan()
 	.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
 	features12.bufferDeviceAddress = true;
 	features12.descriptorIndexing  = true;
+	features12.drawIndirectCount   = true;
+	features12.timelineSemaphore   = true;
 
 	// use vkbootstrap to select a gpu.
 	vkb::PhysicalDeviceSelector selector {vkbInstance};
@@ -436,6 +533,15 @@ void AgniEngine::initVulkan()
 	                                     .select()
 	                                     .value();
 
+	// lets baked geometry be copied straight out of mapped cache files
+	const bool externalMemoryHost = physicalDevice.enable_extension_if_present(
+	VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+
+	// BC formats for compressed textures, without them imported textures
+	// stay RGBA8
+	const bool textureCompressionBC = physicalDevice.enable_features_if_present(
+	VkPhysicalDeviceFeatures {.textureCompressionBC = VK_TRUE});
+
 	// create the final vulkan device
 	vkb::DeviceBuilder deviceBuilder {physicalDevice};
 
@@ -452,8 +558,23 @@ void AgniEngine::initVulkan()
 	m_graphicsQueueFamily =
 	vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// a transfer-only family copies next to rendering, otherwise uploads
+	// share the graphics queue
+	auto transferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+	if (transferQueue.has_value())
+	{
+		m_transferQueue = transferQueue.value();
+		m_transferQueueFamily =
+		vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+	}
+	else
+	{
+		m_transferQueue       = m_graphicsQueue;
+		m_transferQueueFamily = m_graphicsQueueFamily;
+	}
+
 	// initializing ResourceManager
-	m_resourceManager.init(m_instance, m_chosenGPU, m_device, m_graphicsQueue, m_graphicsQueueFamily);
+	m_resourceManager.init(m_instance, m_chosenGPU, m_device, m_graphicsQueue, m_graphicsQueueFamily, m_transferQueue, m_transferQueueFamily, externalMemoryHost, textureCompressionBC);
 }
 
 void AgniEngine::initSwapchain()
@@ -543,7 +664,11 @@ void AgniEngine::endRenderDocFrameCapture()
 
 void AgniEngine::resizeSwapchain()
 {
+	// other threads may be submitting uploads, waiting for the device needs
+	// every queue
+	std::unique_lock queueLock = m_resourceManager.getUploadQueue().lockQueues();
 	vkDeviceWaitIdle(m_device);
+	queueLock.unlock();
 
 	// Destroy and rebuild pipelines with new MSAA settings
 	m_assetLoader.getMaterialSystem().clearResources(m_device);
@@ -554,7 +679,10 @@ void AgniEngine::resizeSwapchain()
 	m_windowExtent.width  = w;
 	m_windowExtent.height = h;
 
+	// the swapchain waits for the device as well
+	queueLock.lock();
 	m_swapchainManager.resize(m_chosenGPU, m_device, m_surface, m_windowExtent);
+	queueLock.unlock();
 
 	// Resize renderer (recreates render targets with new extent and MSAA settings)
 	m_renderer.resize(m_windowExtent, m_renderer.getMsaaSamples());
@@ -723,20 +851,90 @@ void AgniEngine::initDefaultData()
 	m_skybox.init(this, cubemapFaces);
 }
 
+// Coarsest LOD of a surface whose error, projected from the closest point
+// of its bounding sphere, stays within the pixel budget. Null for the full
+// surface.
+static const SurfaceLod* selectLod(const GeoSurface&  surface,
+                                   const glm::mat4&   transform,
+                                   const DrawContext& ctx)
+{
+	if (surface.m_lodCount == 0 || ctx.m_lodScale <= 0.f)
+	{
+		return nullptr;
+	}
+
+	float scale = std::max({glm::length(glm::vec3(transform[0])),
+	                        glm::length(glm::vec3(transform[1])),
+	                        glm::length(glm::vec3(transform[2]))});
+	glm::vec3 center =
+	glm::vec3(transform * glm::vec4(surface.m_bounds.m_origin, 1.f));
+	float distance = glm::length(center - ctx.m_cameraPosition) -
+	                 surface.m_bounds.m_sphereRadius * scale;
+	if (distance <= 0.f)
+	{
+		return nullptr;
+	}
+
+	const SurfaceLod* selected = nullptr;
+	for (uint32_t l = 0; l < surface.m_lodCount; l++)
+	{
+		float pixels =
+		surface.m_lods[l].m_error * scale / distance * ctx.m_lodScale;
+		if (pixels > ctx.m_lodPixelError)
+		{
+			break;
+		}
+		selected = &surface.m_lods[l];
+	}
+	return selected;
+}
+
 void MeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
 {
 	glm::mat4 nodeMatrix = topMatrix * m_worldTransform;
 
 	for (auto& s : m_mesh->m_surfaces)
 	{
+		// shared primitives live in the buffers of another mesh
+		const GPUMeshBuffers& buffers =
+		s.m_sourceMesh ? s.m_sourceMesh->m_meshBuffers : m_mesh->m_meshBuffers;
+
 		RenderObject def;
-		def.m_indexCount  = s.m_count;
-		def.m_firstIndex  = s.m_startIndex;
-		def.m_indexBuffer = m_mesh->m_meshBuffers.m_indexBuffer.m_buffer;
-		def.m_material    = &s.m_material->m_data;
-		def.m_bounds      = s.m_bounds;
-		def.m_transform   = nodeMatrix;
-		def.m_vertexBufferAddress = m_mesh->m_meshBuffers.m_vertexBufferAddress;
+		def.m_indexCount           = s.m_count;
+		def.m_firstIndex           = buffers.m_firstIndex + s.m_startIndex;
+		def.m_baseIndex            = buffers.m_firstIndex;
+		def.m_indexBuffer          = buffers.m_indexAllocation.m_buffer;
+		def.m_indexType            = buffers.m_indexType;
+		def.m_material             = &s.m_material->m_data;
+		def.m_bounds               = s.m_bounds;
+		def.m_transform            = nodeMatrix;
+		def.m_vertexBufferAddress  = buffers.m_vertexBufferAddress;
+		def.m_vertexFormat         = buffers.m_vertexFormat;
+		def.m_colorBufferAddress   = buffers.m_colorBufferAddress;
+		def.m_positionScale        = buffers.m_positionScale;
+		def.m_positionOffset       = buffers.m_positionOffset;
+		def.m_meshletBufferAddress = buffers.m_meshletBufferAddress;
+		def.m_firstMeshlet         = s.m_firstMeshlet;
+		def.m_meshletCount         = s.m_meshletCount;
+
+		// instanced surfaces are culled and drawn per instance by the
+		// renderer, without meshlet culling or LODs
+		if (!m_instances.empty())
+		{
+			def.m_instanceCount         = static_cast<uint32_t>(m_instances.size());
+			def.m_instanceTransforms    = m_instances.data();
+			def.m_instanceBufferAddress = m_instanceBufferAddress;
+			def.m_meshletCount          = 0;
+		}
+		// LODs share the buffers, only the ranges change
+		else if (const SurfaceLod* lod = selectLod(s, nodeMatrix, ctx))
+		{
+			def.m_indexCount   = lod->m_count;
+			def.m_firstIndex   = buffers.m_firstIndex + lod->m_startIndex;
+			def.m_firstMeshlet = lod->m_firstMeshlet;
+			def.m_meshletCount = lod->m_meshletCount;
+			ctx.m_lodSurfaceCount++;
+		}
 
 		if (s.m_material->m_data.m_passType == MaterialPass::Transparent)
 		{
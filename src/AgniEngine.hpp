@@ -14,9 +14,11 @@
 #include <SwapchainManager.hpp>
 #include <Texture.hpp>
 #include <Types.hpp>
+#include <UploadStressTest.hpp>
 
 #include <deque>
 #include <functional>
+#include <future>
 #include <vector>
 
 constexpr uint32_t FRAME_OVERLAP = 2;
@@ -50,8 +52,22 @@ public:
 		return m_mesh;
 	}
 
+	// EXT_mesh_gpu_instancing transforms relative to the node, empty if the
+	// mesh is drawn once
+	std::vector<glm::mat4>& getInstances()
+	{
+		return m_instances;
+	}
+	// the same transforms on the GPU, read by the vertex shader
+	VkDeviceAddress& getInstanceBufferAddress()
+	{
+		return m_instanceBufferAddress;
+	}
+
 protected:
 	std::shared_ptr<MeshAsset> m_mesh;
+	std::vector<glm::mat4>     m_instances;
+	VkDeviceAddress            m_instanceBufferAddress {0};
 };
 
 class AgniEngine
@@ -102,6 +118,10 @@ public:
 	VkQueue  m_graphicsQueue;
 	uint32_t m_graphicsQueueFamily;
 
+	// dedicated transfer queue for uploads, the graphics queue without one
+	VkQueue  m_transferQueue;
+	uint32_t m_transferQueueFamily;
+
 	DescriptorAllocatorGrowable m_globalDescriptorAllocator;
 
 	Camera m_mainCamera;
@@ -131,6 +151,11 @@ public:
 private:
 	RENDERDOC_API_1_1_2* m_rdocAPI = NULL;
 
+	// last run of the upload stress test, shown in the stats window, and
+	// the one still running off the render thread
+	UploadStressResult              m_uploadStress;
+	std::future<UploadStressResult> m_uploadStressRun;
+
 	void initVulkan();
 	void initSwapchain();
 	void initCommands();
@@ -0,0 +1,163 @@
+#include <AllocationStats.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> g_allocationCount {0};
+	std::atomic<uint64_t> g_allocatedBytes {0};
+
+	void* allocate(size_t size)
+	{
+		g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+		g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+		return std::malloc(size > 0 ? size : 1);
+	}
+
+	void* allocateAligned(size_t size, std::align_val_t alignment)
+	{
+		g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+		g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+		const size_t align = static_cast<size_t>(alignment);
+		size               = size > 0 ? size : 1;
+#ifdef _MSC_VER
+		return _aligned_malloc(size, align);
+#else
+		// aligned_alloc wants the size to be a multiple of the alignment
+		return std::aligned_alloc(align, (size + align - 1) & ~(align - 1));
+#endif
+	}
+
+	void freeAligned(void* ptr)
+	{
+#ifdef _MSC_VER
+		_aligned_free(ptr);
+#else
+		std::free(ptr);
+#endif
+	}
+} // namespace
+
+uint64_t allocstats::getAllocationCount()
+{
+	return g_allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t allocstats::getAllocatedBytes()
+{
+	return g_allocatedBytes.load(std::memory_order_relaxed);
+}
+
+// replacements of the global allocation functions, all of them so every
+// new is paired with the matching delete
+
+void* operator new(size_t size)
+{
+	if (void* ptr = allocate(size))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (void* ptr = allocateAligned(size, alignment))
+	{
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return allocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	freeAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+	freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+	freeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	freeAligned(ptr);
+}
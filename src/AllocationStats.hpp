@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts every allocation made through the global operator new, on all
+// threads, so the loader can report how many heap allocations an import
+// takes. The counters only ever go up; take the difference around the work
+// being measured.
+namespace allocstats
+{
+	uint64_t getAllocationCount();
+	uint64_t getAllocatedBytes();
+} // namespace allocstats
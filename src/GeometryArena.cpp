@@ -0,0 +1,163 @@
+#include <GeometryArena.hpp>
+
+#include <VulkanTools.hpp>
+
+#include <algorithm>
+
+void GeometryArena::init(VkDevice device, VmaAllocator allocator)
+{
+	m_device    = device;
+	m_allocator = allocator;
+}
+
+void GeometryArena::cleanup()
+{
+	for (Page& page : m_pages)
+	{
+		if (page.m_block != VK_NULL_HANDLE)
+		{
+			// meshes still alive at shutdown don't free their ranges
+			vmaClearVirtualBlock(page.m_block);
+			destroyPage(page);
+		}
+	}
+	m_pages.clear();
+	m_stats = {};
+}
+
+GeometryAllocation GeometryArena::allocate(Kind kind, VkDeviceSize size)
+{
+	std::lock_guard lock(m_mutex);
+
+	VmaVirtualAllocationCreateInfo allocInfo = {};
+	allocInfo.size      = size;
+	allocInfo.alignment = kind == Kind::Index ? INDEX_ALIGNMENT : STORAGE_ALIGNMENT;
+
+	GeometryAllocation allocation;
+	auto allocateFrom = [&](uint32_t index)
+	{
+		Page& page = m_pages[index];
+		if (page.m_block == VK_NULL_HANDLE || page.m_kind != kind ||
+		    vmaVirtualAllocate(
+		    page.m_block, &allocInfo, &allocation.m_allocation, &allocation.m_offset) !=
+		    VK_SUCCESS)
+		{
+			return false;
+		}
+		allocation.m_buffer = page.m_buffer.m_buffer;
+		allocation.m_page   = index;
+		return true;
+	};
+
+	// first fit over the pages, a new one if none has room
+	bool found = false;
+	for (uint32_t i = 0; i < m_pages.size() && !found; i++)
+	{
+		found = allocateFrom(i);
+	}
+	if (!found)
+	{
+		const VkDeviceSize pageSize =
+		kind == Kind::Index ? INDEX_PAGE_SIZE : STORAGE_PAGE_SIZE;
+		found = allocateFrom(createPage(kind, std::max(size, pageSize)));
+	}
+
+	if (found)
+	{
+		m_stats.m_allocationCount++;
+		m_stats.m_usedBytes += size;
+	}
+	return allocation;
+}
+
+void GeometryArena::free(const GeometryAllocation& allocation)
+{
+	if (allocation.m_allocation == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::lock_guard lock(m_mutex);
+	Page&           page = m_pages[allocation.m_page];
+
+	VmaVirtualAllocationInfo info;
+	vmaGetVirtualAllocationInfo(page.m_block, allocation.m_allocation, &info);
+	vmaVirtualFree(page.m_block, allocation.m_allocation);
+
+	m_stats.m_allocationCount--;
+	m_stats.m_usedBytes -= info.size;
+
+	// regular pages stay for the next scene, oversized ones go with their mesh
+	const VkDeviceSize pageSize =
+	page.m_kind == Kind::Index ? INDEX_PAGE_SIZE : STORAGE_PAGE_SIZE;
+	if (page.m_size > pageSize && vmaIsVirtualBlockEmpty(page.m_block))
+	{
+		destroyPage(page);
+	}
+}
+
+uint32_t GeometryArena::createPage(Kind kind, VkDeviceSize size)
+{
+	auto slot = std::find_if(m_pages.begin(),
+	                         m_pages.end(),
+	                         [](const Page& page)
+	                         { return page.m_block == VK_NULL_HANDLE; });
+	const uint32_t index = static_cast<uint32_t>(slot - m_pages.begin());
+	if (slot == m_pages.end())
+	{
+		m_pages.emplace_back();
+	}
+
+	Page& page  = m_pages[index];
+	page.m_kind = kind;
+	page.m_size = size;
+
+	VkBufferCreateInfo bufferInfo = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+	bufferInfo.size               = size;
+	bufferInfo.usage =
+	kind == Kind::Index
+	? VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+	: VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+	  VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+	// written like ResourceManager::createDeviceBuffer: mapped where device
+	// local memory is host visible, through staging otherwise
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage                   = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT |
+	                  VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+	                  VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT;
+
+	VK_CHECK(vmaCreateBuffer(m_allocator,
+	                         &bufferInfo,
+	                         &allocInfo,
+	                         &page.m_buffer.m_buffer,
+	                         &page.m_buffer.m_allocation,
+	                         &page.m_buffer.m_info));
+
+	if (kind == Kind::Storage)
+	{
+		VkBufferDeviceAddressInfo addressInfo {
+		.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+		.buffer = page.m_buffer.m_buffer};
+		page.m_address = vkGetBufferDeviceAddress(m_device, &addressInfo);
+	}
+
+	VmaVirtualBlockCreateInfo blockInfo = {};
+	blockInfo.size                      = size;
+	VK_CHECK(vmaCreateVirtualBlock(&blockInfo, &page.m_block));
+
+	m_stats.m_pageCount++;
+	m_stats.m_capacity += size;
+	return index;
+}
+
+void GeometryArena::destroyPage(Page& page)
+{
+	vmaDestroyVirtualBlock(page.m_block);
+	vmaDestroyBuffer(m_allocator, page.m_buffer.m_buffer, page.m_buffer.m_allocation);
+
+	m_stats.m_pageCount--;
+	m_stats.m_capacity -= page.m_size;
+	page = {};
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <mutex>
+#include <vector>
+
+// How full the geometry arena is, for the stats window
+struct GeometryArenaStats
+{
+	uint32_t     m_pageCount {0};
+	uint64_t     m_allocationCount {0};
+	VkDeviceSize m_usedBytes {0};
+	VkDeviceSize m_capacity {0};
+};
+
+// Mesh data of every scene, sub-allocated from a few large device local
+// buffers through VMA virtual blocks. Meshes cost no VMA allocations of their
+// own, draws of different meshes share one index buffer binding, and the
+// ranges freed when a scene is unloaded are reused by the next one.
+// Pages are created on demand; a range larger than a page gets a page of its
+// own, which goes away again with it. Thread safe, VMA virtual blocks are not.
+class GeometryArena
+{
+public:
+	// what a page holds decides the usage of its buffer
+	enum class Kind : uint8_t
+	{
+		Storage, // vertices, colors and meshlets, read through their address
+		Index
+	};
+
+	void init(VkDevice device, VmaAllocator allocator);
+	void cleanup();
+
+	GeometryAllocation allocate(Kind kind, VkDeviceSize size);
+	void               free(const GeometryAllocation& allocation);
+
+	// The buffer of the allocation's page, mapped if device local memory is
+	// host visible (UMA, resizable BAR)
+	AllocatedBuffer getBuffer(const GeometryAllocation& allocation) const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_pages[allocation.m_page].m_buffer;
+	}
+
+	// storage pages only
+	VkDeviceAddress getAddress(const GeometryAllocation& allocation) const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_pages[allocation.m_page].m_address + allocation.m_offset;
+	}
+
+	GeometryArenaStats getStats() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_stats;
+	}
+
+private:
+	static constexpr VkDeviceSize STORAGE_PAGE_SIZE = 128 * 1024 * 1024;
+	static constexpr VkDeviceSize INDEX_PAGE_SIZE   = 32 * 1024 * 1024;
+
+	// vec4 loads through buffer references, and 32 bit indices whose first
+	// index has to be a whole number
+	static constexpr VkDeviceSize STORAGE_ALIGNMENT = 16;
+	static constexpr VkDeviceSize INDEX_ALIGNMENT   = 4;
+
+	struct Page
+	{
+		AllocatedBuffer m_buffer {};
+		VmaVirtualBlock m_block {VK_NULL_HANDLE};
+		VkDeviceAddress m_address {0};
+		VkDeviceSize    m_size {0};
+		Kind            m_kind {Kind::Storage};
+	};
+
+	// index of the new page, reusing the slot of a destroyed one
+	uint32_t createPage(Kind kind, VkDeviceSize size);
+	void     destroyPage(Page& page);
+
+	VkDevice     m_device {VK_NULL_HANDLE};
+	VmaAllocator m_allocator {VK_NULL_HANDLE};
+
+	// destroyed pages leave an empty slot, so allocations keep their index
+	std::vector<Page>  m_pages;
+	GeometryArenaStats m_stats;
+	mutable std::mutex m_mutex;
+};
@@ -0,0 +1,172 @@
+#include <GltfBuffers.hpp>
+
+#include <MeshoptDecoder.hpp>
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <variant>
+
+namespace
+{
+	meshoptdec::Mode getMeshoptMode(fastgltf::MeshoptCompressionMode mode)
+	{
+		switch (mode)
+		{
+			case fastgltf::MeshoptCompressionMode::Triangles:
+				return meshoptdec::Mode::Triangles;
+			case fastgltf::MeshoptCompressionMode::Indices:
+				return meshoptdec::Mode::Indices;
+			default:
+				return meshoptdec::Mode::Attributes;
+		}
+	}
+
+	meshoptdec::Filter getMeshoptFilter(fastgltf::MeshoptCompressionFilter filter)
+	{
+		switch (filter)
+		{
+			case fastgltf::MeshoptCompressionFilter::Octahedral:
+				return meshoptdec::Filter::Octahedral;
+			case fastgltf::MeshoptCompressionFilter::Quaternion:
+				return meshoptdec::Filter::Quaternion;
+			case fastgltf::MeshoptCompressionFilter::Exponential:
+				return meshoptdec::Filter::Exponential;
+			default:
+				return meshoptdec::Filter::None;
+		}
+	}
+} // namespace
+
+bool GltfBuffers::open(const fastgltf::Asset&       asset,
+                       const std::filesystem::path& directory,
+                       JobSystem&                   jobs)
+{
+	m_buffers.clear();
+	m_files.clear();
+	m_decodedViews.clear();
+	m_buffers.reserve(asset.buffers.size());
+
+	for (const fastgltf::Buffer& buffer : asset.buffers)
+	{
+		std::span<const std::byte> bytes;
+		bool                       failed = false;
+
+		std::visit(
+		fastgltf::visitor {
+		[](const auto& arg) {},
+		[&](const fastgltf::sources::Array& array)
+		{ bytes = {array.bytes.data(), array.bytes.size()}; },
+		[&](const fastgltf::sources::Vector& vector)
+		{ bytes = {vector.bytes.data(), vector.bytes.size()}; },
+		[&](const fastgltf::sources::ByteView& view)
+		{ bytes = {view.bytes.data(), view.bytes.size()}; },
+		[&](const fastgltf::sources::URI& uri)
+		{
+			if (!uri.uri.isLocalPath())
+			{
+				failed = true;
+				return;
+			}
+
+			MappedFile file;
+			if (!file.open(directory / uri.uri.fspath()) ||
+			    uri.fileByteOffset > file.size() ||
+			    buffer.byteLength > file.size() - uri.fileByteOffset)
+			{
+				fmt::print("Failed to map glTF buffer: {}\n", uri.uri.string());
+				failed = true;
+				return;
+			}
+
+			// the mapping stays put when the file object moves
+			bytes = std::as_bytes(
+			file.bytes().subspan(uri.fileByteOffset, buffer.byteLength));
+			m_files.push_back(std::move(file));
+		}},
+		buffer.data);
+
+		if (failed)
+		{
+			return false;
+		}
+		m_buffers.push_back(bytes);
+	}
+
+	// every view decodes on its own, into its own storage
+	m_decodedViews.resize(asset.bufferViews.size());
+	std::atomic<bool> decoded = true;
+	jobs.parallelFor(asset.bufferViews.size(),
+	                 [&](size_t i)
+	                 {
+		                 if (asset.bufferViews[i].meshoptCompression &&
+		                     !decodeView(asset, i))
+		                 {
+			                 decoded = false;
+		                 }
+	                 });
+	return decoded;
+}
+
+bool GltfBuffers::decodeView(const fastgltf::Asset& asset, size_t bufferViewIndex)
+{
+	const fastgltf::CompressedBufferView& view =
+	*asset.bufferViews[bufferViewIndex].meshoptCompression;
+
+	std::span<const std::byte> buffer = m_buffers[view.bufferIndex];
+	if (view.byteOffset > buffer.size() ||
+	    view.byteLength > buffer.size() - view.byteOffset)
+	{
+		fmt::print("Compressed buffer view {} is out of bounds\n", bufferViewIndex);
+		return false;
+	}
+
+	std::vector<std::byte>& decoded = m_decodedViews[bufferViewIndex];
+	decoded.resize(view.count * view.byteStride);
+
+	std::span<const std::byte> source =
+	buffer.subspan(view.byteOffset, view.byteLength);
+	if (!meshoptdec::decode(
+	    {reinterpret_cast<const uint8_t*>(source.data()), source.size()},
+	    {reinterpret_cast<uint8_t*>(decoded.data()), decoded.size()},
+	    view.count,
+	    view.byteStride,
+	    getMeshoptMode(view.mode),
+	    getMeshoptFilter(view.filter)))
+	{
+		fmt::print("Failed to decode compressed buffer view {}\n", bufferViewIndex);
+		decoded.clear();
+		return false;
+	}
+	return true;
+}
+
+std::span<const std::byte>
+GltfBuffers::getBufferView(const fastgltf::Asset& asset,
+                           size_t                 bufferViewIndex) const
+{
+	const std::vector<std::byte>& decoded = m_decodedViews[bufferViewIndex];
+	if (!decoded.empty())
+	{
+		return decoded;
+	}
+
+	const fastgltf::BufferView& view  = asset.bufferViews[bufferViewIndex];
+	std::span<const std::byte>  bytes = m_buffers[view.bufferIndex];
+	if (view.byteOffset > bytes.size() ||
+	    view.byteLength > bytes.size() - view.byteOffset)
+	{
+		return {};
+	}
+	return bytes.subspan(view.byteOffset, view.byteLength);
+}
+
+size_t GltfBuffers::getMappedSize() const
+{
+	size_t size = 0;
+	for (const MappedFile& file : m_files)
+	{
+		size += file.size();
+	}
+	return size;
+}
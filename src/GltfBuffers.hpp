@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JobSystem.hpp>
+#include <MappedFile.hpp>
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <fastgltf/core.hpp>
+
+// The bytes of every buffer of a glTF asset, resolved without copying them.
+// Buffers in external files are memory mapped, GLB and data URI buffers
+// point at whatever the parser already holds. Buffer views compressed with
+// EXT_meshopt_compression are decoded once up front. Also works as a
+// fastgltf buffer data adapter, so accessors are read straight from the
+// mapping or the decoded views.
+class GltfBuffers
+{
+public:
+	// Resolve the buffers of asset, external files are looked up relative to
+	// directory, and decode its compressed buffer views in parallel on jobs.
+	// Returns false if one of them can't be read.
+	bool open(const fastgltf::Asset&       asset,
+	          const std::filesystem::path& directory,
+	          JobSystem&                   jobs);
+
+	// Bytes of a buffer, empty if it has no data
+	std::span<const std::byte> getBuffer(size_t bufferIndex) const
+	{
+		return m_buffers[bufferIndex];
+	}
+
+	// Bytes of a buffer view, decoded if it is compressed
+	std::span<const std::byte> getBufferView(const fastgltf::Asset& asset,
+	                                         size_t bufferViewIndex) const;
+
+	// fastgltf buffer data adapter
+	fastgltf::span<const std::byte> operator()(const fastgltf::Asset& asset,
+	                                           size_t bufferViewIndex) const
+	{
+		std::span<const std::byte> bytes = getBufferView(asset, bufferViewIndex);
+		return {bytes.data(), bytes.size()};
+	}
+
+	// Bytes of all buffers that are mapped from external files
+	size_t getMappedSize() const;
+
+private:
+	bool decodeView(const fastgltf::Asset& asset, size_t bufferViewIndex);
+
+	std::vector<std::span<const std::byte>> m_buffers;
+	std::vector<MappedFile>                 m_files;
+
+	// decoded meshopt views, empty for the views that aren't compressed
+	std::vector<std::vector<std::byte>> m_decodedViews;
+};
@@ -0,0 +1,114 @@
+#include <Hash.hpp>
+
+#include <cstring>
+
+namespace
+{
+	constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+	constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+	constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+	inline uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t read64(const uint8_t* p)
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	inline uint64_t round(uint64_t acc, uint64_t input)
+	{
+		acc += input * PRIME64_2;
+		acc = rotl(acc, 31);
+		acc *= PRIME64_1;
+		return acc;
+	}
+
+	inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+	{
+		val = round(0, val);
+		acc ^= val;
+		acc = acc * PRIME64_1 + PRIME64_4;
+		return acc;
+	}
+} // namespace
+
+uint64_t hashutil::xxhash64(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* p   = static_cast<const uint8_t*>(data);
+	const uint8_t* end = p + size;
+	uint64_t       h;
+
+	if (size >= 32)
+	{
+		// 4 independent lanes over 32 byte stripes
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+
+		const uint8_t* limit = end - 32;
+		do
+		{
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = mergeRound(h, v1);
+		h = mergeRound(h, v2);
+		h = mergeRound(h, v3);
+		h = mergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + PRIME64_5;
+	}
+
+	h += static_cast<uint64_t>(size);
+
+	// tail
+	while (p + 8 <= end)
+	{
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+		h = rotl(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	while (p < end)
+	{
+		h ^= (*p) * PRIME64_5;
+		h = rotl(h, 11) * PRIME64_1;
+		p++;
+	}
+
+	// avalanche
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
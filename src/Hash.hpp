@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace hashutil
+{
+	// 64-bit xxHash (XXH64) of a block of memory. Fast enough to key caches
+	// on the full contents of large asset files.
+	uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
+
+	template <typename T>
+	uint64_t xxhash64(std::span<const T> data, uint64_t seed = 0)
+	{
+		return xxhash64(data.data(), data.size_bytes(), seed);
+	}
+
+	// Mix a value into a running hash
+	inline uint64_t hashCombine(uint64_t hash, uint64_t value)
+	{
+		return hash ^ (value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2));
+	}
+} // namespace hashutil
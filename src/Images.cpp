@@ -1,5 +1,13 @@
 #include <Images.hpp>
 #include <Initializers.hpp>
+#include <StbStaging.hpp>
+// stb allocates through the staging hooks, so images can be decoded
+// straight into staging memory
+#define STBI_MALLOC(size) stbstaging::allocate(size)
+#define STBI_REALLOC(ptr, size) std::realloc(ptr, size)
+#define STBI_REALLOC_SIZED(ptr, oldSize, newSize) \
+	stbstaging::reallocate(ptr, oldSize, newSize)
+#define STBI_FREE(ptr) stbstaging::release(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -166,3 +174,26 @@ void vkutil::generateMipmaps(VkCommandBuffer cmd,
 	                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 	                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
+
+void vkutil::memoryBarrier(VkCommandBuffer       cmd,
+                           VkPipelineStageFlags2 srcStageMask,
+                           VkAccessFlags2        srcAccessMask,
+                           VkPipelineStageFlags2 dstStageMask,
+                           VkAccessFlags2        dstAccessMask)
+{
+	VkMemoryBarrier2 memoryBarrier {.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+	memoryBarrier.pNext         = nullptr;
+	memoryBarrier.srcStageMask  = srcStageMask;
+	memoryBarrier.srcAccessMask = srcAccessMask;
+	memoryBarrier.dstStageMask  = dstStageMask;
+	memoryBarrier.dstAccessMask = dstAccessMask;
+
+	VkDependencyInfo depInfo {};
+	depInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	depInfo.pNext = nullptr;
+
+	depInfo.memoryBarrierCount = 1;
+	depInfo.pMemoryBarriers    = &memoryBarrier;
+
+	vkCmdPipelineBarrier2(cmd, &depInfo);
+}
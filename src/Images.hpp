@@ -18,4 +18,11 @@ namespace vkutil
 	void
 	generateMipmaps(VkCommandBuffer cmd, VkImage image, VkExtent2D imageSize);
 
+	// global memory barrier, for buffers written and read on the GPU
+	void memoryBarrier(VkCommandBuffer       cmd,
+	                   VkPipelineStageFlags2 srcStageMask,
+	                   VkAccessFlags2        srcAccessMask,
+	                   VkPipelineStageFlags2 dstStageMask,
+	                   VkAccessFlags2        dstAccessMask);
+
 }; // namespace vkutil
\ No newline at end of file
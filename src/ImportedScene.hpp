@@ -0,0 +1,146 @@
+#pragma once
+
+#include <MappedFile.hpp>
+#include <Material.hpp>
+#include <Types.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// CPU side result of decoding an image, waiting to be uploaded
+struct DecodedImage
+{
+	// RGBA8 texels, released with the decoder's free function
+	std::unique_ptr<unsigned char, void (*)(void*)> m_pixels {nullptr, nullptr};
+
+	// levels 1..n when the mip chain was built on the CPU
+	std::vector<uint8_t> m_mipTexels;
+
+	// every level of block compressed images, encoded on import or read
+	// from a KTX2 file
+	std::vector<uint8_t> m_blocks;
+
+	// every level we have, starting with the full resolution one. The texels
+	// live in m_pixels/m_mipTexels/m_blocks or in a mapped scene cache.
+	std::vector<ImageMipLevel> m_levels;
+
+	VkFormat m_format {VK_FORMAT_R8G8B8A8_UNORM};
+	// view swizzle that puts the channels where the shaders expect them
+	VkComponentMapping m_components {};
+};
+
+// Everything loadGltf needs to build a scene on the GPU, with no Vulkan
+// objects in it. Produced either by importing a glTF file or by reading a
+// baked scene cache; indices between the arrays replace the shared_ptr links
+// of the final scene.
+struct ImportedImage
+{
+	std::string                 m_name;
+	std::optional<DecodedImage> m_image; // empty if decoding failed
+};
+
+struct ImportedSampler
+{
+	VkFilter            m_magFilter;
+	VkFilter            m_minFilter;
+	VkSamplerMipmapMode m_mipmapMode;
+};
+
+struct ImportedTexture
+{
+	// the texture names no image we can load, drawn like a failed decode
+	static constexpr int32_t MISSING_IMAGE = -2;
+
+	int32_t m_imageIndex {-1};
+	int32_t m_samplerIndex {-1};
+};
+
+struct ImportedMaterial
+{
+	std::string                        m_name;
+	GltfPbrMaterial::MaterialConstants m_constants;
+	MaterialPass                       m_passType;
+
+	ImportedTexture m_colorTexture;
+	ImportedTexture m_metalRoughTexture;
+	ImportedTexture m_normalTexture;
+	ImportedTexture m_occlusionTexture;
+};
+
+struct ImportedSurface
+{
+	uint32_t m_startIndex;
+	uint32_t m_count;
+	Bounds   m_bounds;
+	uint32_t m_materialIndex;
+
+	// range of the surface's meshlets in ImportedMesh::m_meshlets
+	uint32_t m_firstMeshlet {0};
+	uint32_t m_meshletCount {0};
+
+	// simplified versions, coarsest last
+	uint32_t   m_lodCount {0};
+	SurfaceLod m_lods[MAX_SURFACE_LODS] {};
+
+	// identical primitives are stored once: the index and meshlet ranges
+	// then point into the buffers of this mesh, where surface
+	// m_sourceSurface owns them. -1 if the surface owns its geometry.
+	int32_t m_sourceMesh {-1};
+	int32_t m_sourceSurface {-1};
+};
+
+struct ImportedMesh
+{
+	std::string                  m_name;
+	std::vector<ImportedSurface> m_surfaces;
+
+	VertexFormat m_vertexFormat {VertexFormat::Full};
+
+	// views of the final vertex/index data, either into the storage below or
+	// into a mapped scene cache. Only the vertex view matching m_vertexFormat
+	// is filled.
+	std::span<const Vertex>       m_vertices;
+	std::span<const PackedVertex> m_packedVertices;
+	std::span<const uint32_t>     m_colors; // packed only, may be empty
+	std::span<const uint32_t>     m_indices;
+	std::span<const GPUMeshlet>   m_meshlets;
+
+	// dequantization of packed positions
+	glm::vec3 m_positionScale {1.f};
+	glm::vec3 m_positionOffset {0.f};
+
+	std::vector<Vertex>       m_vertexStorage;
+	std::vector<PackedVertex> m_packedVertexStorage;
+	std::vector<uint32_t>     m_colorStorage;
+	std::vector<uint32_t>     m_indexStorage;
+	std::vector<GPUMeshlet>   m_meshletStorage;
+};
+
+struct ImportedNode
+{
+	std::string           m_name;
+	int32_t               m_meshIndex {-1};
+	glm::mat4             m_localTransform {1.f};
+	std::vector<uint32_t> m_children;
+
+	// EXT_mesh_gpu_instancing transforms, relative to the node. The mesh is
+	// drawn once per entry instead of once at the node if there are any.
+	std::vector<glm::mat4> m_instances;
+};
+
+struct ImportedScene
+{
+	std::vector<ImportedSampler>  m_samplers;
+	std::vector<ImportedImage>    m_images;
+	std::vector<ImportedMaterial> m_materials;
+	std::vector<ImportedMesh>     m_meshes;
+	std::vector<ImportedNode>     m_nodes;
+
+	// keeps the cache file mapped while the spans above point into it, and
+	// while the GPU copies out of it (see ResourceManager::importMappedFile)
+	std::shared_ptr<MappedFile> m_cacheFile;
+};
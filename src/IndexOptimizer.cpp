@@ -0,0 +1,330 @@
+#include <IndexOptimizer.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+	constexpr uint32_t INVALID_VERTEX = std::numeric_limits<uint32_t>::max();
+
+	// FIFO cache simulation with timestamps: a vertex is cached while fewer
+	// than CACHE_SIZE misses happened since it was loaded
+	struct VertexCache
+	{
+		std::vector<uint32_t> m_timestamps;
+		uint32_t              m_time = indexopt::CACHE_SIZE + 1;
+
+		explicit VertexCache(uint32_t vertexCount)
+		: m_timestamps(vertexCount, 0)
+		{
+		}
+
+		// returns true on a miss
+		bool access(uint32_t vertex)
+		{
+			if (m_time - m_timestamps[vertex] > indexopt::CACHE_SIZE)
+			{
+				m_timestamps[vertex] = m_time++;
+				return true;
+			}
+			return false;
+		}
+	};
+
+	// Next vertex for Tipsify to fan around once the candidates ran out:
+	// the most recently used vertex with triangles left, or else the next
+	// one in input order
+	uint32_t skipDeadEnd(const std::vector<uint32_t>& liveTriangles,
+	                     std::vector<uint32_t>&       deadEnd,
+	                     uint32_t&                    cursor)
+	{
+		while (!deadEnd.empty())
+		{
+			uint32_t vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+
+		for (; cursor < liveTriangles.size(); cursor++)
+		{
+			if (liveTriangles[cursor] > 0)
+			{
+				return cursor;
+			}
+		}
+		return INVALID_VERTEX;
+	}
+} // namespace
+
+indexopt::CacheStats& indexopt::CacheStats::operator+=(const CacheStats& other)
+{
+	m_triangleCount += other.m_triangleCount;
+	m_vertexCount += other.m_vertexCount;
+	m_missCount += other.m_missCount;
+	return *this;
+}
+
+float indexopt::CacheStats::getAcmr() const
+{
+	return m_triangleCount > 0 ? float(m_missCount) / m_triangleCount : 0.f;
+}
+
+float indexopt::CacheStats::getAtvr() const
+{
+	return m_vertexCount > 0 ? float(m_missCount) / m_vertexCount : 0.f;
+}
+
+indexopt::CacheStats
+indexopt::analyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount)
+{
+	CacheStats stats;
+	stats.m_triangleCount = indices.size() / 3;
+
+	VertexCache       cache(vertexCount);
+	std::vector<bool> referenced(vertexCount, false);
+	for (uint32_t index : indices)
+	{
+		stats.m_missCount += cache.access(index) ? 1 : 0;
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			stats.m_vertexCount++;
+		}
+	}
+
+	return stats;
+}
+
+void indexopt::optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// triangles around each vertex
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		liveTriangles[indices[i]]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	std::partial_sum(liveTriangles.begin(),
+	                 liveTriangles.end(),
+	                 adjacencyOffsets.begin() + 1);
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fillCursor(adjacencyOffsets.begin(),
+	                                 adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[fillCursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	std::vector<bool>     emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	deadEnd.reserve(triangleCount * 3);
+	std::vector<uint32_t> candidates;
+
+	VertexCache cache(vertexCount);
+	uint32_t    cursor  = 0;
+	uint32_t    fanning = skipDeadEnd(liveTriangles, deadEnd, cursor);
+
+	while (fanning != INVALID_VERTEX)
+	{
+		// emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fanning];
+		     a < adjacencyOffsets[fanning + 1];
+		     a++)
+		{
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+			emitted[triangle] = true;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				output.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				cache.access(vertex);
+			}
+		}
+
+		// prefer the oldest candidate that stays in the cache while its
+		// remaining triangles get emitted
+		uint32_t next         = INVALID_VERTEX;
+		int64_t  bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+			{
+				continue;
+			}
+
+			int64_t age      = cache.m_time - cache.m_timestamps[vertex];
+			int64_t priority = 0;
+			if (age + 2 * liveTriangles[vertex] <= CACHE_SIZE)
+			{
+				priority = age;
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next         = vertex;
+			}
+		}
+
+		fanning = next != INVALID_VERTEX
+		          ? next
+		          : skipDeadEnd(liveTriangles, deadEnd, cursor);
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void indexopt::optimizeOverdraw(std::span<uint32_t>     indices,
+                                std::span<const Vertex> vertices)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// a cluster starts wherever all three vertices of a triangle miss the
+	// cache, moving it around costs next to nothing
+	std::vector<size_t> clusterStarts;
+	VertexCache         cache(static_cast<uint32_t>(vertices.size()));
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t misses = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			misses += cache.access(indices[t * 3 + corner]) ? 1 : 0;
+		}
+		if (misses == 3)
+		{
+			clusterStarts.push_back(t);
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	const size_t clusterCount = clusterStarts.size() - 1;
+	if (clusterCount < 2)
+	{
+		return;
+	}
+
+	// area weighted centroid and facing of every cluster
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.f));
+	std::vector<float>     clusterAreas(clusterCount, 0.f);
+	glm::vec3              meshCentroid(0.f);
+	float                  meshArea = 0.f;
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			glm::vec3 p0 = vertices[indices[t * 3 + 0]].m_position;
+			glm::vec3 p1 = vertices[indices[t * 3 + 1]].m_position;
+			glm::vec3 p2 = vertices[indices[t * 3 + 2]].m_position;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float     area   = glm::length(normal);
+
+			clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.f);
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+		}
+
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterAreas[c];
+	}
+
+	if (meshArea == 0.f)
+	{
+		return;
+	}
+	meshCentroid /= meshArea;
+
+	// clusters far out along their own facing occlude the rest from most
+	// views, draw them first
+	std::vector<float> clusterScores(clusterCount, 0.f);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float normalLength = glm::length(clusterNormals[c]);
+		if (clusterAreas[c] > 0.f && normalLength > 0.f)
+		{
+			glm::vec3 centroid = clusterCentroids[c] / clusterAreas[c];
+			clusterScores[c] =
+			glm::dot(centroid - meshCentroid, clusterNormals[c] / normalLength);
+		}
+	}
+
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(),
+	                 clusterOrder.end(),
+	                 [&](uint32_t a, uint32_t b)
+	                 { return clusterScores[a] > clusterScores[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (uint32_t c : clusterOrder)
+	{
+		output.insert(output.end(),
+		              indices.begin() + clusterStarts[c] * 3,
+		              indices.begin() + clusterStarts[c + 1] * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void indexopt::optimizeVertexFetch(std::span<uint32_t> indices,
+                                   std::span<Vertex>   vertices)
+{
+	std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+	uint32_t              nextVertex = 0;
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == INVALID_VERTEX)
+		{
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+
+	for (uint32_t& target : remap)
+	{
+		if (target == INVALID_VERTEX)
+		{
+			target = nextVertex++;
+		}
+	}
+
+	std::vector<Vertex> reordered(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		reordered[remap[i]] = vertices[i];
+	}
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <cstdint>
+#include <span>
+
+// Import time reordering of triangle lists for the GPU. Indices passed to
+// these functions are relative to the start of the vertex span.
+namespace indexopt
+{
+	// FIFO size of the simulated post-transform vertex cache
+	constexpr uint32_t CACHE_SIZE = 16;
+
+	// Vertex cache efficiency of a triangle list
+	struct CacheStats
+	{
+		uint64_t m_triangleCount = 0;
+		uint64_t m_vertexCount   = 0; // distinct vertices referenced
+		uint64_t m_missCount     = 0; // vertex shader invocations
+
+		CacheStats& operator+=(const CacheStats& other);
+
+		// average cache miss ratio, misses per triangle (0.5 is ideal)
+		float getAcmr() const;
+		// average transform to vertex ratio, misses per vertex (1.0 is ideal)
+		float getAtvr() const;
+	};
+
+	CacheStats analyzeVertexCache(std::span<const uint32_t> indices,
+	                              uint32_t                  vertexCount);
+
+	// Reorder triangles for the vertex cache (Tipsify, Sander et al. 2007)
+	void optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount);
+
+	// Reorder the clusters of a cache optimized triangle list so the ones
+	// facing outwards come first, which reduces overdraw from most views.
+	// Clusters start wherever the cache order already restarts, so the
+	// cache efficiency is kept.
+	void optimizeOverdraw(std::span<uint32_t>     indices,
+	                      std::span<const Vertex> vertices);
+
+	// Reorder vertices in the order the indices first use them and remap the
+	// indices to match. Unreferenced vertices are moved to the end.
+	void optimizeVertexFetch(std::span<uint32_t> indices, std::span<Vertex> vertices);
+} // namespace indexopt
@@ -0,0 +1,133 @@
+#include <JobSystem.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace
+{
+	// Shared between the caller of parallelFor and the helper tasks it queues.
+	// Helpers can start after the caller already returned, so the state is
+	// reference counted instead of living on the caller's stack.
+	struct ParallelForState
+	{
+		std::function<void(size_t)> m_job;
+		size_t                      m_count {0};
+		std::atomic<size_t>         m_nextIndex {0};
+		std::atomic<size_t>         m_doneCount {0};
+		std::mutex                  m_doneMutex;
+		std::condition_variable     m_doneCondition;
+
+		// grab indices until the range is exhausted
+		void run()
+		{
+			size_t index;
+			while ((index = m_nextIndex.fetch_add(1)) < m_count)
+			{
+				m_job(index);
+
+				if (m_doneCount.fetch_add(1) + 1 == m_count)
+				{
+					std::lock_guard<std::mutex> lock(m_doneMutex);
+					m_doneCondition.notify_all();
+				}
+			}
+		}
+	};
+} // namespace
+
+void JobSystem::init(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	m_stopping = false;
+	m_workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back([this]() { workerLoop(); });
+	}
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_stopping = true;
+	}
+	m_queueCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+void JobSystem::parallelFor(size_t                                count,
+                            const std::function<void(size_t index)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// nothing to spread, or no workers to spread it to
+	if (count == 1 || m_workers.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	auto state     = std::make_shared<ParallelForState>();
+	state->m_job   = job;
+	state->m_count = count;
+
+	// one helper per worker at most, the calling thread takes part too
+	size_t helperCount = std::min(count - 1, m_workers.size());
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		for (size_t i = 0; i < helperCount; i++)
+		{
+			m_queue.emplace_back([state]() { state->run(); });
+		}
+	}
+	m_queueCondition.notify_all();
+
+	state->run();
+
+	// wait for the indices other threads are still working on
+	std::unique_lock<std::mutex> lock(state->m_doneMutex);
+	state->m_doneCondition.wait(
+	lock, [&]() { return state->m_doneCount.load() == state->m_count; });
+}
+
+void JobSystem::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_queueCondition.wait(
+			lock, [this]() { return m_stopping || !m_queue.empty(); });
+
+			if (m_queue.empty())
+			{
+				// only reached when stopping
+				return;
+			}
+
+			task = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		task();
+	}
+}
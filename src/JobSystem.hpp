@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads for CPU side asset work (image decoding,
+// mesh processing, ...). Work is submitted as an index range with
+// parallelFor; the calling thread helps process the range and the call only
+// returns once every index has been handled, so it can also be used from
+// inside a job without deadlocking.
+class JobSystem
+{
+public:
+	JobSystem()                                  = default;
+	~JobSystem()                                 = default;
+	JobSystem(const JobSystem& other)            = delete;
+	JobSystem(JobSystem&& other)                 = delete;
+	JobSystem& operator=(const JobSystem& other) = delete;
+	JobSystem& operator=(JobSystem&& other)      = delete;
+
+	// Spawn the worker threads. A count of 0 uses one worker per hardware
+	// thread, minus the calling thread.
+	void init(uint32_t workerCount = 0);
+
+	// Finish the queued work and join the worker threads
+	void shutdown();
+
+	// Run job(i) for every i in [0, count) across the workers and the calling
+	// thread. Indices are handed out one at a time, so jobs of uneven cost
+	// balance themselves.
+	void parallelFor(size_t count, const std::function<void(size_t index)>& job);
+
+	// Number of threads that take part in a parallelFor (workers + caller)
+	uint32_t getThreadCount() const
+	{
+		return static_cast<uint32_t>(m_workers.size()) + 1;
+	}
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread>          m_workers;
+	std::deque<std::function<void()>> m_queue;
+	std::mutex                        m_queueMutex;
+	std::condition_variable           m_queueCondition;
+	bool                              m_stopping {false};
+};
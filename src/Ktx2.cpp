@@ -0,0 +1,146 @@
+#include <Ktx2.hpp>
+
+#include <TextureCompressor.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	constexpr uint8_t KTX2_IDENTIFIER[12] = {
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+	// header and index up to the level index, as laid out in the file
+	struct Ktx2Header
+	{
+		uint8_t  m_identifier[12];
+		uint32_t m_vkFormat;
+		uint32_t m_typeSize;
+		uint32_t m_pixelWidth;
+		uint32_t m_pixelHeight;
+		uint32_t m_pixelDepth;
+		uint32_t m_layerCount;
+		uint32_t m_faceCount;
+		uint32_t m_levelCount;
+		uint32_t m_supercompressionScheme;
+		uint32_t m_dfdByteOffset;
+		uint32_t m_dfdByteLength;
+		uint32_t m_kvdByteOffset;
+		uint32_t m_kvdByteLength;
+		uint64_t m_sgdByteOffset;
+		uint64_t m_sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80);
+
+	struct Ktx2Level
+	{
+		uint64_t m_byteOffset;
+		uint64_t m_byteLength;
+		uint64_t m_uncompressedByteLength;
+	};
+
+	// the shaders linearize color themselves, like they do for RGBA8
+	VkFormat toUnorm(VkFormat format)
+	{
+		switch (format)
+		{
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			case VK_FORMAT_BC2_SRGB_BLOCK:
+				return VK_FORMAT_BC2_UNORM_BLOCK;
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				return VK_FORMAT_BC3_UNORM_BLOCK;
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return VK_FORMAT_BC7_UNORM_BLOCK;
+			default:
+				return format;
+		}
+	}
+} // namespace
+
+bool ktx2::isKtx2(std::span<const uint8_t> bytes)
+{
+	return bytes.size() >= sizeof(KTX2_IDENTIFIER) &&
+	       memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+std::optional<DecodedImage> ktx2::load(std::span<const uint8_t> bytes)
+{
+	Ktx2Header header;
+	if (!isKtx2(bytes) || bytes.size() < sizeof(header))
+	{
+		return {};
+	}
+	memcpy(&header, bytes.data(), sizeof(header));
+
+	const VkFormat format = static_cast<VkFormat>(header.m_vkFormat);
+	if (header.m_supercompressionScheme != 0 ||
+	    texcompress::getBlockSize(format) == 0)
+	{
+		fmt::print("KTX2 texture is not plain BC data (format {}, "
+		           "supercompression {})\n",
+		           header.m_vkFormat,
+		           header.m_supercompressionScheme);
+		return {};
+	}
+
+	// a level count of 0 asks for mips to be generated, which blocks can't
+	if (header.m_pixelWidth == 0 || header.m_pixelHeight == 0 ||
+	    header.m_pixelDepth > 1 || header.m_layerCount > 1 ||
+	    header.m_faceCount != 1 || header.m_levelCount == 0 ||
+	    header.m_levelCount > 32)
+	{
+		fmt::print("KTX2 texture is not a 2D texture with stored mips\n");
+		return {};
+	}
+
+	if (bytes.size() < sizeof(header) + header.m_levelCount * sizeof(Ktx2Level))
+	{
+		return {};
+	}
+
+	DecodedImage decoded;
+	decoded.m_format = toUnorm(format);
+
+	std::vector<Ktx2Level> levels(header.m_levelCount);
+	memcpy(levels.data(),
+	       bytes.data() + sizeof(header),
+	       levels.size() * sizeof(Ktx2Level));
+
+	VkExtent3D extent {header.m_pixelWidth, header.m_pixelHeight, 1};
+	size_t     totalSize = 0;
+	for (const Ktx2Level& level : levels)
+	{
+		if (level.m_byteLength != texcompress::getLevelSize(format, extent) ||
+		    level.m_byteOffset > bytes.size() ||
+		    level.m_byteLength > bytes.size() - level.m_byteOffset)
+		{
+			return {};
+		}
+		totalSize += level.m_byteLength;
+		extent.width  = std::max(1u, extent.width / 2);
+		extent.height = std::max(1u, extent.height / 2);
+	}
+
+	// levels are indexed from the largest, the file stores them smallest
+	// first
+	decoded.m_blocks.resize(totalSize);
+	extent        = {header.m_pixelWidth, header.m_pixelHeight, 1};
+	size_t offset = 0;
+	for (const Ktx2Level& level : levels)
+	{
+		memcpy(decoded.m_blocks.data() + offset,
+		       bytes.data() + level.m_byteOffset,
+		       level.m_byteLength);
+		decoded.m_levels.push_back(
+		{{decoded.m_blocks.data() + offset, level.m_byteLength}, extent});
+
+		offset += level.m_byteLength;
+		extent.width  = std::max(1u, extent.width / 2);
+		extent.height = std::max(1u, extent.height / 2);
+	}
+
+	return decoded;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <ImportedScene.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+// Reader for KTX2 textures that already hold block compressed data
+namespace ktx2
+{
+	// Whether bytes start with the KTX2 file identifier
+	bool isKtx2(std::span<const uint8_t> bytes);
+
+	// Copy the levels of a 2D KTX2 texture out of bytes. Only BC formats
+	// without supercompression are accepted, basis universal textures,
+	// arrays and cube maps return nothing.
+	std::optional<DecodedImage> load(std::span<const uint8_t> bytes);
+} // namespace ktx2
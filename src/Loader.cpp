@@ -1,12 +1,32 @@
-﻿#include <iostream>
+﻿#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory_resource>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 
 #include <stb_image.h>
 
+#include <AccessorReader.hpp>
 #include <AgniEngine.hpp>
+#include <AllocationStats.hpp>
+#include <GltfBuffers.hpp>
+#include <Hash.hpp>
+#include <IndexOptimizer.hpp>
 #include <Initializers.hpp>
+#include <Ktx2.hpp>
 #include <Loader.hpp>
+#include <MeshSimplifier.hpp>
+#include <MeshletBuilder.hpp>
+#include <MipGenerator.hpp>
+#include <SceneCache.hpp>
+#include <TextureCompressor.hpp>
 #include <Types.hpp>
+#include <VertexPacking.hpp>
+#include <VertexWelder.hpp>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -63,6 +83,8 @@ void AssetLoader::init(ResourceManager* resourceManager, VkDevice device)
 	m_resourceManager = resourceManager;
 	m_device          = device;
 
+	m_jobSystem.init();
+
 	// Create default textures
 	m_whiteTexture.createSolidColor(*m_resourceManager,
 	                                m_device,
@@ -160,6 +182,8 @@ void AssetLoader::cleanup()
 
 	// Clear material system resources
 	m_metalRoughMaterial.clearResources(m_device);
+
+	m_jobSystem.shutdown();
 }
 
 void AssetLoader::buildPipelines(AgniEngine* engine)
@@ -174,9 +198,8 @@ void AssetLoader::buildPipelines(AgniEngine* engine)
 // MikkTSpace implementation for tangent generation
 struct MikkTSpaceUserData
 {
-	std::vector<Vertex>*   vertices;
-	std::vector<uint32_t>* indices;
-	size_t vertexOffset; // offset to the current primitive's vertices
+	std::span<Vertex>         vertices; // the whole mesh
+	std::span<const uint32_t> indices;  // the primitive's, into vertices
 };
 
 // MikkTSpace callback: Get number of faces
@@ -184,7 +207,7 @@ int mikkGetNumFaces(const SMikkTSpaceContext* pContext)
 {
 	MikkTSpaceUserData* userData =
 	static_cast<MikkTSpaceUserData*>(pContext->m_pUserData);
-	return static_cast<int>(userData->indices->size() / 3); // triangles only
+	return static_cast<int>(userData->indices.size() / 3); // triangles only
 }
 
 // MikkTSpace callback: Get number of vertices per face (always 3 for triangles)
@@ -202,8 +225,8 @@ void mikkGetPosition(const SMikkTSpaceContext* pContext,
 {
 	MikkTSpaceUserData* userData =
 	static_cast<MikkTSpaceUserData*>(pContext->m_pUserData);
-	int           vertexIndex = (*userData->indices)[iFace * 3 + iVert];
-	const Vertex& vertex      = (*userData->vertices)[vertexIndex];
+	int           vertexIndex = userData->indices[iFace * 3 + iVert];
+	const Vertex& vertex      = userData->vertices[vertexIndex];
 	fvPosOut[0]               = vertex.m_position.x;
 	fvPosOut[1]               = vertex.m_position.y;
 	fvPosOut[2]               = vertex.m_position.z;
@@ -217,8 +240,8 @@ void mikkGetNormal(const SMikkTSpaceContext* pContext,
 {
 	MikkTSpaceUserData* userData =
 	static_cast<MikkTSpaceUserData*>(pContext->m_pUserData);
-	int           vertexIndex = (*userData->indices)[iFace * 3 + iVert];
-	const Vertex& vertex      = (*userData->vertices)[vertexIndex];
+	int           vertexIndex = userData->indices[iFace * 3 + iVert];
+	const Vertex& vertex      = userData->vertices[vertexIndex];
 	fvNormOut[0]              = vertex.m_normal.x;
 	fvNormOut[1]              = vertex.m_normal.y;
 	fvNormOut[2]              = vertex.m_normal.z;
@@ -232,8 +255,8 @@ void mikkGetTexCoord(const SMikkTSpaceContext* pContext,
 {
 	MikkTSpaceUserData* userData =
 	static_cast<MikkTSpaceUserData*>(pContext->m_pUserData);
-	int           vertexIndex = (*userData->indices)[iFace * 3 + iVert];
-	const Vertex& vertex      = (*userData->vertices)[vertexIndex];
+	int           vertexIndex = userData->indices[iFace * 3 + iVert];
+	const Vertex& vertex      = userData->vertices[vertexIndex];
 	fvTexcOut[0]              = vertex.m_uv_x;
 	fvTexcOut[1]              = vertex.m_uv_y;
 }
@@ -247,26 +270,98 @@ void mikkSetTSpaceBasic(const SMikkTSpaceContext* pContext,
 {
 	MikkTSpaceUserData* userData =
 	static_cast<MikkTSpaceUserData*>(pContext->m_pUserData);
-	int     vertexIndex = (*userData->indices)[iFace * 3 + iVert];
-	Vertex& vertex      = (*userData->vertices)[vertexIndex];
+	int     vertexIndex = userData->indices[iFace * 3 + iVert];
+	Vertex& vertex      = userData->vertices[vertexIndex];
 	vertex.m_tangent.x  = fvTangent[0];
 	vertex.m_tangent.y  = fvTangent[1];
 	vertex.m_tangent.z  = fvTangent[2];
 	vertex.m_tangent.w  = fSign; // store handedness in w component
 }
 
-std::optional<AllocatedImage> AssetLoader::loadImage(fastgltf::Asset& asset,
-                                                      fastgltf::Image& image,
-                                                      bool             mipmapped)
+// Wrap texels handed out by stb_image, exposing them as the base level
+static DecodedImage makeDecodedImage(unsigned char* data, int width, int height)
+{
+	DecodedImage decoded;
+	decoded.m_pixels = {data, stbi_image_free};
+	decoded.m_levels.push_back(
+	{{data, size_t(width) * height * 4},
+	 {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1}});
+	return decoded;
+}
+
+// Decode an encoded image (png, jpg, ...) held in memory into RGBA8 texels
+static std::optional<DecodedImage> decodeImageFromMemory(const void* bytes,
+                                                         size_t      size)
 {
-	AllocatedImage newImage {};
+	// KTX2 textures arrive block compressed with their mip chain
+	std::span<const uint8_t> encoded(static_cast<const uint8_t*>(bytes), size);
+	if (ktx2::isKtx2(encoded))
+	{
+		return ktx2::load(encoded);
+	}
 
 	int width, height, nrChannels;
 
+	unsigned char* data =
+	stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(bytes),
+	                      static_cast<int>(size),
+	                      &width,
+	                      &height,
+	                      &nrChannels,
+	                      4);
+	if (!data)
+	{
+		return {};
+	}
+
+	return makeDecodedImage(data, width, height);
+}
+
+// Open a glTF file for the parser, either memory mapped or read whole into
+// a heap buffer
+static std::unique_ptr<fastgltf::GltfDataGetter>
+openGltfData(const std::filesystem::path& filePath, bool mapped)
+{
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+	if (mapped)
+	{
+		auto file = fastgltf::MappedGltfFile::FromPath(filePath);
+		if (file.error() == fastgltf::Error::None)
+		{
+			return std::make_unique<fastgltf::MappedGltfFile>(
+			std::move(file.get()));
+		}
+		fmt::print("Failed to map glTF file, reading it instead: {} \n",
+		           fastgltf::to_underlying(file.error()));
+	}
+#endif
+
+	auto buffer = fastgltf::GltfDataBuffer::FromPath(filePath);
+	if (buffer.error() != fastgltf::Error::None)
+	{
+		fmt::print("Failed to load glTF file: {} \n",
+		           fastgltf::to_underlying(buffer.error()));
+		return nullptr;
+	}
+	return std::make_unique<fastgltf::GltfDataBuffer>(std::move(buffer.get()));
+}
+
+// Binary glTF files start with the "glTF" magic
+static bool isBinaryGltf(std::span<const uint8_t> bytes)
+{
+	return bytes.size() >= 4 && memcmp(bytes.data(), "glTF", 4) == 0;
+}
+
+std::optional<DecodedImage> AssetLoader::decodeImage(const fastgltf::Asset& asset,
+                                                     const fastgltf::Image& image,
+                                                     const GltfBuffers& buffers)
+{
+	std::optional<DecodedImage> decoded;
+
 	std::visit(
 	fastgltf::visitor {
 	[](auto& arg) {},
-	[&](fastgltf::sources::URI& filePath)
+	[&](const fastgltf::sources::URI& filePath)
 	{
 		assert(filePath.fileByteOffset ==
 		       0); // We don't support offsets with stbi.
@@ -275,22 +370,27 @@ std::optional<AllocatedImage> AssetLoader::loadImage(fastgltf::Asset& asset,
 
 		const std::string path(filePath.uri.path().begin(),
 		                       filePath.uri.path().end()); // Thanks C++.
-		unsigned char*    data =
+
+		if (std::filesystem::path(path).extension() == ".ktx2")
+		{
+			MappedFile file;
+			if (file.open(path))
+			{
+				decoded = ktx2::load(file.bytes());
+			}
+			if (!decoded)
+			{
+				fmt::print("Failed to load KTX2 image: {}\n", path);
+			}
+			return;
+		}
+
+		int            width, height, nrChannels;
+		unsigned char* data =
 		stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
 		if (data)
 		{
-			VkExtent3D imagesize;
-			imagesize.width  = width;
-			imagesize.height = height;
-			imagesize.depth  = 1;
-
-			newImage = m_resourceManager->createImage(data,
-			                               imagesize,
-			                               VK_FORMAT_R8G8B8A8_UNORM,
-			                               VK_IMAGE_USAGE_SAMPLED_BIT,
-			                               mipmapped);
-
-			stbi_image_free(data);
+			decoded = makeDecodedImage(data, width, height);
 		}
 		else
 		{
@@ -299,583 +399,1391 @@ std::optional<AllocatedImage> AssetLoader::loadImage(fastgltf::Asset& asset,
 			           stbi_failure_reason());
 		}
 	},
-	[&](fastgltf::sources::Vector& vector)
-	{
-		unsigned char* data = stbi_load_from_memory(
-		reinterpret_cast<const stbi_uc*>(vector.bytes.data()),
-		static_cast<int>(vector.bytes.size()),
-		&width,
-		&height,
-		&nrChannels,
-		4);
-		if (data)
+	[&](const fastgltf::sources::Array& array)
+	{
+		decoded = decodeImageFromMemory(array.bytes.data(), array.bytes.size());
+		if (!decoded)
 		{
-			VkExtent3D imagesize;
-			imagesize.width  = width;
-			imagesize.height = height;
-			imagesize.depth  = 1;
-
-			newImage = m_resourceManager->createImage(data,
-			                               imagesize,
-			                               VK_FORMAT_R8G8B8A8_UNORM,
-			                               VK_IMAGE_USAGE_SAMPLED_BIT,
-			                               mipmapped);
-
-			stbi_image_free(data);
+			fmt::print("Failed to load image from memory: {}\n",
+			           stbi_failure_reason());
 		}
-		else
+	},
+	[&](const fastgltf::sources::Vector& vector)
+	{
+		decoded = decodeImageFromMemory(vector.bytes.data(), vector.bytes.size());
+		if (!decoded)
 		{
 			fmt::print("Failed to load image from memory: {}\n",
 			           stbi_failure_reason());
 		}
 	},
-	[&](fastgltf::sources::BufferView& view)
+	[&](const fastgltf::sources::BufferView& view)
 	{
-		auto& bufferView = asset.bufferViews[view.bufferViewIndex];
-		auto& buffer     = asset.buffers[bufferView.bufferIndex];
-
-		std::visit(
-		fastgltf::visitor {
-		// We only care about VectorWithMime here, because we
-		// specify LoadExternalBuffers, meaning all buffers
-		// are already loaded into a vector.
-		// but only sources::Array ended up working here?
-		// still need to have other variants handled
-		[](auto& arg) {},
-		[&](fastgltf::sources::Array& vector)
-		{
-			unsigned char* data = stbi_load_from_memory(
-			reinterpret_cast<const stbi_uc*>(vector.bytes.data()) +
-			bufferView.byteOffset,
-			static_cast<int>(bufferView.byteLength),
-			&width,
-			&height,
-			&nrChannels,
-			4);
-			if (data)
-			{
-				VkExtent3D imagesize;
-				imagesize.width  = width;
-				imagesize.height = height;
-				imagesize.depth  = 1;
-
-				newImage = m_resourceManager->createImage(data,
-				                               imagesize,
-				                               VK_FORMAT_R8G8B8A8_UNORM,
-				                               VK_IMAGE_USAGE_SAMPLED_BIT,
-				                               mipmapped);
-
-				stbi_image_free(data);
-			}
-			else
-			{
-				fmt::print("Failed to load image from buffer: {}\n",
-				           stbi_failure_reason());
-			}
-		},
-		[&](fastgltf::sources::Vector& vector)
-		{
-			unsigned char* data = stbi_load_from_memory(
-			reinterpret_cast<const stbi_uc*>(vector.bytes.data()) +
-			bufferView.byteOffset,
-			static_cast<int>(bufferView.byteLength),
-			&width,
-			&height,
-			&nrChannels,
-			4);
-			if (data)
-			{
-				VkExtent3D imagesize;
-				imagesize.width  = width;
-				imagesize.height = height;
-				imagesize.depth  = 1;
-
-				newImage = m_resourceManager->createImage(data,
-				                               imagesize,
-				                               VK_FORMAT_R8G8B8A8_UNORM,
-				                               VK_IMAGE_USAGE_SAMPLED_BIT,
-				                               mipmapped);
-
-				stbi_image_free(data);
-			}
-			else
-			{
-				fmt::print("Failed to load image from buffer: {}\n",
-				           stbi_failure_reason());
-			}
-		}},
-		buffer.data);
+		// embedded images are decoded straight out of the buffer, which may
+		// be a mapping of the file
+		std::span<const std::byte> bytes =
+		buffers.getBufferView(asset, view.bufferViewIndex);
+		if (!bytes.empty())
+		{
+			decoded = decodeImageFromMemory(bytes.data(), bytes.size());
+		}
+		if (!decoded)
+		{
+			fmt::print("Failed to load image from buffer: {}\n",
+			           stbi_failure_reason());
+		}
 	},
 	},
 	image.data);
 
-	// if any of the attempts to load the data failed, we havent written the
-	// image so handle is null
-	if (newImage.m_image == VK_NULL_HANDLE)
+	// KTX2 textures hold BC blocks, which the device may not sample
+	if (decoded.has_value() && decoded->m_format != VK_FORMAT_R8G8B8A8_UNORM &&
+	    !m_resourceManager->supportsBlockCompression())
 	{
-		return {};
+		fmt::print("Skipping block compressed image, the device has no BC "
+		           "support\n");
+		return std::nullopt;
 	}
-	else
+
+	return decoded;
+}
+
+// Hash of what a material's descriptor set and constants hold
+static uint64_t hashMaterial(const ImportedMaterial&                   material,
+                             const GltfPbrMaterial::MaterialResources& resources)
+{
+	uint64_t hash =
+	hashutil::xxhash64(&material.m_constants, sizeof(material.m_constants));
+	hash = hashutil::hashCombine(hash, static_cast<uint64_t>(material.m_passType));
+	for (const Texture* texture : {&resources.m_colorTexture,
+	                               &resources.m_metalRoughTexture,
+	                               &resources.m_normalTexture,
+	                               &resources.m_aoTexture})
 	{
-		return newImage;
+		hash = hashutil::hashCombine(hash, (uint64_t) texture->image.m_imageView);
+		hash = hashutil::hashCombine(hash, (uint64_t) texture->sampler);
 	}
+	return hash;
 }
 
-std::optional<std::shared_ptr<LoadedGLTF>>
-AssetLoader::loadGltf(AgniEngine* engine, std::filesystem::path filePath)
+// Content hash of what uploadImage puts on the GPU
+static uint64_t hashDecodedImage(const DecodedImage& decoded)
 {
-	fmt::print("Loading GLTF: {}\n", filePath.string());
+	uint64_t hash =
+	hashutil::hashCombine(decoded.m_format, decoded.m_levels.size());
+	hash = hashutil::hashCombine(
+	hash,
+	hashutil::xxhash64(&decoded.m_components, sizeof(decoded.m_components)));
+	for (const ImageMipLevel& level : decoded.m_levels)
+	{
+		hash = hashutil::hashCombine(hash, level.m_extent.width);
+		hash = hashutil::hashCombine(hash, level.m_extent.height);
+		hash = hashutil::hashCombine(hash, hashutil::xxhash64(level.m_texels));
+	}
+	return hash;
+}
 
-	std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
-	scene->m_creator                  = engine;
-	LoadedGLTF& file                  = *scene.get();
+// Content hash of the buffers uploadMesh creates for a mesh
+static uint64_t hashImportedMesh(const ImportedMesh& mesh)
+{
+	uint64_t hash = hashutil::hashCombine(
+	static_cast<uint64_t>(mesh.m_vertexFormat), hashutil::xxhash64(mesh.m_indices));
+	hash = hashutil::hashCombine(hash, hashutil::xxhash64(mesh.m_vertices));
+	hash = hashutil::hashCombine(hash, hashutil::xxhash64(mesh.m_packedVertices));
+	hash = hashutil::hashCombine(hash, hashutil::xxhash64(mesh.m_colors));
+	hash = hashutil::hashCombine(hash, hashutil::xxhash64(mesh.m_meshlets));
+	hash = hashutil::hashCombine(
+	hash, hashutil::xxhash64(&mesh.m_positionScale, sizeof(mesh.m_positionScale)));
+	hash = hashutil::hashCombine(
+	hash, hashutil::xxhash64(&mesh.m_positionOffset, sizeof(mesh.m_positionOffset)));
+	return hash;
+}
 
-	fastgltf::Parser parser {};
+AllocatedImage AssetLoader::uploadImage(const DecodedImage& decoded,
+                                        bool                mipmapped)
+{
+	// blocks can't be blitted, compressed images always bring their levels
+	if (decoded.m_levels.size() > 1 ||
+	    decoded.m_format != VK_FORMAT_R8G8B8A8_UNORM)
+	{
+		return m_resourceManager->createImage(decoded.m_levels,
+		                                      decoded.m_format,
+		                                      VK_IMAGE_USAGE_SAMPLED_BIT,
+		                                      decoded.m_components);
+	}
 
-	constexpr auto gltfOptions =
-	fastgltf::Options::DontRequireValidAssetMember |
-	fastgltf::Options::AllowDouble | fastgltf::Options::LoadGLBBuffers |
-	fastgltf::Options::LoadExternalBuffers;
-	fastgltf::Options::LoadExternalImages;
+	const ImageMipLevel& baseLevel = decoded.m_levels[0];
+	return m_resourceManager->createImage((void*) baseLevel.m_texels.data(),
+	                                      baseLevel.m_extent,
+	                                      VK_FORMAT_R8G8B8A8_UNORM,
+	                                      VK_IMAGE_USAGE_SAMPLED_BIT,
+	                                      mipmapped);
+}
 
-	auto data = fastgltf::GltfDataBuffer::FromPath(filePath);
+std::optional<AllocatedImage> AssetLoader::loadImage(fastgltf::Asset&   asset,
+                                                      fastgltf::Image&   image,
+                                                      const GltfBuffers& buffers,
+                                                      bool mipmapped)
+{
+	std::optional<DecodedImage> decoded = decodeImage(asset, image, buffers);
 
-	if (data.error() != fastgltf::Error::None)
+	// if any of the attempts to load the data failed, we havent decoded
+	// anything to upload
+	if (!decoded.has_value())
 	{
-		fmt::print("Failed to load glTF file: {} \n",
-		           fastgltf::to_underlying(data.error()));
 		return {};
 	}
 
-	fastgltf::Asset gltf;
+	return uploadImage(*decoded, mipmapped);
+}
 
-	std::filesystem::path path = filePath;
+// Where a primitive's vertices and indices land in its mesh before
+// identical primitives are removed
+struct PrimitiveRange
+{
+	uint32_t m_mesh;
+	uint32_t m_surface;
+	uint32_t m_firstVertex;
+	uint32_t m_vertexCount;
+	uint64_t m_hash; // of the vertices and primitive relative indices
+};
 
-	auto type = fastgltf::determineGltfFileType(data.get());
-	if (type == fastgltf::GltfType::glTF)
+// A primitive already imported, while its vertices are still contiguous
+struct KnownPrimitive
+{
+	uint32_t m_mesh;
+	uint32_t m_surface;
+	uint32_t m_firstVertex;
+	uint32_t m_vertexCount;
+};
+
+// Whether a known primitive holds exactly these vertices and indices, to
+// rule out hash collisions. The indices start counting at firstVertex.
+static bool isSamePrimitive(const ImportedMesh&       mesh,
+                            const KnownPrimitive&     known,
+                            std::span<const Vertex>   vertices,
+                            std::span<const uint32_t> indices,
+                            uint32_t                  firstVertex)
+{
+	const ImportedSurface& surface = mesh.m_surfaces[known.m_surface];
+	if (known.m_vertexCount != vertices.size() || surface.m_count != indices.size())
 	{
-		auto load =
-		parser.loadGltf(data.get(), path.parent_path(), gltfOptions);
-		if (load)
-		{
-			gltf = std::move(load.get());
-		}
-		else
-		{
-			fmt::print("Failed to parse glTF: {} \n",
-			           fastgltf::to_underlying(load.error()));
-			return {};
-		}
+		return false;
 	}
-	else if (type == fastgltf::GltfType::GLB)
+
+	for (size_t i = 0; i < indices.size(); i++)
 	{
-		auto load =
-		parser.loadGltfBinary(data.get(), path.parent_path(), gltfOptions);
-		if (load)
+		if (mesh.m_indexStorage[surface.m_startIndex + i] - known.m_firstVertex !=
+		    indices[i] - firstVertex)
 		{
-			gltf = std::move(load.get());
-		}
-		else
-		{
-			fmt::print("Failed to parse glTF: {} \n",
-			           fastgltf::to_underlying(load.error()));
-			return {};
+			return false;
 		}
 	}
-	else
+	return std::memcmp(mesh.m_vertexStorage.data() + known.m_firstVertex,
+	                   vertices.data(),
+	                   vertices.size_bytes()) == 0;
+}
+
+// Load a primitive's indices and vertex attributes into its pre-sized ranges
+// of the mesh, generate missing tangents and compute its bounds. Nothing
+// outside those ranges is written, so primitives can load in parallel.
+static void importPrimitive(const fastgltf::Asset&     gltf,
+                            const GltfBuffers&         buffers,
+                            const fastgltf::Primitive& p,
+                            std::string_view           meshName,
+                            PrimitiveRange&            range,
+                            std::span<Vertex>          meshVertices,
+                            std::span<uint32_t>        indices,
+                            Bounds&                    bounds)
+{
+	const size_t      initial_vtx = range.m_firstVertex;
+	std::span<Vertex> vertices =
+	meshVertices.subspan(range.m_firstVertex, range.m_vertexCount);
+
+	// plain float attributes and indices are copied in bulk, anything that
+	// needs converting goes through fastgltf one element at a time
+
+	// load indexes
+	const fastgltf::Accessor& indexAccessor =
+	gltf.accessors[p.indicesAccessor.value()];
+	if (!accessorutil::readIndices(
+	    gltf, indexAccessor, buffers, indices, static_cast<uint32_t>(initial_vtx)))
 	{
-		fmt::print("Failed to determine glTF container \n");
-		return {};
+		fastgltf::iterateAccessorWithIndex<std::uint32_t>(
+		gltf,
+		indexAccessor,
+		[&](std::uint32_t idx, size_t index)
+		{ indices[index] = static_cast<uint32_t>(idx + initial_vtx); },
+		buffers);
+	}
+
+	// load vertex positions, the bulk copy finds the bounds as it goes
+	const fastgltf::Accessor& positionAccessor =
+	gltf.accessors[p.findAttribute("POSITION")->accessorIndex];
+	glm::vec3 minpos;
+	glm::vec3 maxpos;
+	bool      haveBounds = accessorutil::readPositions(
+	gltf, positionAccessor, buffers, vertices, minpos, maxpos);
+	if (!haveBounds)
+	{
+		fastgltf::iterateAccessorWithIndex<glm::vec3>(
+		gltf,
+		positionAccessor,
+		[&](glm::vec3 v, size_t index)
+		{
+			Vertex newvtx;
+			newvtx.m_position = v;
+			newvtx.m_normal   = {1, 0, 0};
+			newvtx.m_color    = glm::vec4 {1.f};
+			newvtx.m_uv_x     = 0;
+			newvtx.m_uv_y     = 0;
+			newvtx.m_tangent  = {0, 0, 0, 0};
+			vertices[index]   = newvtx;
+		},
+		buffers);
 	}
 
-	// we can stimate the descriptors we will need accurately
-	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
-	{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3},
-	{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3},
-	{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+	// load vertex normals
+	auto normals = p.findAttribute("NORMAL");
+	if (normals != p.attributes.end() &&
+	    !accessorutil::readNormals(
+	    gltf, gltf.accessors[(*normals).accessorIndex], buffers, vertices))
+	{
+		fastgltf::iterateAccessorWithIndex<glm::vec3>(
+		gltf,
+		gltf.accessors[(*normals).accessorIndex],
+		[&](glm::vec3 v, size_t index) { vertices[index].m_normal = v; },
+		buffers);
+	}
 
-	file.m_descriptorPool.init(engine->m_device, gltf.materials.size(), sizes);
+	// load UVs
+	auto uv = p.findAttribute("TEXCOORD_0");
+	if (uv != p.attributes.end() &&
+	    !accessorutil::readTexcoords(
+	    gltf, gltf.accessors[(*uv).accessorIndex], buffers, vertices))
+	{
+		fastgltf::iterateAccessorWithIndex<glm::vec2>(
+		gltf,
+		gltf.accessors[(*uv).accessorIndex],
+		[&](glm::vec2 v, size_t index)
+		{
+			vertices[index].m_uv_x = v.x;
+			vertices[index].m_uv_y = v.y;
+		},
+		buffers);
+	}
 
-	// Map glTF samplers to shared samplers
-	// Instead of creating new samplers, we map to our shared samplers
-	std::vector<VkSampler> samplerMapping;
-	for (fastgltf::Sampler& sampler : gltf.samplers)
+	// load vertex colors
+	auto colors = p.findAttribute("COLOR_0");
+	if (colors != p.attributes.end() &&
+	    !accessorutil::readColors(
+	    gltf, gltf.accessors[(*colors).accessorIndex], buffers, vertices))
 	{
-		VkFilter magFilter =
-		extractFilter(sampler.magFilter.value_or(fastgltf::Filter::Linear));
-		VkFilter minFilter =
-		extractFilter(sampler.minFilter.value_or(fastgltf::Filter::Linear));
-		VkSamplerMipmapMode mipmapMode = extractMipmapMode(
-		sampler.minFilter.value_or(fastgltf::Filter::Linear));
+		fastgltf::iterateAccessorWithIndex<glm::vec4>(
+		gltf,
+		gltf.accessors[(*colors).accessorIndex],
+		[&](glm::vec4 v, size_t index) { vertices[index].m_color = v; },
+		buffers);
+	}
 
-		// Select appropriate shared sampler based on filter settings
-		VkSampler sharedSampler;
-		if (magFilter == VK_FILTER_LINEAR && minFilter == VK_FILTER_LINEAR)
+	// load tangents if available, otherwise generate them
+	auto tangents = p.findAttribute("TANGENT");
+	if (tangents != p.attributes.end())
+	{
+		// Use tangents from GLTF file
+		const fastgltf::Accessor& tangentAccessor =
+		gltf.accessors[(*tangents).accessorIndex];
+		if (!accessorutil::readTangents(gltf, tangentAccessor, buffers, vertices))
 		{
-			sharedSampler = (mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR)
-			                ? m_linearMipmapSampler
-			                : m_linearSampler;
+			fastgltf::iterateAccessorWithIndex<glm::vec4>(
+			gltf,
+			tangentAccessor,
+			[&](glm::vec4 v, size_t index) { vertices[index].m_tangent = v; },
+			buffers);
 		}
-		else
+	}
+	else
+	{
+		// Generate tangents using MikkTSpace, reading the primitive's
+		// indices in place
+		SMikkTSpaceInterface mikkInterface   = {};
+		mikkInterface.m_getNumFaces          = mikkGetNumFaces;
+		mikkInterface.m_getNumVerticesOfFace = mikkGetNumVerticesOfFace;
+		mikkInterface.m_getPosition          = mikkGetPosition;
+		mikkInterface.m_getNormal            = mikkGetNormal;
+		mikkInterface.m_getTexCoord          = mikkGetTexCoord;
+		mikkInterface.m_setTSpaceBasic       = mikkSetTSpaceBasic;
+
+		MikkTSpaceUserData userData = {};
+		userData.vertices           = meshVertices;
+		userData.indices            = indices;
+
+		SMikkTSpaceContext mikkContext = {};
+		mikkContext.m_pInterface       = &mikkInterface;
+		mikkContext.m_pUserData        = &userData;
+
+		if (!genTangSpaceDefault(&mikkContext))
 		{
-			sharedSampler = (mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR)
-			                ? m_nearestMipmapSampler
-			                : m_nearestSampler;
+			fmt::print("Warning: Failed to generate tangents for mesh: {}\n",
+			           meshName);
 		}
+	}
 
-		samplerMapping.push_back(sharedSampler);
+	// loop the vertices of this surface, find min/max bounds
+	if (!vertices.empty())
+	{
+		if (!haveBounds)
+		{
+			minpos = vertices[0].m_position;
+			maxpos = vertices[0].m_position;
+			for (const Vertex& vertex : vertices)
+			{
+				minpos = glm::min(minpos, vertex.m_position);
+				maxpos = glm::max(maxpos, vertex.m_position);
+			}
+		}
+		// calculate origin and extents from the min/max, use extent lenght
+		// for radius
+		bounds.m_origin       = (maxpos + minpos) / 2.f;
+		bounds.m_extents      = (maxpos - minpos) / 2.f;
+		bounds.m_sphereRadius = glm::length(bounds.m_extents);
 	}
 
-	// temporal arrays for all the objects to use while creating the GLTF data
-	std::vector<std::shared_ptr<MeshAsset>>    meshes;
-	std::vector<std::shared_ptr<Node>>         nodes;
-	std::vector<AllocatedImage>                images;
-	std::vector<std::shared_ptr<GLTFMaterial>> materials;
+	// hashed here while the primitive is on its own, duplicates are removed
+	// afterwards in mesh order. The indices are made primitive relative in
+	// place for the hash rather than in a copy.
+	for (uint32_t& index : indices)
+	{
+		index -= range.m_firstVertex;
+	}
+	range.m_hash = hashutil::hashCombine(
+	hashutil::xxhash64(std::span<const Vertex>(vertices)),
+	hashutil::xxhash64(std::span<const uint32_t>(indices)));
+	for (uint32_t& index : indices)
+	{
+		index += range.m_firstVertex;
+	}
+}
 
-	// we have to load everything in order. MeshNodes depend on meshes, meshes
-	// depend on materials, and materials on textures.
+// Merge duplicated vertices of an imported mesh, across all its primitives.
+// Returns the number of vertices removed.
+static size_t weldMesh(ImportedMesh& mesh, const vertexweld::Tolerances& tolerances)
+{
+	size_t removed = vertexweld::weldVertices(
+	mesh.m_vertexStorage, mesh.m_indexStorage, tolerances);
 
-	// load all textures
-	int imageIndex = 0;
-	for (fastgltf::Image& image : gltf.images)
-	{
-		std::optional<AllocatedImage> img =
-		loadImage(gltf, image, true);
+	mesh.m_vertices = mesh.m_vertexStorage;
+	return removed;
+}
 
-		// Generate a unique name for this image (use name if available,
-		// otherwise use index)
-		std::string imageName = image.name.c_str();
-		if (imageName.empty())
+// Build the simplified versions of every surface of an imported mesh, each
+// about half the triangles of the one before. Their indices are appended to
+// the mesh's index storage. Returns the number of LODs built.
+static uint32_t buildSurfaceLods(ImportedMesh& mesh)
+{
+	// below this a surface isn't worth simplifying further
+	constexpr uint32_t MIN_LOD_TRIANGLES = 32;
+
+	const size_t meshVertexCount = mesh.m_vertexStorage.size();
+	uint32_t     lodCount        = 0;
+
+	for (ImportedSurface& surface : mesh.m_surfaces)
+	{
+		// shared surfaces use the LODs of their source
+		if (surface.m_sourceSurface >= 0)
 		{
-			imageName = "image_" + std::to_string(imageIndex);
+			continue;
 		}
 
-		if (img.has_value())
+		std::vector<uint32_t> sourceIndices(
+		mesh.m_indexStorage.begin() + surface.m_startIndex,
+		mesh.m_indexStorage.begin() + surface.m_startIndex + surface.m_count);
+		if (std::any_of(sourceIndices.begin(),
+		                sourceIndices.end(),
+		                [&](uint32_t index) { return index >= meshVertexCount; }))
 		{
-			images.push_back(*img);
-			file.m_images[imageName] =
-			*img; // Always store in map with a valid key
+			continue;
 		}
-		else
+
+		// every level starts from the full surface so errors don't add up
+		size_t previousCount = surface.m_count;
+		float  previousError = 0.f;
+		while (surface.m_lodCount < MAX_SURFACE_LODS &&
+		       previousCount >= MIN_LOD_TRIANGLES * 3 * 2)
 		{
-			// we failed to load, so lets give the slot a default white texture
-			// to not completely break loading
-			images.push_back(m_errorCheckerboardTexture.image);
-			std::cout << "gltf failed to load texture " << image.name
-			          << std::endl;
+			size_t target = previousCount / 2;
+			target -= target % 3;
+
+			float                 error      = 0.f;
+			std::vector<uint32_t> lodIndices = meshsimplify::simplify(
+			sourceIndices, mesh.m_vertexStorage, target, error);
+
+			// stop once borders and seams keep it from getting much smaller
+			if (lodIndices.empty() || lodIndices.size() > previousCount * 3 / 4)
+			{
+				break;
+			}
+
+			SurfaceLod& lod  = surface.m_lods[surface.m_lodCount++];
+			lod.m_startIndex = (uint32_t) mesh.m_indexStorage.size();
+			lod.m_count      = (uint32_t) lodIndices.size();
+			lod.m_error      = std::max(error, previousError);
+			mesh.m_indexStorage.insert(
+			mesh.m_indexStorage.end(), lodIndices.begin(), lodIndices.end());
+
+			previousCount = lodIndices.size();
+			previousError = lod.m_error;
+			lodCount++;
 		}
-		imageIndex++;
 	}
 
-	// create buffer to hold the material data
-	file.m_materialDataBuffer = engine->m_resourceManager.createBuffer(
-	sizeof(GltfPbrMaterial::MaterialConstants) * gltf.materials.size(),
-	VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-	VMA_MEMORY_USAGE_CPU_TO_GPU);
-	int                                 dataIndex = 0;
-	GltfPbrMaterial::MaterialConstants* sceneMaterialConstants =
-	(GltfPbrMaterial::MaterialConstants*)
-	file.m_materialDataBuffer.m_info.pMappedData;
+	mesh.m_indices = mesh.m_indexStorage;
+	return lodCount;
+}
 
-	for (fastgltf::Material& mat : gltf.materials)
-	{
-		std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
-		materials.push_back(newMat);
-		file.materials[mat.name.c_str()] = newMat;
+// Reorder the triangles of every primitive of an imported mesh, and of its
+// LODs, for the post-transform cache and overdraw, then the vertices of the
+// whole mesh for vertex fetch. Adds the vertex cache stats of the full
+// surfaces before and after to the given totals.
+static void optimizeMeshIndices(ImportedMesh&         mesh,
+                                indexopt::CacheStats& statsBefore,
+                                indexopt::CacheStats& statsAfter)
+{
+	constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
 
-		GltfPbrMaterial::MaterialConstants constants;
-		constants.m_colorFactors.x = mat.pbrData.baseColorFactor[0];
-		constants.m_colorFactors.y = mat.pbrData.baseColorFactor[1];
-		constants.m_colorFactors.z = mat.pbrData.baseColorFactor[2];
-		constants.m_colorFactors.w = mat.pbrData.baseColorFactor[3];
+	const size_t meshVertexCount = mesh.m_vertexStorage.size();
 
-		constants.m_metal_rough_factors.x = mat.pbrData.metallicFactor;
-		constants.m_metal_rough_factors.y = mat.pbrData.roughnessFactor;
-		// write material parameters to buffer
-		sceneMaterialConstants[dataIndex] = constants;
+	// primitives can share vertices after welding, so each one is optimized
+	// on a compact copy of the vertices it uses
+	std::vector<uint32_t> localIndex(meshVertexCount, UNUSED);
+	std::vector<uint32_t> meshIndex;
+	std::vector<Vertex>   localVertices;
+	std::vector<uint32_t> localIndices;
 
-		MaterialPass passType = MaterialPass::MainColor;
-		if (mat.alphaMode == fastgltf::AlphaMode::Blend)
+	auto optimizeRange = [&](uint32_t              startIndex,
+	                         uint32_t              count,
+	                         indexopt::CacheStats& before,
+	                         indexopt::CacheStats& after)
+	{
+		std::span<uint32_t> indices =
+		std::span(mesh.m_indexStorage).subspan(startIndex, count);
+
+		// leave primitives alone whose indices reach outside the mesh
+		if (std::any_of(indices.begin(),
+		                indices.end(),
+		                [&](uint32_t index) { return index >= meshVertexCount; }))
 		{
-			passType = MaterialPass::Transparent;
+			return;
 		}
 
-		GltfPbrMaterial::MaterialResources materialResources;
-		// default the material textures
-		materialResources.m_colorTexture      = m_whiteTexture;
-		materialResources.m_metalRoughTexture = m_whiteTexture;
-		materialResources.m_normalTexture     = m_whiteTexture;
-		materialResources.m_aoTexture         = m_whiteTexture;
-
-		// set the uniform buffer for the material data
-		materialResources.m_dataBuffer = file.m_materialDataBuffer.m_buffer;
-		materialResources.m_dataBufferOffset =
-		dataIndex * sizeof(GltfPbrMaterial::MaterialConstants);
-		// grab textures from gltf file
-		if (mat.pbrData.baseColorTexture.has_value())
+		meshIndex.clear();
+		localVertices.clear();
+		localIndices.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); i++)
 		{
-			size_t img =
-			gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex]
-			.imageIndex.value();
-			size_t sampler =
-			gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex]
-			.samplerIndex.value();
-
-			materialResources.m_colorTexture.image   = images[img];
-			materialResources.m_colorTexture.sampler = samplerMapping[sampler];
+			uint32_t index = indices[i];
+			if (localIndex[index] == UNUSED)
+			{
+				localIndex[index] = static_cast<uint32_t>(meshIndex.size());
+				meshIndex.push_back(index);
+				localVertices.push_back(mesh.m_vertexStorage[index]);
+			}
+			localIndices[i] = localIndex[index];
 		}
-		if (mat.pbrData.metallicRoughnessTexture.has_value())
-		{
-			size_t img =
-			gltf
-			.textures[mat.pbrData.metallicRoughnessTexture.value().textureIndex]
-			.imageIndex.value();
-			size_t sampler =
-			gltf
-			.textures[mat.pbrData.metallicRoughnessTexture.value().textureIndex]
-			.samplerIndex.value();
 
-			materialResources.m_metalRoughTexture.image   = images[img];
-			materialResources.m_metalRoughTexture.sampler = samplerMapping[sampler];
-		}
-		if (mat.normalTexture.has_value())
-		{
-			size_t img = gltf.textures[mat.normalTexture.value().textureIndex]
-			             .imageIndex.value();
-			size_t sampler =
-			gltf.textures[mat.normalTexture.value().textureIndex]
-			.samplerIndex.value();
+		const uint32_t vertexCount = static_cast<uint32_t>(localVertices.size());
+		before += indexopt::analyzeVertexCache(localIndices, vertexCount);
+		indexopt::optimizeVertexCache(localIndices, vertexCount);
+		indexopt::optimizeOverdraw(localIndices, localVertices);
+		after += indexopt::analyzeVertexCache(localIndices, vertexCount);
 
-			materialResources.m_normalTexture.image   = images[img];
-			materialResources.m_normalTexture.sampler = samplerMapping[sampler];
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			indices[i] = meshIndex[localIndices[i]];
 		}
-		if (mat.occlusionTexture.has_value())
+		for (uint32_t index : meshIndex)
 		{
-			size_t img =
-			gltf.textures[mat.occlusionTexture.value().textureIndex]
-			.imageIndex.value();
-			size_t sampler =
-			gltf.textures[mat.occlusionTexture.value().textureIndex]
-			.samplerIndex.value();
+			localIndex[index] = UNUSED;
+		}
+	};
 
-			materialResources.m_aoTexture.image   = images[img];
-			materialResources.m_aoTexture.sampler = samplerMapping[sampler];
+	indexopt::CacheStats lodStats;
+	for (const ImportedSurface& surface : mesh.m_surfaces)
+	{
+		if (surface.m_sourceSurface >= 0)
+		{
+			continue;
 		}
-		// build material
-		newMat->m_data = engine->m_assetLoader.getMaterialSystem().writeMaterial(
-		engine->m_device, passType, materialResources, file.m_descriptorPool);
 
-		dataIndex++;
+		optimizeRange(surface.m_startIndex, surface.m_count, statsBefore, statsAfter);
+		for (uint32_t l = 0; l < surface.m_lodCount; l++)
+		{
+			optimizeRange(surface.m_lods[l].m_startIndex,
+			              surface.m_lods[l].m_count,
+			              lodStats,
+			              lodStats);
+		}
 	}
 
-	// use the same vectors for all meshes so that the memory doesnt reallocate
-	// as
-	// often
-	std::vector<uint32_t> indices;
-	std::vector<Vertex>   vertices;
+	indexopt::optimizeVertexFetch(mesh.m_indexStorage, mesh.m_vertexStorage);
+}
 
-	for (fastgltf::Mesh& mesh : gltf.meshes)
+// Split every surface of an imported mesh into meshlets for GPU culling
+static void splitIntoMeshlets(ImportedMesh& mesh)
+{
+	for (ImportedSurface& surface : mesh.m_surfaces)
 	{
-		std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
-		meshes.push_back(newmesh);
-		file.meshes[mesh.name.c_str()] = newmesh;
-		newmesh->m_name                = mesh.name;
-
-		// clear the mesh arrays each mesh, we dont want to merge them by error
-		indices.clear();
-		vertices.clear();
-
-		for (auto&& p : mesh.primitives)
+		// shared surfaces use the meshlets of their source
+		if (surface.m_sourceSurface >= 0)
 		{
-			GeoSurface newSurface;
-			newSurface.m_startIndex = (uint32_t) indices.size();
-			newSurface.m_count =
-			(uint32_t) gltf.accessors[p.indicesAccessor.value()].count;
+			continue;
+		}
 
-			size_t initial_vtx = vertices.size();
+		surface.m_firstMeshlet = (uint32_t) mesh.m_meshletStorage.size();
+		meshletgen::buildMeshlets(mesh.m_indices,
+		                          surface.m_startIndex,
+		                          surface.m_count,
+		                          mesh.m_vertices,
+		                          mesh.m_meshletStorage);
+		surface.m_meshletCount =
+		(uint32_t) mesh.m_meshletStorage.size() - surface.m_firstMeshlet;
 
-			// load indexes
-			{
-				fastgltf::Accessor& indexaccessor =
-				gltf.accessors[p.indicesAccessor.value()];
-				indices.reserve(indices.size() + indexaccessor.count);
+		for (uint32_t l = 0; l < surface.m_lodCount; l++)
+		{
+			SurfaceLod& lod    = surface.m_lods[l];
+			lod.m_firstMeshlet = (uint32_t) mesh.m_meshletStorage.size();
+			meshletgen::buildMeshlets(mesh.m_indices,
+			                          lod.m_startIndex,
+			                          lod.m_count,
+			                          mesh.m_vertices,
+			                          mesh.m_meshletStorage);
+			lod.m_meshletCount =
+			(uint32_t) mesh.m_meshletStorage.size() - lod.m_firstMeshlet;
+		}
+	}
+	mesh.m_meshlets = mesh.m_meshletStorage;
+}
 
-				fastgltf::iterateAccessor<std::uint32_t>(
-				gltf,
-				indexaccessor,
-				[&](std::uint32_t idx)
-				{ indices.push_back(idx + initial_vtx); });
-			}
+// Switch an imported mesh over to the packed vertex layout, if it fits
+static void packMesh(ImportedMesh& mesh)
+{
+	if (!vertexpack::canPack(mesh.m_vertices))
+	{
+		return;
+	}
 
-			// load vertex positions
-			{
-				fastgltf::Accessor& posAccessor =
-				gltf.accessors[p.findAttribute("POSITION")->accessorIndex];
-				vertices.resize(vertices.size() + posAccessor.count);
+	vertexpack::PackedMesh packed = vertexpack::packVertices(mesh.m_vertices);
 
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(
-				gltf,
-				posAccessor,
-				[&](glm::vec3 v, size_t index)
-				{
-					Vertex newvtx;
-					newvtx.m_position             = v;
-					newvtx.m_normal               = {1, 0, 0};
-					newvtx.m_color                = glm::vec4 {1.f};
-					newvtx.m_uv_x                 = 0;
-					newvtx.m_uv_y                 = 0;
-					newvtx.m_tangent              = {0, 0, 0, 0};
-					vertices[initial_vtx + index] = newvtx;
-				});
-			}
+	mesh.m_vertexFormat        = VertexFormat::Packed;
+	mesh.m_positionScale       = packed.m_positionScale;
+	mesh.m_positionOffset      = packed.m_positionOffset;
+	mesh.m_packedVertexStorage = std::move(packed.m_vertices);
+	mesh.m_colorStorage        = std::move(packed.m_colors);
+	mesh.m_packedVertices      = mesh.m_packedVertexStorage;
+	mesh.m_colors              = mesh.m_colorStorage;
 
-			// load vertex normals
-			auto normals = p.findAttribute("NORMAL");
-			if (normals != p.attributes.end())
-			{
+	// the full vertices are no longer needed
+	mesh.m_vertices = {};
+	std::vector<Vertex>().swap(mesh.m_vertexStorage);
+}
 
-				fastgltf::iterateAccessorWithIndex<glm::vec3>(
-				gltf,
-				gltf.accessors[(*normals).accessorIndex],
-				[&](glm::vec3 v, size_t index)
-				{ vertices[initial_vtx + index].m_normal = v; });
-			}
+bool AssetLoader::loadImportedScene(const std::filesystem::path& filePath,
+                                    ImportedScene&               imported,
+                                    bool&                        cacheHit)
+{
+	// Only binary glTF files are cached: their content hash covers everything
+	// the import reads, while a .gltf can pull in external buffers and images
+	// that could change behind our back.
+	bool                  useCache   = false;
+	uint64_t              sourceHash = 0;
+	uint64_t              sourceSize = 0;
+	std::filesystem::path cachePath;
+	if (m_sceneCacheEnabled)
+	{
+		MappedFile source;
+		if (source.open(filePath) && isBinaryGltf(source.bytes()))
+		{
+			// the vertex layout, index optimization, welding, LODs and
+			// texture compression change what gets baked, so they are part
+			// of the key. Compression counts as off without device support,
+			// so BC blocks are never read back on such a device.
+			sourceHash = hashutil::hashCombine(
+			hashutil::xxhash64(source.bytes()),
+			static_cast<uint64_t>(m_preferredVertexFormat));
+			sourceHash = hashutil::hashCombine(
+			sourceHash, m_indexOptimizationEnabled ? 1 : 0);
+			sourceHash = hashutil::hashCombine(
+			sourceHash,
+			hashutil::xxhash64(&m_weldTolerances, sizeof(m_weldTolerances)));
+			sourceHash =
+			hashutil::hashCombine(sourceHash, m_lodGenerationEnabled ? 1 : 0);
+			sourceHash =
+			hashutil::hashCombine(sourceHash, compressesTextures() ? 1 : 0);
+			sourceSize = source.size();
+			cachePath  = scenecache::getCachePath(filePath);
+			useCache   = true;
+		}
+	}
 
-			// load UVs
-			auto uv = p.findAttribute("TEXCOORD_0");
-			if (uv != p.attributes.end())
-			{
+	cacheHit =
+	useCache && scenecache::read(cachePath, sourceHash, sourceSize, imported);
 
-				fastgltf::iterateAccessorWithIndex<glm::vec2>(
-				gltf,
-				gltf.accessors[(*uv).accessorIndex],
-				[&](glm::vec2 v, size_t index)
+	if (!cacheHit)
+	{
+		// cached images are stored with their whole mip chain, so build it on
+		// the CPU while decoding instead of blitting it on the GPU
+		if (!importGltf(filePath, useCache, imported))
+		{
+			return false;
+		}
+
+		if (useCache &&
+		    !scenecache::write(cachePath, sourceHash, sourceSize, imported))
+		{
+			fmt::print("Failed to write scene cache: {}\n", cachePath.string());
+		}
+	}
+	return true;
+}
+
+std::optional<std::shared_ptr<LoadedGLTF>>
+AssetLoader::loadGltf(AgniEngine* engine, std::filesystem::path filePath)
+{
+	fmt::print("Loading GLTF: {}\n", filePath.string());
+
+	auto loadStart = std::chrono::system_clock::now();
+	// heap allocations on all threads, to keep an eye on import overhead
+	uint64_t loadAllocations = allocstats::getAllocationCount();
+
+	// taken before reading, so a save while we load triggers a reload
+	std::error_code                 error;
+	std::filesystem::file_time_type writeTime =
+	std::filesystem::last_write_time(filePath, error);
+
+	ImportedScene imported;
+	bool          cacheHit = false;
+	if (!loadImportedScene(filePath, imported, cacheHit))
+	{
+		return {};
+	}
+
+	auto     buildStart       = std::chrono::system_clock::now();
+	uint64_t buildAllocations = allocstats::getAllocationCount();
+
+	std::shared_ptr<LoadedGLTF> scene = buildScene(engine, imported);
+	scene->m_sourcePath               = filePath;
+	scene->m_sourceWriteTime          = writeTime;
+
+	auto     buildEnd       = std::chrono::system_clock::now();
+	uint64_t endAllocations = allocstats::getAllocationCount();
+
+	auto importTime = std::chrono::duration_cast<std::chrono::microseconds>(
+	buildStart - loadStart);
+	auto buildTime = std::chrono::duration_cast<std::chrono::microseconds>(
+	buildEnd - buildStart);
+	fmt::print("Scene {} in {:.2f} ms, GPU build queued in {:.2f} ms\n",
+	           cacheHit ? "read from cache" : "imported",
+	           importTime.count() / 1000.f,
+	           buildTime.count() / 1000.f);
+	fmt::print("Heap allocations: {} to import, {} to build\n",
+	           buildAllocations - loadAllocations,
+	           endAllocations - buildAllocations);
+
+	return scene;
+}
+
+bool AssetLoader::reloadGltf(AgniEngine* engine, std::shared_ptr<LoadedGLTF>& scene)
+{
+	fmt::print("Reloading GLTF: {}\n", scene->m_sourcePath.string());
+
+	auto reloadStart = std::chrono::system_clock::now();
+
+	std::error_code                 error;
+	std::filesystem::file_time_type writeTime =
+	std::filesystem::last_write_time(scene->m_sourcePath, error);
+
+	// a failed reload keeps the old scene until the next save
+	scene->m_sourceWriteTime = writeTime;
+
+	ImportedScene imported;
+	bool          cacheHit = false;
+	if (!loadImportedScene(scene->m_sourcePath, imported, cacheHit))
+	{
+		fmt::print("Reload failed, keeping the loaded scene\n");
+		return false;
+	}
+
+	// material sets are rewritten in place and the old scene's meshes and
+	// images released below, none of which may be in flight. Uploads submit
+	// from other threads, and waiting for the device needs every queue.
+	{
+		std::unique_lock queueLock =
+		engine->m_resourceManager.getUploadQueue().lockQueues();
+		vkDeviceWaitIdle(engine->m_device);
+	}
+
+	// the new scene picks up everything it shares with the old one before
+	// the old one lets go of it, so unchanged meshes and images stay put
+	std::shared_ptr<LoadedGLTF> reloaded =
+	buildScene(engine, imported, scene.get());
+	reloaded->m_sourcePath      = scene->m_sourcePath;
+	reloaded->m_sourceWriteTime = writeTime;
+	scene                       = reloaded;
+
+	auto reloadEnd = std::chrono::system_clock::now();
+
+	auto reloadTime = std::chrono::duration_cast<std::chrono::microseconds>(
+	reloadEnd - reloadStart);
+	fmt::print("Scene reloaded in {:.2f} ms\n", reloadTime.count() / 1000.f);
+	return true;
+}
+
+void AssetLoader::reloadChangedScenes(
+AgniEngine*                                                   engine,
+std::unordered_map<std::string, std::shared_ptr<LoadedGLTF>>& scenes)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (!m_hotReloadEnabled ||
+	    now - m_lastReloadCheck < std::chrono::milliseconds(500))
+	{
+		return;
+	}
+	m_lastReloadCheck = now;
+
+	// only the glTF file itself is watched, not external buffers or images
+	for (auto& [name, scene] : scenes)
+	{
+		if (scene->m_sourcePath.empty())
+		{
+			continue;
+		}
+
+		std::error_code                 error;
+		std::filesystem::file_time_type writeTime =
+		std::filesystem::last_write_time(scene->m_sourcePath, error);
+		if (!error && writeTime != scene->m_sourceWriteTime)
+		{
+			reloadGltf(engine, scene);
+		}
+	}
+}
+
+bool AssetLoader::importGltf(const std::filesystem::path& filePath,
+                             bool                         buildMips,
+                             ImportedScene&               scene)
+{
+	// KTX2 images are referenced through KHR_texture_basisu, quantized
+	// attributes are read through the accessors like float ones
+	fastgltf::Parser parser {fastgltf::Extensions::KHR_texture_basisu |
+	                         fastgltf::Extensions::KHR_mesh_quantization |
+	                         fastgltf::Extensions::EXT_meshopt_compression |
+	                         fastgltf::Extensions::EXT_mesh_gpu_instancing};
+
+	// mapped input leaves external buffers to GltfBuffers, which maps them
+	// too, so accessors and embedded images are read from the page cache
+	// instead of being copied into owned vectors first
+	fastgltf::Options gltfOptions =
+	fastgltf::Options::DontRequireValidAssetMember |
+	fastgltf::Options::AllowDouble;
+	if (!m_mappedInputEnabled)
+	{
+		gltfOptions = gltfOptions | fastgltf::Options::LoadGLBBuffers |
+		              fastgltf::Options::LoadExternalBuffers;
+	}
+
+	auto data = openGltfData(filePath, m_mappedInputEnabled);
+	if (!data)
+	{
+		return false;
+	}
+
+	fastgltf::Asset gltf;
+
+	std::filesystem::path path = filePath;
+
+	auto type = fastgltf::determineGltfFileType(*data);
+	if (type == fastgltf::GltfType::glTF)
+	{
+		auto load = parser.loadGltf(*data, path.parent_path(), gltfOptions);
+		if (load)
+		{
+			gltf = std::move(load.get());
+		}
+		else
+		{
+			fmt::print("Failed to parse glTF: {} \n",
+			           fastgltf::to_underlying(load.error()));
+			return false;
+		}
+	}
+	else if (type == fastgltf::GltfType::GLB)
+	{
+		auto load =
+		parser.loadGltfBinary(*data, path.parent_path(), gltfOptions);
+		if (load)
+		{
+			gltf = std::move(load.get());
+		}
+		else
+		{
+			fmt::print("Failed to parse glTF: {} \n",
+			           fastgltf::to_underlying(load.error()));
+			return false;
+		}
+	}
+	else
+	{
+		fmt::print("Failed to determine glTF container \n");
+		return false;
+	}
+
+	GltfBuffers buffers;
+	if (!buffers.open(gltf, path.parent_path(), m_jobSystem))
+	{
+		fmt::print("Failed to load glTF buffers \n");
+		return false;
+	}
+
+	// the bookkeeping of the import comes from one arena, released in one go
+	// when it returns. Only filled from this thread, the workers just write
+	// into presized elements.
+	std::pmr::monotonic_buffer_resource scratch;
+
+	for (fastgltf::Sampler& sampler : gltf.samplers)
+	{
+		ImportedSampler newSampler;
+		newSampler.m_magFilter =
+		extractFilter(sampler.magFilter.value_or(fastgltf::Filter::Linear));
+		newSampler.m_minFilter =
+		extractFilter(sampler.minFilter.value_or(fastgltf::Filter::Linear));
+		newSampler.m_mipmapMode = extractMipmapMode(
+		sampler.minFilter.value_or(fastgltf::Filter::Linear));
+		scene.m_samplers.push_back(newSampler);
+	}
+
+	// KHR_texture_basisu textures may only name a KTX2 image, and textures
+	// may name no image we know how to load at all
+	auto getTextureImage = [&](size_t textureIndex) -> std::optional<size_t>
+	{
+		const fastgltf::Texture& texture = gltf.textures[textureIndex];
+		if (texture.imageIndex.has_value())
+		{
+			return texture.imageIndex.value();
+		}
+		if (texture.basisuImageIndex.has_value())
+		{
+			return texture.basisuImageIndex.value();
+		}
+		return std::nullopt;
+	};
+
+	// what each image is sampled as picks its block format and mip filter
+	std::pmr::vector<uint32_t> imageUsage(gltf.images.size(), 0, &scratch);
+	std::pmr::vector<mipgen::MipFilter> imageFilters(gltf.images.size(), &scratch);
+	for (const fastgltf::Material& mat : gltf.materials)
+	{
+		if (mat.pbrData.baseColorTexture.has_value())
+		{
+			std::optional<size_t> imageIndex =
+			getTextureImage(mat.pbrData.baseColorTexture->textureIndex);
+			if (imageIndex)
+			{
+				imageUsage[*imageIndex] |= texcompress::USAGE_COLOR;
+				if (mat.alphaMode == fastgltf::AlphaMode::Mask)
 				{
-					vertices[initial_vtx + index].m_uv_x = v.x;
-					vertices[initial_vtx + index].m_uv_y = v.y;
-				});
+					imageFilters[*imageIndex].m_alphaCutoff = mat.alphaCutoff;
+				}
 			}
-
-			// load vertex colors
-			auto colors = p.findAttribute("COLOR_0");
-			if (colors != p.attributes.end())
+		}
+		if (mat.pbrData.metallicRoughnessTexture.has_value())
+		{
+			if (std::optional<size_t> imageIndex = getTextureImage(
+			    mat.pbrData.metallicRoughnessTexture->textureIndex))
 			{
-
-				fastgltf::iterateAccessorWithIndex<glm::vec4>(
-				gltf,
-				gltf.accessors[(*colors).accessorIndex],
-				[&](glm::vec4 v, size_t index)
-				{ vertices[initial_vtx + index].m_color = v; });
+				imageUsage[*imageIndex] |= texcompress::USAGE_METAL_ROUGH;
 			}
-
-			// load tangents if available, otherwise generate them
-			auto tangents = p.findAttribute("TANGENT");
-			if (tangents != p.attributes.end())
+		}
+		if (mat.normalTexture.has_value())
+		{
+			if (std::optional<size_t> imageIndex =
+			    getTextureImage(mat.normalTexture->textureIndex))
 			{
-				// Use tangents from GLTF file
-				fastgltf::iterateAccessorWithIndex<glm::vec4>(
-				gltf,
-				gltf.accessors[(*tangents).accessorIndex],
-				[&](glm::vec4 v, size_t index)
-				{ vertices[initial_vtx + index].m_tangent = v; });
+				imageUsage[*imageIndex] |= texcompress::USAGE_NORMAL;
 			}
-			else
+		}
+		if (mat.occlusionTexture.has_value())
+		{
+			if (std::optional<size_t> imageIndex =
+			    getTextureImage(mat.occlusionTexture->textureIndex))
 			{
-				// Generate tangents using MikkTSpace
-				// Create a temporary index buffer for this primitive only
-				std::vector<uint32_t> primitiveIndices;
-				primitiveIndices.reserve(newSurface.m_count);
-				for (uint32_t i = newSurface.m_startIndex;
-				     i < newSurface.m_startIndex + newSurface.m_count;
-				     i++)
-				{
-					primitiveIndices.push_back(indices[i]);
-				}
+				imageUsage[*imageIndex] |= texcompress::USAGE_OCCLUSION;
+			}
+		}
+	}
+
+	// base color is sRGB encoded, the other maps hold linear data
+	for (size_t i = 0; i < gltf.images.size(); i++)
+	{
+		imageFilters[i].m_srgb = imageUsage[i] == texcompress::USAGE_COLOR;
+	}
+
+	// decode all textures. Decoding is pure CPU work and independent per
+	// image, so it is spread across the worker pool; the results keep the
+	// image index order. Compression needs the whole mip chain on the CPU.
+	auto decodeStart = std::chrono::system_clock::now();
+
+	const bool compressTextures = compressesTextures();
+	const bool buildMipChain =
+	buildMips || m_cpuMipGenerationEnabled || compressTextures;
+
+	scene.m_images.resize(gltf.images.size());
+	m_jobSystem.parallelFor(
+	gltf.images.size(),
+	[&](size_t i)
+	{
+		ImportedImage& image = scene.m_images[i];
+		image.m_image        = decodeImage(gltf, gltf.images[i], buffers);
+		if (!image.m_image.has_value() ||
+		    image.m_image->m_format != VK_FORMAT_R8G8B8A8_UNORM)
+		{
+			return;
+		}
+		if (buildMipChain)
+		{
+			mipgen::buildMipChainRGBA8(image.m_image->m_levels,
+			                           image.m_image->m_mipTexels,
+			                           imageFilters[i]);
+		}
+		if (compressTextures)
+		{
+			texcompress::compress(*image.m_image, imageUsage[i]);
+		}
+	});
+
+	for (size_t imageIndex = 0; imageIndex < gltf.images.size(); imageIndex++)
+	{
+		fastgltf::Image& image = gltf.images[imageIndex];
 
-				// Setup MikkTSpace interface
-				SMikkTSpaceInterface mikkInterface   = {};
-				mikkInterface.m_getNumFaces          = mikkGetNumFaces;
-				mikkInterface.m_getNumVerticesOfFace = mikkGetNumVerticesOfFace;
-				mikkInterface.m_getPosition          = mikkGetPosition;
-				mikkInterface.m_getNormal            = mikkGetNormal;
-				mikkInterface.m_getTexCoord          = mikkGetTexCoord;
-				mikkInterface.m_setTSpaceBasic       = mikkSetTSpaceBasic;
-
-				// Setup user data
-				MikkTSpaceUserData userData = {};
-				userData.vertices           = &vertices;
-				userData.indices            = &primitiveIndices;
-				userData.vertexOffset       = initial_vtx;
-
-				// Setup context
-				SMikkTSpaceContext mikkContext = {};
-				mikkContext.m_pInterface       = &mikkInterface;
-				mikkContext.m_pUserData        = &userData;
-
-				// Generate tangents
-				if (!genTangSpaceDefault(&mikkContext))
+		// Generate a unique name for this image (use name if available,
+		// otherwise use index)
+		std::string imageName = image.name.c_str();
+		if (imageName.empty())
+		{
+			imageName = "image_" + std::to_string(imageIndex);
+		}
+		scene.m_images[imageIndex].m_name = imageName;
+
+		if (!scene.m_images[imageIndex].m_image.has_value())
+		{
+			std::cout << "gltf failed to load texture " << image.name
+			          << std::endl;
+		}
+	}
+
+	auto decodeEnd = std::chrono::system_clock::now();
+
+	auto decodeTime = std::chrono::duration_cast<std::chrono::microseconds>(
+	decodeEnd - decodeStart);
+	fmt::print("Images: {} decoded in {:.2f} ms on {} threads\n",
+	           gltf.images.size(),
+	           decodeTime.count() / 1000.f,
+	           m_jobSystem.getThreadCount());
+
+	size_t compressedCount = 0;
+	size_t rgbaSize        = 0;
+	size_t compressedSize  = 0;
+	for (const ImportedImage& image : scene.m_images)
+	{
+		if (!image.m_image.has_value() ||
+		    image.m_image->m_format == VK_FORMAT_R8G8B8A8_UNORM)
+		{
+			continue;
+		}
+		compressedCount++;
+		for (const ImageMipLevel& level : image.m_image->m_levels)
+		{
+			rgbaSize += texcompress::getLevelSize(VK_FORMAT_R8G8B8A8_UNORM,
+			                                      level.m_extent);
+			compressedSize += level.m_texels.size();
+		}
+	}
+	if (compressedCount > 0)
+	{
+		fmt::print("Images: {} block compressed, {:.1f} MB instead of "
+		           "{:.1f} MB\n",
+		           compressedCount,
+		           compressedSize / (1024.f * 1024.f),
+		           rgbaSize / (1024.f * 1024.f));
+	}
+
+	// resolve a glTF texture reference into image and sampler indices
+	auto importTexture = [&](size_t textureIndex)
+	{
+		const fastgltf::Texture& texture = gltf.textures[textureIndex];
+
+		ImportedTexture imported;
+		if (std::optional<size_t> imageIndex = getTextureImage(textureIndex))
+		{
+			imported.m_imageIndex = static_cast<int32_t>(*imageIndex);
+		}
+		else
+		{
+			std::cout << "gltf texture " << texture.name
+			          << " has no image we can load" << std::endl;
+			imported.m_imageIndex = ImportedTexture::MISSING_IMAGE;
+		}
+		if (texture.samplerIndex.has_value())
+		{
+			imported.m_samplerIndex =
+			static_cast<int32_t>(texture.samplerIndex.value());
+		}
+		return imported;
+	};
+
+	for (fastgltf::Material& mat : gltf.materials)
+	{
+		ImportedMaterial& newMat = scene.m_materials.emplace_back();
+		newMat.m_name            = mat.name.c_str();
+
+		GltfPbrMaterial::MaterialConstants constants;
+		constants.m_colorFactors.x = mat.pbrData.baseColorFactor[0];
+		constants.m_colorFactors.y = mat.pbrData.baseColorFactor[1];
+		constants.m_colorFactors.z = mat.pbrData.baseColorFactor[2];
+		constants.m_colorFactors.w = mat.pbrData.baseColorFactor[3];
+
+		constants.m_metal_rough_factors.x = mat.pbrData.metallicFactor;
+		constants.m_metal_rough_factors.y = mat.pbrData.roughnessFactor;
+		newMat.m_constants                = constants;
+
+		newMat.m_passType = MaterialPass::MainColor;
+		if (mat.alphaMode == fastgltf::AlphaMode::Blend)
+		{
+			newMat.m_passType = MaterialPass::Transparent;
+		}
+
+		// grab textures from gltf file
+		if (mat.pbrData.baseColorTexture.has_value())
+		{
+			newMat.m_colorTexture =
+			importTexture(mat.pbrData.baseColorTexture.value().textureIndex);
+		}
+		if (mat.pbrData.metallicRoughnessTexture.has_value())
+		{
+			newMat.m_metalRoughTexture = importTexture(
+			mat.pbrData.metallicRoughnessTexture.value().textureIndex);
+		}
+		if (mat.normalTexture.has_value())
+		{
+			newMat.m_normalTexture =
+			importTexture(mat.normalTexture.value().textureIndex);
+		}
+		if (mat.occlusionTexture.has_value())
+		{
+			newMat.m_occlusionTexture =
+			importTexture(mat.occlusionTexture.value().textureIndex);
+		}
+	}
+
+	// sized up front, the meshes are filled in place so their spans keep
+	// pointing at their own storage
+	scene.m_meshes.resize(gltf.meshes.size());
+
+	// lay out every primitive in its mesh first, so they can all load in
+	// parallel into disjoint ranges
+	auto primitiveStart = std::chrono::system_clock::now();
+
+	size_t primitiveCount = 0;
+	for (const fastgltf::Mesh& mesh : gltf.meshes)
+	{
+		primitiveCount += mesh.primitives.size();
+	}
+
+	std::pmr::vector<PrimitiveRange> primitives(&scratch);
+	primitives.reserve(primitiveCount);
+	for (size_t meshIndex = 0; meshIndex < gltf.meshes.size(); meshIndex++)
+	{
+		fastgltf::Mesh& mesh    = gltf.meshes[meshIndex];
+		ImportedMesh&   newmesh = scene.m_meshes[meshIndex];
+		newmesh.m_name          = mesh.name;
+		newmesh.m_surfaces.reserve(mesh.primitives.size());
+
+		size_t vertexCount = 0;
+		size_t indexCount  = 0;
+		for (auto&& p : mesh.primitives)
+		{
+			ImportedSurface newSurface;
+			newSurface.m_startIndex = (uint32_t) indexCount;
+			newSurface.m_count =
+			(uint32_t) gltf.accessors[p.indicesAccessor.value()].count;
+			newSurface.m_materialIndex =
+			static_cast<uint32_t>(p.materialIndex.value_or(0));
+
+			size_t primitiveVertexCount =
+			gltf.accessors[p.findAttribute("POSITION")->accessorIndex].count;
+			primitives.push_back({(uint32_t) meshIndex,
+			                      (uint32_t) newmesh.m_surfaces.size(),
+			                      (uint32_t) vertexCount,
+			                      (uint32_t) primitiveVertexCount,
+			                      0});
+
+			vertexCount += primitiveVertexCount;
+			indexCount += newSurface.m_count;
+			newmesh.m_surfaces.push_back(newSurface);
+		}
+
+		newmesh.m_vertexStorage.resize(vertexCount);
+		newmesh.m_indexStorage.resize(indexCount);
+	}
+
+	m_jobSystem.parallelFor(primitives.size(),
+	                        [&](size_t i)
+	                        {
+		                        PrimitiveRange&  range   = primitives[i];
+		                        ImportedMesh&    newmesh = scene.m_meshes[range.m_mesh];
+		                        ImportedSurface& surface =
+		                        newmesh.m_surfaces[range.m_surface];
+		                        const fastgltf::Mesh& mesh = gltf.meshes[range.m_mesh];
+
+		                        importPrimitive(
+		                        gltf,
+		                        buffers,
+		                        mesh.primitives[range.m_surface],
+		                        mesh.name,
+		                        range,
+		                        newmesh.m_vertexStorage,
+		                        std::span(newmesh.m_indexStorage)
+		                        .subspan(surface.m_startIndex, surface.m_count),
+		                        surface.m_bounds);
+	                        });
+
+	auto primitiveEnd = std::chrono::system_clock::now();
+
+	auto primitiveTime = std::chrono::duration_cast<std::chrono::microseconds>(
+	primitiveEnd - primitiveStart);
+	fmt::print("Primitives: {} loaded in {:.2f} ms on {} threads\n",
+	           primitives.size(),
+	           primitiveTime.count() / 1000.f,
+	           m_jobSystem.getThreadCount());
+
+	// exporters often repeat the same primitive across meshes: draw such
+	// copies from the first one's index range. The primitives left are moved
+	// down over the copies, which gives the same layout as loading them one
+	// after the other.
+	std::pmr::unordered_map<uint64_t, KnownPrimitive> primitiveHashes(&scratch);
+	primitiveHashes.reserve(primitives.size());
+	std::pmr::vector<size_t> sharedBytes(gltf.meshes.size(), 0, &scratch);
+	std::pmr::vector<size_t> sharedSurfaceCounts(gltf.meshes.size(), 0, &scratch);
+
+	size_t nextPrimitive = 0;
+	for (size_t meshIndex = 0; meshIndex < gltf.meshes.size(); meshIndex++)
+	{
+		ImportedMesh&          newmesh  = scene.m_meshes[meshIndex];
+		std::vector<uint32_t>& indices  = newmesh.m_indexStorage;
+		std::vector<Vertex>&   vertices = newmesh.m_vertexStorage;
+
+		uint32_t vertexCursor = 0;
+		uint32_t indexCursor  = 0;
+		for (ImportedSurface& surface : newmesh.m_surfaces)
+		{
+			const PrimitiveRange& range = primitives[nextPrimitive++];
+
+			std::span<const Vertex> primitiveVertices =
+			std::span(vertices).subspan(range.m_firstVertex, range.m_vertexCount);
+			std::span<uint32_t> primitiveIndices =
+			std::span(indices).subspan(surface.m_startIndex, surface.m_count);
+
+			auto [known, inserted] = primitiveHashes.try_emplace(
+			range.m_hash,
+			KnownPrimitive {(uint32_t) meshIndex,
+			                range.m_surface,
+			                vertexCursor,
+			                range.m_vertexCount});
+			if (!inserted)
+			{
+				const KnownPrimitive& source = known->second;
+				if (isSamePrimitive(scene.m_meshes[source.m_mesh],
+				                    source,
+				                    primitiveVertices,
+				                    primitiveIndices,
+				                    range.m_firstVertex))
 				{
-					fmt::print(
-					"Warning: Failed to generate tangents for mesh: {}\n",
-					mesh.name);
+					sharedBytes[meshIndex] += primitiveVertices.size_bytes() +
+					                          primitiveIndices.size_bytes();
+					sharedSurfaceCounts[meshIndex]++;
+
+					surface.m_sourceMesh    = (int32_t) source.m_mesh;
+					surface.m_sourceSurface = (int32_t) source.m_surface;
+					surface.m_startIndex    = indexCursor;
+					continue;
 				}
 			}
 
-			if (p.materialIndex.has_value())
+			if (vertexCursor != range.m_firstVertex)
 			{
-				newSurface.m_material = materials[p.materialIndex.value()];
+				std::copy(primitiveVertices.begin(),
+				          primitiveVertices.end(),
+				          vertices.begin() + vertexCursor);
 			}
-			else
+			for (size_t i = 0; i < primitiveIndices.size(); i++)
 			{
-				newSurface.m_material = materials[0];
+				indices[indexCursor + i] =
+				primitiveIndices[i] - range.m_firstVertex + vertexCursor;
 			}
 
-			// loop the vertices of this surface, find min/max bounds
-			glm::vec3 minpos = vertices[initial_vtx].m_position;
-			glm::vec3 maxpos = vertices[initial_vtx].m_position;
-			for (int i = initial_vtx; i < vertices.size(); i++)
+			surface.m_startIndex = indexCursor;
+			vertexCursor += range.m_vertexCount;
+			indexCursor += surface.m_count;
+		}
+
+		vertices.resize(vertexCursor);
+		indices.resize(indexCursor);
+		newmesh.m_vertices = vertices;
+		newmesh.m_indices  = indices;
+	}
+
+	// LODs are simplified from the welded vertices and then optimized like
+	// the full surfaces. Meshlets are cut from the final triangle order, and
+	// their bounds come from the full precision positions, so they are built
+	// after the index optimization and before the vertices get converted to
+	// the compact layout.
+	const bool optimize  = m_indexOptimizationEnabled;
+	const bool buildLods = m_lodGenerationEnabled;
+	const bool pack      = m_preferredVertexFormat == VertexFormat::Packed;
+	const vertexweld::Tolerances      weldTolerances = m_weldTolerances;
+	std::pmr::vector<size_t>   weldedCounts(scene.m_meshes.size(), 0, &scratch);
+	std::pmr::vector<uint32_t> lodCounts(scene.m_meshes.size(), 0, &scratch);
+	std::pmr::vector<indexopt::CacheStats> statsBefore(scene.m_meshes.size(), &scratch);
+	std::pmr::vector<indexopt::CacheStats> statsAfter(scene.m_meshes.size(), &scratch);
+	m_jobSystem.parallelFor(scene.m_meshes.size(),
+	                        [&](size_t i)
+	                        {
+		                        weldedCounts[i] =
+		                        weldMesh(scene.m_meshes[i], weldTolerances);
+		                        if (buildLods)
+		                        {
+			                        lodCounts[i] =
+			                        buildSurfaceLods(scene.m_meshes[i]);
+		                        }
+		                        if (optimize)
+		                        {
+			                        optimizeMeshIndices(scene.m_meshes[i],
+			                                            statsBefore[i],
+			                                            statsAfter[i]);
+		                        }
+		                        splitIntoMeshlets(scene.m_meshes[i]);
+		                        if (pack)
+		                        {
+			                        packMesh(scene.m_meshes[i]);
+		                        }
+	                        });
+
+	// shared surfaces take the final index and meshlet ranges of their source
+	for (ImportedMesh& mesh : scene.m_meshes)
+	{
+		for (ImportedSurface& surface : mesh.m_surfaces)
+		{
+			if (surface.m_sourceSurface >= 0)
 			{
-				minpos = glm::min(minpos, vertices[i].m_position);
-				maxpos = glm::max(maxpos, vertices[i].m_position);
+				const ImportedSurface& source =
+				scene.m_meshes[surface.m_sourceMesh]
+				.m_surfaces[surface.m_sourceSurface];
+				surface.m_startIndex   = source.m_startIndex;
+				surface.m_firstMeshlet = source.m_firstMeshlet;
+				surface.m_meshletCount = source.m_meshletCount;
+				surface.m_lodCount     = source.m_lodCount;
+				std::copy(std::begin(source.m_lods),
+				          std::end(source.m_lods),
+				          std::begin(surface.m_lods));
 			}
-			// calculate origin and extents from the min/max, use extent lenght
-			// for radius
-			newSurface.m_bounds.m_origin  = (maxpos + minpos) / 2.f;
-			newSurface.m_bounds.m_extents = (maxpos - minpos) / 2.f;
-			newSurface.m_bounds.m_sphereRadius =
-			glm::length(newSurface.m_bounds.m_extents);
+		}
+	}
 
-			newmesh->m_surfaces.push_back(newSurface);
+	size_t totalSavedBytes = 0;
+	for (size_t i = 0; i < scene.m_meshes.size(); i++)
+	{
+		size_t savedBytes = weldedCounts[i] * sizeof(Vertex) + sharedBytes[i];
+		if (savedBytes == 0)
+		{
+			continue;
 		}
+		totalSavedBytes += savedBytes;
+		fmt::print("Mesh {}: {} vertices welded, {} primitives shared, {:.2f} KB saved\n",
+		           scene.m_meshes[i].m_name,
+		           weldedCounts[i],
+		           sharedSurfaceCounts[i],
+		           savedBytes / 1024.f);
+	}
+	fmt::print("Welding and sharing saved {:.2f} MB\n",
+	           totalSavedBytes / (1024.f * 1024.f));
 
-		newmesh->m_meshBuffers = engine->m_resourceManager.uploadMesh(indices, vertices);
+	if (optimize)
+	{
+		indexopt::CacheStats totalBefore;
+		indexopt::CacheStats totalAfter;
+		for (size_t i = 0; i < scene.m_meshes.size(); i++)
+		{
+			totalBefore += statsBefore[i];
+			totalAfter += statsAfter[i];
+		}
+		fmt::print("Indices: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}\n",
+		           totalBefore.getAcmr(),
+		           totalAfter.getAcmr(),
+		           totalBefore.getAtvr(),
+		           totalAfter.getAtvr());
+	}
+
+	size_t fullVertexBytes  = 0;
+	size_t finalVertexBytes = 0;
+	size_t packedMeshCount  = 0;
+	size_t meshletCount     = 0;
+	for (const ImportedMesh& mesh : scene.m_meshes)
+	{
+		meshletCount += mesh.m_meshlets.size();
+		size_t vertexCount = mesh.m_vertexFormat == VertexFormat::Packed
+		                     ? mesh.m_packedVertices.size()
+		                     : mesh.m_vertices.size();
+		fullVertexBytes += vertexCount * sizeof(Vertex);
+		finalVertexBytes += mesh.m_vertices.size_bytes() +
+		                    mesh.m_packedVertices.size_bytes() +
+		                    mesh.m_colors.size_bytes();
+		packedMeshCount += mesh.m_vertexFormat == VertexFormat::Packed ? 1 : 0;
+	}
+	fmt::print("Vertices: {} of {} meshes packed, {:.2f} MB -> {:.2f} MB\n",
+	           packedMeshCount,
+	           scene.m_meshes.size(),
+	           fullVertexBytes / (1024.f * 1024.f),
+	           finalVertexBytes / (1024.f * 1024.f));
+	fmt::print("Meshlets: {} built\n", meshletCount);
+	if (buildLods)
+	{
+		uint32_t totalLods = 0;
+		for (uint32_t count : lodCounts)
+		{
+			totalLods += count;
+		}
+		fmt::print("LODs: {} built\n", totalLods);
 	}
 
-	// load all nodes and their meshes
+	// load all nodes and their transforms
 	for (fastgltf::Node& node : gltf.nodes)
 	{
-		std::shared_ptr<Node> newNode;
+		ImportedNode& newNode = scene.m_nodes.emplace_back();
+		newNode.m_name        = node.name.c_str();
 
-		// find if the node has a mesh, and if it does hook it to the mesh
-		// pointer and allocate it with the meshnode class
 		if (node.meshIndex.has_value())
 		{
-			newNode = std::make_shared<MeshNode>();
-			static_cast<MeshNode*>(newNode.get())->getMesh() =
-			meshes[*node.meshIndex];
+			newNode.m_meshIndex = static_cast<int32_t>(*node.meshIndex);
 		}
-		else
+
+		for (auto& c : node.children)
 		{
-			newNode = std::make_shared<Node>();
+			newNode.m_children.push_back(static_cast<uint32_t>(c));
 		}
 
-		nodes.push_back(newNode);
-		file.nodes[node.name.c_str()];
-
 		std::visit(
 		fastgltf::visitor {[&](fastgltf::math::fmat4x4 matrix)
 		                   {
-			                   memcpy(&newNode->getLocalTransform(),
+			                   memcpy(&newNode.m_localTransform,
 			                          matrix.data(),
 			                          sizeof(matrix));
 		                   },
@@ -897,18 +1805,453 @@ AssetLoader::loadGltf(AgniEngine* engine, std::filesystem::path filePath)
 			                   glm::mat4 rm = glm::toMat4(rot);
 			                   glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
 
-			                   newNode->getLocalTransform() = tm * rm * sm;
+			                   newNode.m_localTransform = tm * rm * sm;
 		                   }},
 		node.transform);
+
+		// EXT_mesh_gpu_instancing: per instance TRS, each attribute optional
+		std::pmr::vector<glm::vec3> translations(&scratch);
+		std::pmr::vector<glm::vec4> rotations(&scratch);
+		std::pmr::vector<glm::vec3> scales(&scratch);
+		for (const auto& attribute : node.instancingAttributes)
+		{
+			const fastgltf::Accessor& accessor =
+			gltf.accessors[attribute.accessorIndex];
+			if (attribute.name == "TRANSLATION")
+			{
+				translations.resize(accessor.count);
+				fastgltf::iterateAccessorWithIndex<glm::vec3>(
+				gltf,
+				accessor,
+				[&](glm::vec3 v, size_t index) { translations[index] = v; },
+				buffers);
+			}
+			else if (attribute.name == "ROTATION")
+			{
+				rotations.resize(accessor.count);
+				fastgltf::iterateAccessorWithIndex<glm::vec4>(
+				gltf,
+				accessor,
+				[&](glm::vec4 v, size_t index) { rotations[index] = v; },
+				buffers);
+			}
+			else if (attribute.name == "SCALE")
+			{
+				scales.resize(accessor.count);
+				fastgltf::iterateAccessorWithIndex<glm::vec3>(
+				gltf,
+				accessor,
+				[&](glm::vec3 v, size_t index) { scales[index] = v; },
+				buffers);
+			}
+		}
+
+		size_t instanceCount =
+		std::max({translations.size(), rotations.size(), scales.size()});
+		if (instanceCount > 0 && newNode.m_meshIndex >= 0)
+		{
+			newNode.m_instances.resize(instanceCount);
+			for (size_t i = 0; i < instanceCount; i++)
+			{
+				glm::vec3 tl = i < translations.size() ? translations[i]
+				                                       : glm::vec3(0.f);
+				glm::vec4 r  = i < rotations.size() ? rotations[i]
+				                                    : glm::vec4(0.f, 0.f, 0.f, 1.f);
+				glm::vec3 sc = i < scales.size() ? scales[i] : glm::vec3(1.f);
+
+				newNode.m_instances[i] =
+				glm::translate(glm::mat4(1.f), tl) *
+				glm::toMat4(glm::quat(r.w, r.x, r.y, r.z)) *
+				glm::scale(glm::mat4(1.f), sc);
+			}
+		}
+	}
+
+	return true;
+}
+
+std::shared_ptr<LoadedGLTF> AssetLoader::buildScene(AgniEngine*    engine,
+                                                    ImportedScene& imported,
+                                                    LoadedGLTF*    previous)
+{
+	std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
+	scene->m_creator                  = engine;
+	LoadedGLTF& file                  = *scene.get();
+
+	// a reload takes over the material sets and constants of the scene it
+	// replaces while the materials still line up one to one
+	const bool reuseMaterials =
+	previous != nullptr &&
+	previous->m_materialList.size() == imported.m_materials.size();
+
+	if (reuseMaterials)
+	{
+		file.m_descriptorPool     = std::exchange(previous->m_descriptorPool, {});
+		file.m_materialDataBuffer = std::exchange(previous->m_materialDataBuffer, {});
+	}
+	else
+	{
+		// we can stimate the descriptors we will need accurately
+		std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+
+		file.m_descriptorPool.init(
+		engine->m_device, imported.m_materials.size(), sizes);
+
+		// create buffer to hold the material data. It is written in place on
+		// hot reloads so it has to stay mapped, but it still ends up in
+		// device local memory where the host can see that (UMA, resizable BAR)
+		file.m_materialDataBuffer = engine->m_resourceManager.createBuffer(
+		sizeof(GltfPbrMaterial::MaterialConstants) * imported.m_materials.size(),
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+		VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	}
+
+	// Map glTF samplers to shared samplers
+	// Instead of creating new samplers, we map to our shared samplers
+	std::vector<VkSampler> samplerMapping;
+	for (const ImportedSampler& sampler : imported.m_samplers)
+	{
+		// Select appropriate shared sampler based on filter settings
+		VkSampler sharedSampler;
+		if (sampler.m_magFilter == VK_FILTER_LINEAR &&
+		    sampler.m_minFilter == VK_FILTER_LINEAR)
+		{
+			sharedSampler = (sampler.m_mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR)
+			                ? m_linearMipmapSampler
+			                : m_linearSampler;
+		}
+		else
+		{
+			sharedSampler = (sampler.m_mipmapMode == VK_SAMPLER_MIPMAP_MODE_LINEAR)
+			                ? m_nearestMipmapSampler
+			                : m_nearestSampler;
+		}
+
+		samplerMapping.push_back(sharedSampler);
+	}
+
+	// temporal arrays for all the objects to use while creating the GLTF
+	// data, from an arena released when the build returns
+	std::pmr::monotonic_buffer_resource scratch;
+
+	std::pmr::vector<std::shared_ptr<MeshAsset>>    meshes(&scratch);
+	std::pmr::vector<std::shared_ptr<Node>>         nodes(&scratch);
+	std::pmr::vector<AllocatedImage>                images(&scratch);
+	std::pmr::vector<std::shared_ptr<GLTFMaterial>> materials(&scratch);
+	meshes.reserve(imported.m_meshes.size());
+	nodes.reserve(imported.m_nodes.size());
+	images.reserve(imported.m_images.size());
+	materials.reserve(imported.m_materials.size());
+
+	// scene objects live in the file's arena
+	std::pmr::polymorphic_allocator<std::byte> fileAllocator(&file.m_arena);
+	file.meshes.reserve(imported.m_meshes.size());
+	file.nodes.reserve(imported.m_nodes.size());
+	file.m_images.reserve(imported.m_images.size());
+	file.materials.reserve(imported.m_materials.size());
+	file.m_acquiredMeshes.reserve(imported.m_meshes.size());
+	file.m_acquiredImages.reserve(imported.m_images.size());
+
+	// we have to load everything in order. MeshNodes depend on meshes, meshes
+	// depend on materials, and materials on textures.
+
+	// files reusing the same images or meshes share the GPU copies, found by
+	// the hash of their data
+	ResourceManager&          resources   = engine->m_resourceManager;
+	const SharedResourceStats sharedStart = resources.getSharedResourceStats();
+
+	std::pmr::vector<uint64_t> imageHashes(imported.m_images.size(), &scratch);
+	m_jobSystem.parallelFor(
+	imported.m_images.size(),
+	[&](size_t i)
+	{
+		if (imported.m_images[i].m_image.has_value())
+		{
+			imageHashes[i] = hashDecodedImage(*imported.m_images[i].m_image);
+		}
+	});
+
+	std::pmr::vector<uint64_t> meshHashes(imported.m_meshes.size(), &scratch);
+	m_jobSystem.parallelFor(
+	imported.m_meshes.size(),
+	[&](size_t i) { meshHashes[i] = hashImportedMesh(imported.m_meshes[i]); });
+
+	// queue the uploads of all textures on the upload queue
+	auto uploadStart = std::chrono::system_clock::now();
+
+	for (size_t i = 0; i < imported.m_images.size(); i++)
+	{
+		ImportedImage& image = imported.m_images[i];
+		if (image.m_image.has_value())
+		{
+			size_t imageSize = 0;
+			for (const ImageMipLevel& level : image.m_image->m_levels)
+			{
+				imageSize += level.m_texels.size();
+			}
+
+			AllocatedImage img =
+			resources.acquireImage(imageHashes[i],
+			                       imageSize,
+			                       [&]() { return uploadImage(*image.m_image, true); });
+			images.push_back(img);
+			file.m_acquiredImages.push_back(img);
+			file.m_images[std::pmr::string(image.m_name, &file.m_arena)] =
+			img; // Always store in map with a valid key
+
+			// release the texels as soon as they are on the GPU
+			image.m_image.reset();
+		}
+		else
+		{
+			// we failed to load, so lets give the slot a default white texture
+			// to not completely break loading
+			images.push_back(m_errorCheckerboardTexture.image);
+		}
+	}
+
+	auto uploadEnd = std::chrono::system_clock::now();
+
+	auto uploadTime = std::chrono::duration_cast<std::chrono::microseconds>(
+	uploadEnd - uploadStart);
+	fmt::print("Images: {} uploaded in {:.2f} ms\n",
+	           imported.m_images.size(),
+	           uploadTime.count() / 1000.f);
+
+	int                                 dataIndex = 0;
+	GltfPbrMaterial::MaterialConstants* sceneMaterialConstants =
+	(GltfPbrMaterial::MaterialConstants*)
+	file.m_materialDataBuffer.m_info.pMappedData;
+
+	// point a material texture slot at an imported image, keeping the
+	// default if the material doesn't reference one
+	auto resolveTexture = [&](const ImportedTexture& texture, Texture& target)
+	{
+		if (texture.m_imageIndex == ImportedTexture::MISSING_IMAGE)
+		{
+			target.image = m_errorCheckerboardTexture.image;
+		}
+		else if (texture.m_imageIndex < 0)
+		{
+			return;
+		}
+		else
+		{
+			target.image = images[texture.m_imageIndex];
+		}
+		// glTF says a texture without a sampler uses repeat + auto filtering
+		target.sampler = texture.m_samplerIndex >= 0
+		                 ? samplerMapping[texture.m_samplerIndex]
+		                 : m_linearMipmapSampler;
+	};
+
+	size_t rewrittenMaterials = 0;
+	for (const ImportedMaterial& mat : imported.m_materials)
+	{
+		GltfPbrMaterial::MaterialResources materialResources;
+		// default the material textures
+		materialResources.m_colorTexture      = m_whiteTexture;
+		materialResources.m_metalRoughTexture = m_whiteTexture;
+		materialResources.m_normalTexture     = m_whiteTexture;
+		materialResources.m_aoTexture         = m_whiteTexture;
+
+		// set the uniform buffer for the material data
+		materialResources.m_dataBuffer = file.m_materialDataBuffer.m_buffer;
+		materialResources.m_dataBufferOffset =
+		dataIndex * sizeof(GltfPbrMaterial::MaterialConstants);
+
+		resolveTexture(mat.m_colorTexture, materialResources.m_colorTexture);
+		resolveTexture(mat.m_metalRoughTexture,
+		               materialResources.m_metalRoughTexture);
+		resolveTexture(mat.m_normalTexture, materialResources.m_normalTexture);
+		resolveTexture(mat.m_occlusionTexture, materialResources.m_aoTexture);
+
+		const uint64_t materialHash = hashMaterial(mat, materialResources);
+
+		std::shared_ptr<GLTFMaterial> newMat;
+		if (reuseMaterials)
+		{
+			// unchanged images resolve to the same shared views, so the hash
+			// only differs if the set or the constants have to change
+			newMat = previous->m_materialList[dataIndex];
+			if (previous->m_materialHashes[dataIndex] != materialHash)
+			{
+				sceneMaterialConstants[dataIndex] = mat.m_constants;
+				m_metalRoughMaterial.updateMaterial(engine->m_device,
+				                                    newMat->m_data,
+				                                    mat.m_passType,
+				                                    materialResources);
+				rewrittenMaterials++;
+			}
+		}
+		else
+		{
+			newMat = std::make_shared<GLTFMaterial>();
+
+			// write material parameters to buffer
+			sceneMaterialConstants[dataIndex] = mat.m_constants;
+
+			// build material
+			newMat->m_data = m_metalRoughMaterial.writeMaterial(
+			engine->m_device, mat.m_passType, materialResources, file.m_descriptorPool);
+			rewrittenMaterials++;
+		}
+
+		materials.push_back(newMat);
+		file.materials[std::pmr::string(mat.m_name, &file.m_arena)] = newMat;
+		file.m_materialList.push_back(newMat);
+		file.m_materialHashes.push_back(materialHash);
+
+		dataIndex++;
+	}
+
+	if (previous != nullptr)
+	{
+		fmt::print("Materials: {} of {} rewritten\n",
+		           rewrittenMaterials,
+		           imported.m_materials.size());
+	}
+
+	// geometry read from a cache is copied on the GPU straight out of the
+	// mapped file where the device can import it
+	std::optional<HostMemoryImport> cacheImport =
+	resources.importMappedFile(imported.m_cacheFile);
+	HostMemoryImport* cacheSource = cacheImport ? &*cacheImport : nullptr;
+
+	for (const ImportedMesh& mesh : imported.m_meshes)
+	{
+		std::shared_ptr<MeshAsset> newmesh =
+		std::allocate_shared<MeshAsset>(fileAllocator);
+		meshes.push_back(newmesh);
+		file.meshes[std::pmr::string(mesh.m_name, &file.m_arena)] = newmesh;
+		newmesh->m_name = mesh.m_name;
+		newmesh->m_surfaces.reserve(mesh.m_surfaces.size());
+
+		for (const ImportedSurface& surface : mesh.m_surfaces)
+		{
+			GeoSurface newSurface;
+			newSurface.m_startIndex   = surface.m_startIndex;
+			newSurface.m_count        = surface.m_count;
+			newSurface.m_bounds       = surface.m_bounds;
+			newSurface.m_material     = materials[surface.m_materialIndex];
+			newSurface.m_firstMeshlet = surface.m_firstMeshlet;
+			newSurface.m_meshletCount = surface.m_meshletCount;
+			newSurface.m_lodCount     = surface.m_lodCount;
+			std::copy(std::begin(surface.m_lods),
+			          std::end(surface.m_lods),
+			          newSurface.m_lods.begin());
+
+			// sources come first, so their buffers are already uploaded
+			if (surface.m_sourceMesh >= 0 &&
+			    surface.m_sourceMesh != (int32_t) meshes.size() - 1)
+			{
+				newSurface.m_sourceMesh = meshes[surface.m_sourceMesh];
+			}
+
+			newmesh->m_surfaces.push_back(newSurface);
+		}
+
+		// every surface of the mesh may be shared from other meshes
+		if (mesh.m_indices.empty())
+		{
+			continue;
+		}
+
+		const size_t meshSize =
+		mesh.m_indices.size_bytes() + mesh.m_vertices.size_bytes() +
+		mesh.m_packedVertices.size_bytes() + mesh.m_colors.size_bytes() +
+		mesh.m_meshlets.size_bytes();
+
+		newmesh->m_meshBuffers = resources.acquireMesh(
+		meshHashes[meshes.size() - 1],
+		meshSize,
+		[&]()
+		{
+			if (mesh.m_vertexFormat == VertexFormat::Packed)
+			{
+				return resources.uploadMesh(mesh.m_indices,
+				                            mesh.m_packedVertices,
+				                            mesh.m_colors,
+				                            mesh.m_positionScale,
+				                            mesh.m_positionOffset,
+				                            mesh.m_meshlets,
+				                            cacheSource);
+			}
+			return resources.uploadMesh(
+			mesh.m_indices, mesh.m_vertices, mesh.m_meshlets, cacheSource);
+		});
+		file.m_acquiredMeshes.push_back(newmesh->m_meshBuffers);
+	}
+
+	if (cacheImport)
+	{
+		fmt::print("Copied {:.2f} MB of geometry from the mapped cache\n",
+		           cacheImport->m_copiedBytes / (1024.f * 1024.f));
+		resources.releaseMappedFile(std::move(*cacheImport));
+	}
+
+	const SharedResourceStats sharedEnd = resources.getSharedResourceStats();
+	fmt::print("Shared: {} of {} images and {} of {} meshes already on the "
+	           "GPU, {:.2f} MB saved\n",
+	           sharedEnd.m_imageHits - sharedStart.m_imageHits,
+	           sharedEnd.m_imageRequests - sharedStart.m_imageRequests,
+	           sharedEnd.m_meshHits - sharedStart.m_meshHits,
+	           sharedEnd.m_meshRequests - sharedStart.m_meshRequests,
+	           (sharedEnd.m_bytesSaved - sharedStart.m_bytesSaved) /
+	           (1024.f * 1024.f));
+
+	// create all nodes and hook up their meshes
+	for (const ImportedNode& node : imported.m_nodes)
+	{
+		std::shared_ptr<Node> newNode;
+
+		// find if the node has a mesh, and if it does hook it to the mesh
+		// pointer and allocate it with the meshnode class
+		if (node.m_meshIndex >= 0)
+		{
+			newNode = std::allocate_shared<MeshNode>(fileAllocator);
+			static_cast<MeshNode*>(newNode.get())->getMesh() =
+			meshes[node.m_meshIndex];
+		}
+		else
+		{
+			newNode = std::allocate_shared<Node>(fileAllocator);
+		}
+
+		nodes.push_back(newNode);
+		file.nodes[std::pmr::string(node.m_name, &file.m_arena)] = newNode;
+
+		newNode->getLocalTransform() = node.m_localTransform;
+
+		// instanced nodes get their transforms in a buffer of their own
+		if (!node.m_instances.empty())
+		{
+			MeshNode* meshNode = static_cast<MeshNode*>(newNode.get());
+
+			AllocatedBuffer& instanceBuffer =
+			file.m_instanceBuffers.emplace_back(resources.createBuffer(
+			std::as_bytes(std::span(node.m_instances)),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+
+			meshNode->getInstances() = node.m_instances;
+			meshNode->getInstanceBufferAddress() =
+			resources.getBufferAddress(instanceBuffer);
+		}
 	}
 
 	// run loop again to setup transform hierarchy
-	for (int i = 0; i < gltf.nodes.size(); i++)
+	for (int i = 0; i < imported.m_nodes.size(); i++)
 	{
-		fastgltf::Node&        node      = gltf.nodes[i];
+		const ImportedNode&    node      = imported.m_nodes[i];
 		std::shared_ptr<Node>& sceneNode = nodes[i];
 
-		for (auto& c : node.children)
+		sceneNode->getChildren().reserve(node.m_children.size());
+		for (uint32_t c : node.m_children)
 		{
 			sceneNode->getChildren().push_back(nodes[c]);
 			nodes[c]->getParent() = sceneNode;
@@ -924,6 +2267,9 @@ AssetLoader::loadGltf(AgniEngine* engine, std::filesystem::path filePath)
 			node->refreshTransform(glm::mat4 {1.f});
 		}
 	}
+
+	// start the uploads now rather than with the next frame
+	file.m_uploadToken = engine->m_resourceManager.getUploadQueue().flush();
 	return scene;
 }
 
@@ -940,26 +2286,38 @@ void LoadedGLTF::clearAll()
 {
 	VkDevice dv = m_creator->m_device;
 
+	// the copies into our buffers and images may still be running
+	m_creator->m_resourceManager.getUploadQueue().wait(m_uploadToken);
+
 	m_descriptorPool.destroyPools(dv);
 	m_creator->m_resourceManager.destroyBuffer(m_materialDataBuffer);
-
-	for (auto& [k, v] : meshes)
+	for (const AllocatedBuffer& buffer : m_instanceBuffers)
 	{
-
-		m_creator->m_resourceManager.destroyBuffer(v->m_meshBuffers.m_indexBuffer);
-		m_creator->m_resourceManager.destroyBuffer(v->m_meshBuffers.m_vertexBuffer);
+		m_creator->m_resourceManager.destroyBuffer(buffer);
 	}
 
-	for (auto& [k, v] : m_images)
+	// images and meshes may be shared with other files, drop our references.
+	// The default images standing in for failed ones were never acquired.
+	for (const GPUMeshBuffers& mesh : m_acquiredMeshes)
 	{
+		m_creator->m_resourceManager.releaseMesh(mesh);
+	}
+	m_acquiredMeshes.clear();
 
-		if (v.m_image == m_creator->m_assetLoader.getErrorTexture().image.m_image)
-		{
-			// dont destroy the default images
-			continue;
-		}
-		m_creator->m_resourceManager.destroyImage(v);
+	for (const AllocatedImage& image : m_acquiredImages)
+	{
+		m_creator->m_resourceManager.releaseImage(image);
 	}
+	m_acquiredImages.clear();
 
 	// Note: Samplers are now shared and managed by AssetLoader, not per-file
+
+	// destroy everything living in the arena before freeing it
+	m_topNodes.clear();
+	m_materialList.clear();
+	nodes.clear();
+	meshes.clear();
+	materials.clear();
+	m_images.clear();
+	m_arena.release();
 }
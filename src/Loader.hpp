@@ -1,11 +1,19 @@
 ﻿#pragma once
 #include <Components.hpp>
 #include <Descriptors.hpp>
+#include <GltfBuffers.hpp>
+#include <ImportedScene.hpp>
+#include <JobSystem.hpp>
 #include <Material.hpp>
 #include <Scene.hpp>
 #include <Types.hpp>
+#include <UploadQueue.hpp>
+#include <VertexWelder.hpp>
 
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <memory_resource>
 #include <unordered_map>
 
 #include <fastgltf/core.hpp>
@@ -17,12 +25,25 @@ struct GLTFMaterial
 	MaterialInstance m_data;
 };
 
+struct MeshAsset;
+
 struct GeoSurface
 {
 	uint32_t                      m_startIndex;
 	uint32_t                      m_count;
 	Bounds                        m_bounds;
 	std::shared_ptr<GLTFMaterial> m_material;
+
+	// mesh whose buffers hold this surface's geometry, null for its own
+	std::shared_ptr<MeshAsset> m_sourceMesh;
+
+	// meshlets of this surface in the mesh's meshlet buffer
+	uint32_t m_firstMeshlet {0};
+	uint32_t m_meshletCount {0};
+
+	// simplified versions, coarsest last
+	uint32_t                                m_lodCount {0};
+	std::array<SurfaceLod, MAX_SURFACE_LODS> m_lods {};
 };
 
 struct MeshAsset
@@ -38,12 +59,19 @@ class AgniEngine;
 
 struct LoadedGLTF : public IRenderable
 {
+	// the nodes and meshes of the file and the maps below are allocated
+	// from here, and all released at once by clearAll. Materials stay on the
+	// heap since a reload hands them over to the next LoadedGLTF.
+	std::pmr::monotonic_buffer_resource m_arena;
 
 	// storage for all the data on a given glTF file
-	std::unordered_map<std::string, std::shared_ptr<MeshAsset>>    meshes;
-	std::unordered_map<std::string, std::shared_ptr<Node>>         nodes;
-	std::unordered_map<std::string, AllocatedImage>                m_images;
-	std::unordered_map<std::string, std::shared_ptr<GLTFMaterial>> materials;
+	template <typename T>
+	using NameMap = std::pmr::unordered_map<std::pmr::string, T>;
+
+	NameMap<std::shared_ptr<MeshAsset>>    meshes {&m_arena};
+	NameMap<std::shared_ptr<Node>>         nodes {&m_arena};
+	NameMap<AllocatedImage>                m_images {&m_arena};
+	NameMap<std::shared_ptr<GLTFMaterial>> materials {&m_arena};
 
 	// nodes that dont have a parent, for iterating through the file in tree
 	// order
@@ -53,8 +81,31 @@ struct LoadedGLTF : public IRenderable
 
 	AllocatedBuffer m_materialDataBuffer;
 
+	// instance transforms of the instanced mesh nodes
+	std::vector<AllocatedBuffer> m_instanceBuffers;
+
+	// every reference taken on a shared mesh or image, in glTF order. The
+	// name maps above may hold fewer entries, as names can be empty or
+	// repeat, so these are what clearAll releases
+	std::vector<GPUMeshBuffers> m_acquiredMeshes;
+	std::vector<AllocatedImage> m_acquiredImages;
+
+	// completes once the buffers and images of the file are on the GPU
+	UploadToken m_uploadToken;
+
+	// the file this was loaded from, watched for hot reloads
+	std::filesystem::path           m_sourcePath;
+	std::filesystem::file_time_type m_sourceWriteTime;
+
+	// materials in glTF order with the hash of what their descriptor set
+	// and constants hold, so a reload only rewrites the ones that changed
+	std::vector<std::shared_ptr<GLTFMaterial>> m_materialList;
+	std::vector<uint64_t>                      m_materialHashes;
+
 	AgniEngine* m_creator;
 
+	// Frees the buffers, images and arena ranges of the file immediately, so
+	// the last reference may only go once the device is idle
 	~LoadedGLTF()
 	{
 		clearAll();
@@ -110,21 +161,143 @@ public:
 	}
 
 	// Image loading
-	std::optional<AllocatedImage> loadImage(fastgltf::Asset& asset,
-	                                        fastgltf::Image& image,
-	                                        bool             mipmapped = false);
+	std::optional<AllocatedImage> loadImage(fastgltf::Asset&   asset,
+	                                        fastgltf::Image&   image,
+	                                        const GltfBuffers& buffers,
+	                                        bool               mipmapped = false);
+
+	// Decode an image to RGBA8 on the CPU. Touches no Vulkan state, so it is
+	// safe to call from worker threads.
+	std::optional<DecodedImage> decodeImage(const fastgltf::Asset& asset,
+	                                        const fastgltf::Image& image,
+	                                        const GltfBuffers&     buffers);
 
-	// glTF loading
+	// Upload decoded texels into a new sampled image. If the image already
+	// carries its mip chain all levels are copied, otherwise the GPU
+	// generates them when mipmapped is set.
+	AllocatedImage uploadImage(const DecodedImage& decoded,
+	                           bool                mipmapped = false);
+
+	// glTF loading. Binary glTF files are baked into a scene cache next to
+	// the source on first load and read back from it afterwards.
 	std::optional<std::shared_ptr<LoadedGLTF>>
 	loadGltf(AgniEngine* engine, std::filesystem::path filePath);
 
+	// Load a scene's file again and replace it with the result. Meshes and
+	// images with unchanged contents keep their GPU copies, unchanged
+	// materials keep their descriptor sets and changed ones are rewritten in
+	// place. Waits for the device to go idle. Returns false and keeps the
+	// old scene if the file can't be loaded.
+	bool reloadGltf(AgniEngine* engine, std::shared_ptr<LoadedGLTF>& scene);
+
+	// Reload the scenes whose file changed on disk since they were loaded.
+	// Cheap to call every frame, the files are only checked a few times a
+	// second.
+	void reloadChangedScenes(
+	AgniEngine*                                                   engine,
+	std::unordered_map<std::string, std::shared_ptr<LoadedGLTF>>& scenes);
+
+	void setHotReloadEnabled(bool enabled)
+	{
+		m_hotReloadEnabled = enabled;
+	}
+
+	void setSceneCacheEnabled(bool enabled)
+	{
+		m_sceneCacheEnabled = enabled;
+	}
+
+	// Vertex layout used for imported meshes. Packed is only used for meshes
+	// it can represent, the others fall back to full vertices.
+	void setPreferredVertexFormat(VertexFormat format)
+	{
+		m_preferredVertexFormat = format;
+	}
+
+	// Reorder imported triangles and vertices for the vertex cache, overdraw
+	// and vertex fetch. Costs some import time, cached scenes skip it.
+	void setIndexOptimizationEnabled(bool enabled)
+	{
+		m_indexOptimizationEnabled = enabled;
+	}
+
+	// Build simplified versions of every imported surface, picked at draw
+	// time by their size on screen
+	void setLodGenerationEnabled(bool enabled)
+	{
+		m_lodGenerationEnabled = enabled;
+	}
+
+	// Memory map glTF files and their external buffers instead of reading
+	// them into heap buffers, so imports read vertex data and embedded
+	// images straight from the page cache
+	void setMappedInputEnabled(bool enabled)
+	{
+		m_mappedInputEnabled = enabled;
+	}
+
+	// Build the mip chains of imported textures on the import workers, with
+	// gamma correct filtering and alpha coverage kept for alpha tested
+	// materials, instead of blitting them on the GPU after upload
+	void setCpuMipGenerationEnabled(bool enabled)
+	{
+		m_cpuMipGenerationEnabled = enabled;
+	}
+
+	// Encode imported textures to BC formats picked by how the materials
+	// use them. Costs import time, cached scenes store the blocks. Has no
+	// effect on devices without textureCompressionBC.
+	void setTextureCompressionEnabled(bool enabled)
+	{
+		m_textureCompressionEnabled = enabled;
+	}
+
+	// How close vertex attributes have to be for imported vertices to be
+	// merged
+	void setWeldTolerances(const vertexweld::Tolerances& tolerances)
+	{
+		m_weldTolerances = tolerances;
+	}
+
 	// PBR Material system (used by all glTF materials)
 	GltfPbrMaterial& getMaterialSystem()
 	{
 		return m_metalRoughMaterial;
 	}
 
+	// Worker pool used for CPU side import work
+	JobSystem& getJobSystem()
+	{
+		return m_jobSystem;
+	}
+
 private:
+	// Parse a glTF file into CPU side scene data: vertices with tangents,
+	// decoded images (with their mip chain when buildMips or CPU mip
+	// generation is set), materials and the node hierarchy
+	bool importGltf(const std::filesystem::path& filePath,
+	                bool                         buildMips,
+	                ImportedScene&               scene);
+
+	// Texture compression is asked for and the device samples BC formats
+	bool compressesTextures() const
+	{
+		return m_textureCompressionEnabled &&
+		       m_resourceManager->supportsBlockCompression();
+	}
+
+	// Read a glTF file from the scene cache, or import it and bake the cache
+	bool loadImportedScene(const std::filesystem::path& filePath,
+	                       ImportedScene&               scene,
+	                       bool&                        cacheHit);
+
+	// Create the GPU resources and scene graph for imported data. When
+	// reloading, previous hands over its material descriptor sets and
+	// constants buffer if the material count still matches.
+	std::shared_ptr<LoadedGLTF> buildScene(AgniEngine*    engine,
+	                                       ImportedScene& imported,
+	                                       LoadedGLTF*    previous = nullptr);
+
 	// Default textures
 	Texture m_whiteTexture;
 	Texture m_blackTexture;
@@ -140,6 +313,22 @@ private:
 	// PBR Material system (shared pipeline for all glTF materials)
 	GltfPbrMaterial m_metalRoughMaterial;
 
+	// Worker threads for decoding and other CPU side import work
+	JobSystem m_jobSystem;
+
+	bool         m_sceneCacheEnabled         = true;
+	VertexFormat m_preferredVertexFormat     = VertexFormat::Packed;
+	bool         m_indexOptimizationEnabled  = true;
+	bool         m_lodGenerationEnabled      = true;
+	bool         m_cpuMipGenerationEnabled   = true;
+	bool         m_mappedInputEnabled        = true;
+	bool         m_textureCompressionEnabled = true;
+	bool         m_hotReloadEnabled          = true;
+
+	vertexweld::Tolerances m_weldTolerances;
+
+	std::chrono::steady_clock::time_point m_lastReloadCheck;
+
 	ResourceManager* m_resourceManager = nullptr;
 	VkDevice         m_device          = VK_NULL_HANDLE;
 };
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+// Read-only memory mapping of a whole file. The OS pages the contents in on
+// demand, so large assets can be hashed, parsed and copied into staging
+// buffers without first reading them into a heap allocation.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile& other)            = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// Map the file at path. Returns false if it doesn't exist, is empty or
+	// can't be mapped.
+	bool open(const std::filesystem::path& path);
+	void close();
+
+	bool isOpen() const
+	{
+		return m_data != nullptr;
+	}
+
+	const uint8_t* data() const
+	{
+		return m_data;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	std::span<const uint8_t> bytes() const
+	{
+		return {m_data, m_size};
+	}
+
+private:
+	const uint8_t* m_data {nullptr};
+	size_t         m_size {0};
+
+#ifdef _WIN32
+	void* m_fileHandle {nullptr};
+	void* m_mappingHandle {nullptr};
+#else
+	int m_fileDescriptor {-1};
+#endif
+};
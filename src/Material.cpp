@@ -118,20 +118,28 @@ GltfPbrMaterial::writeMaterial(VkDevice                     device,
                                DescriptorAllocatorGrowable& descriptorAllocator)
 {
 	MaterialInstance matData;
-	matData.m_passType = pass;
+	matData.m_materialSet =
+	descriptorAllocator.allocate(device, m_materialLayout);
+
+	updateMaterial(device, matData, pass, resources);
+	return matData;
+}
+
+void GltfPbrMaterial::updateMaterial(VkDevice                 device,
+                                     MaterialInstance&        material,
+                                     MaterialPass             pass,
+                                     const MaterialResources& resources)
+{
+	material.m_passType = pass;
 	if (pass == MaterialPass::Transparent)
 	{
-		matData.m_pipeline = &m_transparentPipeline;
+		material.m_pipeline = &m_transparentPipeline;
 	}
 	else
 	{
-		matData.m_pipeline = &m_opaquePipeline;
+		material.m_pipeline = &m_opaquePipeline;
 	}
 
-	matData.m_materialSet =
-	descriptorAllocator.allocate(device, m_materialLayout);
-
-
 	m_writer.clear();
 	m_writer.writeBuffer(/*binding*/ 0,
 	                     resources.m_dataBuffer,
@@ -160,7 +168,5 @@ GltfPbrMaterial::writeMaterial(VkDevice                     device,
 	                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
 	// use the materialSet and update it here.
-	m_writer.updateSet(device, matData.m_materialSet);
-
-	return matData;
+	m_writer.updateSet(device, material.m_materialSet);
 }
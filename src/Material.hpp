@@ -64,4 +64,11 @@ struct GltfPbrMaterial
 	              MaterialPass                 pass,
 	              const MaterialResources&     resources,
 	              DescriptorAllocatorGrowable& descriptorAllocator);
+
+	// Point an existing material's descriptor set at new resources. The set
+	// must not be in use by the GPU.
+	void updateMaterial(VkDevice                 device,
+	                    MaterialInstance&        material,
+	                    MaterialPass             pass,
+	                    const MaterialResources& resources);
 };
@@ -0,0 +1,370 @@
+#include <MeshSimplifier.hpp>
+
+#include <Hash.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+	constexpr uint32_t INVALID_VERTEX = std::numeric_limits<uint32_t>::max();
+
+	// symmetric 4x4 matrix summing squared distances to a set of planes,
+	// weighted by triangle area (Garland and Heckbert 1997)
+	struct Quadric
+	{
+		double m_a00 = 0, m_a01 = 0, m_a02 = 0, m_a03 = 0;
+		double m_a11 = 0, m_a12 = 0, m_a13 = 0;
+		double m_a22 = 0, m_a23 = 0;
+		double m_a33    = 0;
+		double m_weight = 0;
+
+		void addPlane(const glm::vec3& normal, float distance, float weight)
+		{
+			const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+			m_a00 += weight * a * a;
+			m_a01 += weight * a * b;
+			m_a02 += weight * a * c;
+			m_a03 += weight * a * d;
+			m_a11 += weight * b * b;
+			m_a12 += weight * b * c;
+			m_a13 += weight * b * d;
+			m_a22 += weight * c * c;
+			m_a23 += weight * c * d;
+			m_a33 += weight * d * d;
+			m_weight += weight;
+		}
+
+		Quadric& operator+=(const Quadric& other)
+		{
+			m_a00 += other.m_a00;
+			m_a01 += other.m_a01;
+			m_a02 += other.m_a02;
+			m_a03 += other.m_a03;
+			m_a11 += other.m_a11;
+			m_a12 += other.m_a12;
+			m_a13 += other.m_a13;
+			m_a22 += other.m_a22;
+			m_a23 += other.m_a23;
+			m_a33 += other.m_a33;
+			m_weight += other.m_weight;
+			return *this;
+		}
+
+		// weighted mean of the squared plane distances at p
+		double evaluate(const glm::vec3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			double       error = m_a00 * x * x + m_a11 * y * y + m_a22 * z * z +
+			               2 * (m_a01 * x * y + m_a02 * x * z + m_a12 * y * z) +
+			               2 * (m_a03 * x + m_a13 * y + m_a23 * z) + m_a33;
+			return m_weight > 0 ? std::max(error, 0.0) / m_weight : 0.0;
+		}
+	};
+
+	struct PositionKey
+	{
+		std::array<uint32_t, 3> m_bits;
+
+		bool operator==(const PositionKey& other) const = default;
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return static_cast<size_t>(hashutil::xxhash64(
+			std::span<const uint32_t>(key.m_bits.data(), key.m_bits.size())));
+		}
+	};
+
+	struct Collapse
+	{
+		double   m_cost;
+		uint32_t m_from;
+		uint32_t m_to;
+	};
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	// true if moving from onto to turns any triangle around from over
+	bool flipsTriangle(uint32_t                      from,
+	                   uint32_t                      to,
+	                   const std::vector<uint32_t>&  triangles,
+	                   const std::vector<uint32_t>&  adjacencyOffsets,
+	                   const std::vector<uint32_t>&  adjacency,
+	                   const std::vector<glm::vec3>& positions)
+	{
+		for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++)
+		{
+			const uint32_t* corners = &triangles[adjacency[a] * 3];
+			if (corners[0] == to || corners[1] == to || corners[2] == to)
+			{
+				// collapses away
+				continue;
+			}
+
+			glm::vec3 p[3];
+			glm::vec3 moved[3];
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				p[c]     = positions[corners[c]];
+				moved[c] = corners[c] == from ? positions[to] : p[c];
+			}
+
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after  = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) <= 0.f)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+} // namespace
+
+std::vector<uint32_t> meshsimplify::simplify(std::span<const uint32_t> indices,
+                                             std::span<const Vertex>   vertices,
+                                             size_t targetIndexCount,
+                                             float& error)
+{
+	error = 0.f;
+
+	// work on a compact copy of the referenced vertices
+	std::vector<uint32_t> localIndex(vertices.size(), INVALID_VERTEX);
+	std::vector<uint32_t> globalIndex;
+	std::vector<uint32_t> triangles(indices.size() - indices.size() % 3);
+	for (size_t i = 0; i < triangles.size(); i++)
+	{
+		uint32_t& local = localIndex[indices[i]];
+		if (local == INVALID_VERTEX)
+		{
+			local = static_cast<uint32_t>(globalIndex.size());
+			globalIndex.push_back(indices[i]);
+		}
+		triangles[i] = local;
+	}
+
+	const uint32_t         vertexCount = static_cast<uint32_t>(globalIndex.size());
+	std::vector<glm::vec3> positions(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		positions[v] = vertices[globalIndex[v]].m_position;
+	}
+
+	// vertices split by normals or uvs share a position, topology and
+	// quadrics follow positions so those splits don't look like borders
+	std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positionIds;
+	positionIds.reserve(vertexCount);
+	std::vector<uint32_t> positionId(vertexCount);
+	std::vector<uint32_t> wedgeCount;
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		PositionKey key{{std::bit_cast<uint32_t>(positions[v].x),
+		                 std::bit_cast<uint32_t>(positions[v].y),
+		                 std::bit_cast<uint32_t>(positions[v].z)}};
+		auto [it, inserted] =
+		positionIds.try_emplace(key, static_cast<uint32_t>(wedgeCount.size()));
+		if (inserted)
+		{
+			wedgeCount.push_back(0);
+		}
+		positionId[v] = it->second;
+		wedgeCount[it->second]++;
+	}
+
+	// open and non-manifold edges pin their vertices
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(triangles.size());
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t a = positionId[triangles[t + c]];
+			uint32_t b = positionId[triangles[t + (c + 1) % 3]];
+			edgeUses[edgeKey(a, b)]++;
+		}
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		locked[v] = wedgeCount[positionId[v]] > 1;
+	}
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t a = triangles[t + c];
+			uint32_t b = triangles[t + (c + 1) % 3];
+			if (edgeUses[edgeKey(positionId[a], positionId[b])] != 2)
+			{
+				locked[a] = true;
+				locked[b] = true;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(wedgeCount.size());
+	for (size_t t = 0; t < triangles.size(); t += 3)
+	{
+		const glm::vec3& p0 = positions[triangles[t + 0]];
+		const glm::vec3& p1 = positions[triangles[t + 1]];
+		const glm::vec3& p2 = positions[triangles[t + 2]];
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float     area   = glm::length(normal);
+		if (area <= 0.f)
+		{
+			continue;
+		}
+		normal /= area;
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			quadrics[positionId[triangles[t + c]]].addPlane(
+			normal, -glm::dot(normal, p0), area);
+		}
+	}
+
+	double                maxCost = 0.0;
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint32_t> fillCursor;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool>     touched(vertexCount);
+
+	// collapse in passes, each vertex takes part in at most one collapse per
+	// pass so the flip checks stay valid
+	while (triangles.size() > targetIndexCount)
+	{
+		std::fill(liveTriangles.begin(), liveTriangles.end(), 0);
+		for (uint32_t v : triangles)
+		{
+			liveTriangles[v]++;
+		}
+		adjacencyOffsets[0] = 0;
+		std::partial_sum(liveTriangles.begin(),
+		                 liveTriangles.end(),
+		                 adjacencyOffsets.begin() + 1);
+		adjacency.resize(triangles.size());
+		fillCursor.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangles.size(); i++)
+		{
+			adjacency[fillCursor[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t t = 0; t < triangles.size(); t += 3)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint32_t a = triangles[t + c];
+				uint32_t b = triangles[t + (c + 1) % 3];
+				for (auto [from, to] : {std::pair{a, b}, std::pair{b, a}})
+				{
+					if (locked[from] || positionId[from] == positionId[to])
+					{
+						continue;
+					}
+					Quadric merged = quadrics[positionId[from]];
+					merged += quadrics[positionId[to]];
+					collapses.push_back({merged.evaluate(positions[to]), from, to});
+				}
+			}
+		}
+
+		std::sort(collapses.begin(),
+		          collapses.end(),
+		          [](const Collapse& a, const Collapse& b)
+		          {
+			          if (a.m_cost != b.m_cost)
+			          {
+				          return a.m_cost < b.m_cost;
+			          }
+			          return a.m_from != b.m_from ? a.m_from < b.m_from
+			                                      : a.m_to < b.m_to;
+		          });
+
+		// an interior collapse removes two triangles
+		const size_t wanted =
+		(triangles.size() - targetIndexCount) / 6 + 1;
+
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(touched.begin(), touched.end(), false);
+		size_t applied = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (applied >= wanted)
+			{
+				break;
+			}
+			if (touched[collapse.m_from] || touched[collapse.m_to] ||
+			    flipsTriangle(collapse.m_from,
+			                  collapse.m_to,
+			                  triangles,
+			                  adjacencyOffsets,
+			                  adjacency,
+			                  positions))
+			{
+				continue;
+			}
+
+			remap[collapse.m_from] = collapse.m_to;
+			for (uint32_t a = adjacencyOffsets[collapse.m_from];
+			     a < adjacencyOffsets[collapse.m_from + 1];
+			     a++)
+			{
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					touched[triangles[adjacency[a] * 3 + c]] = true;
+				}
+			}
+
+			quadrics[positionId[collapse.m_to]] += quadrics[positionId[collapse.m_from]];
+			maxCost = std::max(maxCost, collapse.m_cost);
+			applied++;
+		}
+
+		if (applied == 0)
+		{
+			break;
+		}
+
+		// drop the triangles that collapsed
+		size_t kept = 0;
+		for (size_t t = 0; t < triangles.size(); t += 3)
+		{
+			uint32_t a = remap[triangles[t + 0]];
+			uint32_t b = remap[triangles[t + 1]];
+			uint32_t c = remap[triangles[t + 2]];
+			if (a != b && b != c && a != c)
+			{
+				triangles[kept++] = a;
+				triangles[kept++] = b;
+				triangles[kept++] = c;
+			}
+		}
+		triangles.resize(kept);
+	}
+
+	error = static_cast<float>(std::sqrt(maxCost));
+
+	for (uint32_t& index : triangles)
+	{
+		index = globalIndex[index];
+	}
+	return triangles;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Quadric error edge collapse simplification, used to build the LOD chain of
+// imported surfaces
+namespace meshsimplify
+{
+	// Simplify a triangle list towards targetIndexCount indices by collapsing
+	// the edges with the smallest quadric error first. Vertices only ever
+	// move onto other existing vertices, so the result indexes the same
+	// vertex array. Vertices on open borders or attribute seams are never
+	// moved, which keeps the result free of cracks against neighbouring
+	// surfaces and texture charts.
+	// error receives the largest deviation introduced, in mesh units.
+	std::vector<uint32_t> simplify(std::span<const uint32_t> indices,
+	                               std::span<const Vertex>   vertices,
+	                               size_t                    targetIndexCount,
+	                               float&                    error);
+} // namespace meshsimplify
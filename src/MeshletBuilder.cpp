@@ -0,0 +1,163 @@
+#include <MeshletBuilder.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+	// cone cutoff of meshlets whose triangles face too many directions to
+	// ever be entirely back facing
+	constexpr float NO_CONE_CULLING = 2.f;
+
+	// below this spread (cos of the widest triangle to the average) the cone
+	// is too wide to be worth testing
+	constexpr float MIN_CONE_SPREAD = 0.1f;
+
+	// Triangles collected for the meshlet currently being built
+	struct MeshletScratch
+	{
+		std::array<uint32_t, meshletgen::MAX_VERTICES> m_vertices;
+		uint32_t                                       m_vertexCount   = 0;
+		uint32_t                                       m_triangleCount = 0;
+		uint32_t                                       m_firstIndex    = 0;
+
+		bool contains(uint32_t vertex) const
+		{
+			return std::find(m_vertices.begin(),
+			                 m_vertices.begin() + m_vertexCount,
+			                 vertex) != m_vertices.begin() + m_vertexCount;
+		}
+	};
+
+	GPUMeshlet computeBounds(const MeshletScratch&     scratch,
+	                         std::span<const uint32_t> indices,
+	                         std::span<const Vertex>   vertices)
+	{
+		GPUMeshlet meshlet {};
+		meshlet.m_firstIndex = scratch.m_firstIndex;
+		meshlet.m_indexCount = scratch.m_triangleCount * 3;
+
+		// bounding sphere around the box of the used vertices
+		glm::vec3 minpos = vertices[scratch.m_vertices[0]].m_position;
+		glm::vec3 maxpos = minpos;
+		for (uint32_t i = 1; i < scratch.m_vertexCount; i++)
+		{
+			minpos = glm::min(minpos, vertices[scratch.m_vertices[i]].m_position);
+			maxpos = glm::max(maxpos, vertices[scratch.m_vertices[i]].m_position);
+		}
+		meshlet.m_center = (minpos + maxpos) / 2.f;
+		for (uint32_t i = 0; i < scratch.m_vertexCount; i++)
+		{
+			meshlet.m_radius = std::max(
+			meshlet.m_radius,
+			glm::length(vertices[scratch.m_vertices[i]].m_position -
+			            meshlet.m_center));
+		}
+
+		// normal cone, triangles are counter clockwise like in glTF
+		std::array<glm::vec3, meshletgen::MAX_TRIANGLES> normals;
+		uint32_t                                         normalCount = 0;
+		glm::vec3                                        normalSum {0.f};
+		for (uint32_t t = 0; t < scratch.m_triangleCount; t++)
+		{
+			uint32_t  base = scratch.m_firstIndex + t * 3;
+			glm::vec3 p0   = vertices[indices[base + 0]].m_position;
+			glm::vec3 p1   = vertices[indices[base + 1]].m_position;
+			glm::vec3 p2   = vertices[indices[base + 2]].m_position;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float     area   = glm::length(normal);
+			// degenerate triangles are never visible, they don't widen the cone
+			if (area == 0.f)
+			{
+				continue;
+			}
+			normals[normalCount] = normal / area;
+			normalSum += normals[normalCount];
+			normalCount++;
+		}
+
+		meshlet.m_coneAxis   = glm::vec3(0.f, 0.f, 1.f);
+		meshlet.m_coneCutoff = NO_CONE_CULLING;
+
+		float sumLength = glm::length(normalSum);
+		if (normalCount == 0 || sumLength == 0.f)
+		{
+			return meshlet;
+		}
+
+		glm::vec3 axis   = normalSum / sumLength;
+		float     minDot = 1.f;
+		for (uint32_t i = 0; i < normalCount; i++)
+		{
+			minDot = std::min(minDot, glm::dot(normals[i], axis));
+		}
+
+		meshlet.m_coneAxis = axis;
+		if (minDot > MIN_CONE_SPREAD)
+		{
+			// widen the cone by 90 degrees on every side: the meshlet is back
+			// facing once the view direction is inside the result
+			meshlet.m_coneCutoff = std::sqrt(1.f - minDot * minDot);
+		}
+
+		return meshlet;
+	}
+} // namespace
+
+void meshletgen::buildMeshlets(std::span<const uint32_t> indices,
+                               uint32_t                  firstIndex,
+                               uint32_t                  indexCount,
+                               std::span<const Vertex>   vertices,
+                               std::vector<GPUMeshlet>&  meshlets)
+{
+	MeshletScratch scratch;
+	scratch.m_firstIndex = firstIndex;
+
+	const uint32_t triangleCount = indexCount / 3;
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		uint32_t base = firstIndex + t * 3;
+
+		uint32_t newVertices = 0;
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = indices[base + corner];
+			// a vertex repeated within the triangle only counts once
+			bool repeated = (corner > 0 && indices[base] == vertex) ||
+			                (corner > 1 && indices[base + 1] == vertex);
+			if (!repeated && !scratch.contains(vertex))
+			{
+				newVertices++;
+			}
+		}
+
+		// close the meshlet if this triangle doesn't fit anymore
+		if (scratch.m_vertexCount + newVertices > MAX_VERTICES ||
+		    scratch.m_triangleCount == MAX_TRIANGLES)
+		{
+			meshlets.push_back(computeBounds(scratch, indices, vertices));
+			scratch.m_vertexCount   = 0;
+			scratch.m_triangleCount = 0;
+			scratch.m_firstIndex    = base;
+		}
+
+		for (uint32_t corner = 0; corner < 3; corner++)
+		{
+			uint32_t vertex = indices[base + corner];
+			if (!scratch.contains(vertex))
+			{
+				scratch.m_vertices[scratch.m_vertexCount++] = vertex;
+			}
+		}
+		scratch.m_triangleCount++;
+	}
+
+	if (scratch.m_triangleCount > 0)
+	{
+		meshlets.push_back(computeBounds(scratch, indices, vertices));
+	}
+}
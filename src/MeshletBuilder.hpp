@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Splits surfaces into meshlets for GPU cluster culling. Triangles are taken
+// in index buffer order, so every meshlet is a contiguous index range that
+// the regular index buffer can draw without any remapping.
+namespace meshletgen
+{
+	// limits of a single meshlet, the usual mesh shader friendly sizes
+	constexpr uint32_t MAX_VERTICES  = 64;
+	constexpr uint32_t MAX_TRIANGLES = 124;
+
+	// Build the meshlets of the triangles in
+	// indices[firstIndex, firstIndex + indexCount) and append them to
+	// meshlets. Indices refer to vertices.
+	void buildMeshlets(std::span<const uint32_t> indices,
+	                   uint32_t                  firstIndex,
+	                   uint32_t                  indexCount,
+	                   std::span<const Vertex>   vertices,
+	                   std::vector<GPUMeshlet>&  meshlets);
+} // namespace meshletgen
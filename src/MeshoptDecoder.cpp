@@ -0,0 +1,516 @@
+#include <MeshoptDecoder.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// vertex codec, version 0
+	constexpr uint8_t VERTEX_HEADER          = 0xa0;
+	constexpr size_t  VERTEX_BLOCK_SIZE      = 8192;
+	constexpr size_t  VERTEX_BLOCK_MAX_COUNT = 256;
+	constexpr size_t  BYTE_GROUP_SIZE        = 16;
+	constexpr size_t  BYTE_GROUP_MAX_SIZE    = 24; // 4 bit codes + 16 escapes
+	constexpr size_t  VERTEX_TAIL_MIN_SIZE   = 32;
+
+	// index codecs
+	constexpr uint8_t INDEX_HEADER    = 0xe0;
+	constexpr uint8_t SEQUENCE_HEADER = 0xd0;
+
+	// vertices per block, a multiple of the byte group size
+	size_t getVertexBlockCount(size_t vertexSize)
+	{
+		size_t count = (VERTEX_BLOCK_SIZE / vertexSize) & ~(BYTE_GROUP_SIZE - 1);
+		return std::min(count, VERTEX_BLOCK_MAX_COUNT);
+	}
+
+	// 16 bytes stored as 0, 2 or 4 bit codes, where the largest code escapes
+	// to a full byte that follows the codes, or as raw bytes
+	const uint8_t* decodeBytesGroup(const uint8_t* data, uint8_t* dst, uint32_t bitsLog2)
+	{
+		if (bitsLog2 == 0)
+		{
+			memset(dst, 0, BYTE_GROUP_SIZE);
+			return data;
+		}
+		if (bitsLog2 == 3)
+		{
+			memcpy(dst, data, BYTE_GROUP_SIZE);
+			return data + BYTE_GROUP_SIZE;
+		}
+
+		const uint32_t bits       = bitsLog2 == 1 ? 2 : 4;
+		const uint32_t escape     = (1u << bits) - 1;
+		const size_t   codeBytes  = BYTE_GROUP_SIZE * bits / 8;
+		const uint8_t* escapeData = data + codeBytes;
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; i++)
+		{
+			// codes are packed from the high bits down
+			const uint32_t shift = 8 - bits - (i * bits) % 8;
+			const uint32_t code  = (data[i * bits / 8] >> shift) & escape;
+			if (code == escape)
+			{
+				dst[i] = *escapeData++;
+			}
+			else
+			{
+				dst[i] = static_cast<uint8_t>(code);
+			}
+		}
+		return escapeData;
+	}
+
+	// size bytes, a multiple of the group size, behind a 2 bit header per
+	// group
+	const uint8_t* decodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* dst, size_t size)
+	{
+		const uint8_t* header     = data;
+		const size_t   headerSize = (size / BYTE_GROUP_SIZE + 3) / 4;
+		if (size_t(end - data) < headerSize)
+		{
+			return nullptr;
+		}
+		data += headerSize;
+
+		for (size_t i = 0; i < size; i += BYTE_GROUP_SIZE)
+		{
+			if (size_t(end - data) < BYTE_GROUP_MAX_SIZE)
+			{
+				return nullptr;
+			}
+			const size_t   group    = i / BYTE_GROUP_SIZE;
+			const uint32_t bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+			data = decodeBytesGroup(data, dst + i, bitsLog2);
+		}
+		return data;
+	}
+
+	// Every byte of the vertex is stored on its own as zigzagged deltas from
+	// the same byte of the previous vertex
+	const uint8_t* decodeVertexBlock(const uint8_t* data,
+	                                 const uint8_t* end,
+	                                 uint8_t*       dst,
+	                                 size_t         vertexCount,
+	                                 size_t         vertexSize,
+	                                 uint8_t*       lastVertex)
+	{
+		uint8_t deltas[VERTEX_BLOCK_MAX_COUNT];
+
+		const size_t alignedCount =
+		(vertexCount + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+
+		for (size_t k = 0; k < vertexSize; k++)
+		{
+			data = decodeBytes(data, end, deltas, alignedCount);
+			if (!data)
+			{
+				return nullptr;
+			}
+
+			uint8_t previous = lastVertex[k];
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				const uint8_t delta = deltas[i];
+				previous += static_cast<uint8_t>((0 - (delta & 1)) ^ (delta >> 1));
+				dst[i * vertexSize + k] = previous;
+			}
+			lastVertex[k] = previous;
+		}
+		return data;
+	}
+
+	bool decodeVertexBuffer(std::span<const uint8_t> src,
+	                        uint8_t*                 dst,
+	                        size_t                   vertexCount,
+	                        size_t                   vertexSize)
+	{
+		if (vertexSize == 0 || vertexSize > 256 || vertexSize % 4 != 0 ||
+		    src.size() < 1 + vertexSize || src[0] != VERTEX_HEADER)
+		{
+			return false;
+		}
+
+		const uint8_t* data = src.data() + 1;
+		const uint8_t* end  = src.data() + src.size();
+
+		// the tail holds the first vertex, the base of the deltas
+		uint8_t lastVertex[256];
+		memcpy(lastVertex, end - vertexSize, vertexSize);
+
+		const size_t blockCount = getVertexBlockCount(vertexSize);
+		for (size_t first = 0; first < vertexCount; first += blockCount)
+		{
+			data = decodeVertexBlock(data,
+			                         end,
+			                         dst + first * vertexSize,
+			                         std::min(blockCount, vertexCount - first),
+			                         vertexSize,
+			                         lastVertex);
+			if (!data)
+			{
+				return false;
+			}
+		}
+
+		return size_t(end - data) == std::max(vertexSize, VERTEX_TAIL_MIN_SIZE);
+	}
+
+	uint32_t decodeVByte(const uint8_t*& data)
+	{
+		uint8_t lead = *data++;
+		if (lead < 128)
+		{
+			return lead;
+		}
+
+		uint32_t result = lead & 127;
+		uint32_t shift  = 7;
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			uint8_t group = *data++;
+			result |= uint32_t(group & 127) << shift;
+			shift += 7;
+			if (group < 128)
+			{
+				break;
+			}
+		}
+		return result;
+	}
+
+	// zigzagged delta from the last free index
+	uint32_t decodeIndex(const uint8_t*& data, uint32_t last)
+	{
+		uint32_t v = decodeVByte(data);
+		return last + ((v >> 1) ^ (0 - (v & 1)));
+	}
+
+	void writeIndex(uint8_t* dst, size_t i, size_t indexSize, uint32_t index)
+	{
+		if (indexSize == 2)
+		{
+			uint16_t value = static_cast<uint16_t>(index);
+			memcpy(dst + i * 2, &value, 2);
+		}
+		else
+		{
+			memcpy(dst + i * 4, &index, 4);
+		}
+	}
+
+	// Triangle list codec: triangles reuse edges and vertices of recent ones
+	// through small FIFOs, new vertices are mostly the next unused index
+	bool decodeIndexBuffer(std::span<const uint8_t> src,
+	                       uint8_t*                 dst,
+	                       size_t                   indexCount,
+	                       size_t                   indexSize)
+	{
+		if (indexCount % 3 != 0 || (indexSize != 2 && indexSize != 4) ||
+		    src.size() < 1 + indexCount / 3 + 16 ||
+		    (src[0] & 0xf0) != INDEX_HEADER || (src[0] & 0x0f) > 1)
+		{
+			return false;
+		}
+
+		const uint32_t version = src[0] & 0x0f;
+
+		uint32_t edgeFifo[16][2];
+		uint32_t vertexFifo[16];
+		memset(edgeFifo, -1, sizeof(edgeFifo));
+		memset(vertexFifo, -1, sizeof(vertexFifo));
+		size_t edgeOffset   = 0;
+		size_t vertexOffset = 0;
+
+		auto pushEdge = [&](uint32_t a, uint32_t b)
+		{
+			edgeFifo[edgeOffset][0] = a;
+			edgeFifo[edgeOffset][1] = b;
+			edgeOffset              = (edgeOffset + 1) & 15;
+		};
+		auto pushVertex = [&](uint32_t v, bool push = true)
+		{
+			vertexFifo[vertexOffset] = v;
+			vertexOffset             = (vertexOffset + (push ? 1 : 0)) & 15;
+		};
+
+		uint32_t next = 0;
+		uint32_t last = 0;
+
+		// version 1 codes 13 and 14 as the last free index -1 and +1
+		const uint32_t fecMax = version >= 1 ? 13 : 15;
+
+		// one code per triangle, then the extra data, then a 16 byte table
+		// for the common codes of triangles that start with a new vertex
+		const uint8_t* code         = src.data() + 1;
+		const uint8_t* data         = code + indexCount / 3;
+		const uint8_t* dataSafeEnd  = src.data() + src.size() - 16;
+		const uint8_t* codeAuxTable = dataSafeEnd;
+
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			// a triangle reads at most 16 bytes, which the table leaves room for
+			if (data > dataSafeEnd)
+			{
+				return false;
+			}
+
+			uint32_t a, b, c;
+
+			const uint8_t codeTri = *code++;
+			if (codeTri < 0xf0)
+			{
+				// an edge from the FIFO plus a third vertex
+				const uint32_t fe = codeTri >> 4;
+				a                 = edgeFifo[(edgeOffset - 1 - fe) & 15][0];
+				b                 = edgeFifo[(edgeOffset - 1 - fe) & 15][1];
+
+				const uint32_t fec = codeTri & 15;
+				if (fec < fecMax)
+				{
+					c = fec == 0 ? next++
+					             : vertexFifo[(vertexOffset - 1 - fec) & 15];
+					pushVertex(c, fec == 0);
+				}
+				else
+				{
+					c = last = fec != 15 ? last + (fec == 13 ? -1 : 1)
+					                     : decodeIndex(data, last);
+					pushVertex(c);
+				}
+
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+			else if (codeTri < 0xfe)
+			{
+				// a new vertex plus two from the table
+				const uint8_t  codeAux = codeAuxTable[codeTri & 15];
+				const uint32_t feb     = codeAux >> 4;
+				const uint32_t fec     = codeAux & 15;
+
+				a = next++;
+				b = feb == 0 ? next++ : vertexFifo[(vertexOffset - feb) & 15];
+				c = fec == 0 ? next++ : vertexFifo[(vertexOffset - fec) & 15];
+
+				pushVertex(a);
+				pushVertex(b, feb == 0);
+				pushVertex(c, fec == 0);
+
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+			else
+			{
+				// the same with the codes in the data, and free indices
+				const uint8_t  codeAux = *data++;
+				const uint32_t fea     = codeTri == 0xfe ? 0 : 15;
+				const uint32_t feb     = codeAux >> 4;
+				const uint32_t fec     = codeAux & 15;
+
+				// a zero code restarts the numbering
+				if (codeAux == 0)
+				{
+					next = 0;
+				}
+
+				a = fea == 0 ? next++ : 0;
+				b = feb == 0 ? next++ : vertexFifo[(vertexOffset - feb) & 15];
+				c = fec == 0 ? next++ : vertexFifo[(vertexOffset - fec) & 15];
+
+				if (fea == 15)
+				{
+					last = a = decodeIndex(data, last);
+				}
+				if (feb == 15)
+				{
+					last = b = decodeIndex(data, last);
+				}
+				if (fec == 15)
+				{
+					last = c = decodeIndex(data, last);
+				}
+
+				pushVertex(a);
+				pushVertex(b, feb == 0 || feb == 15);
+				pushVertex(c, fec == 0 || fec == 15);
+
+				pushEdge(b, a);
+				pushEdge(c, b);
+				pushEdge(a, c);
+			}
+
+			writeIndex(dst, i + 0, indexSize, a);
+			writeIndex(dst, i + 1, indexSize, b);
+			writeIndex(dst, i + 2, indexSize, c);
+		}
+
+		return data == dataSafeEnd;
+	}
+
+	// Index sequence codec: zigzagged deltas from one of two baselines
+	bool decodeIndexSequence(std::span<const uint8_t> src,
+	                         uint8_t*                 dst,
+	                         size_t                   indexCount,
+	                         size_t                   indexSize)
+	{
+		if ((indexSize != 2 && indexSize != 4) ||
+		    src.size() < 1 + indexCount + 4 || src[0] != SEQUENCE_HEADER)
+		{
+			return false;
+		}
+
+		const uint8_t* data        = src.data() + 1;
+		const uint8_t* dataSafeEnd = src.data() + src.size() - 4;
+
+		uint32_t last[2] = {0, 0};
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			// an index reads at most 5 bytes, the tail leaves room for them
+			if (data >= dataSafeEnd)
+			{
+				return false;
+			}
+
+			uint32_t       v        = decodeVByte(data);
+			const uint32_t baseline = v & 1;
+			v >>= 1;
+
+			last[baseline] += (v >> 1) ^ (0 - (v & 1));
+			writeIndex(dst, i, indexSize, last[baseline]);
+		}
+
+		return data == dataSafeEnd;
+	}
+
+	int32_t roundToInt(float v)
+	{
+		return int32_t(v + (v >= 0.f ? 0.5f : -0.5f));
+	}
+
+	// x and y of an octahedral map with z holding the encoding of 1, decoded
+	// to a unit vector; w is left as is
+	template <typename T>
+	void decodeOctahedral(T* data, size_t count)
+	{
+		const float maxValue = float((1 << (sizeof(T) * 8 - 1)) - 1);
+		for (size_t i = 0; i < count; i++)
+		{
+			T*    v = data + i * 4;
+			float x = float(v[0]);
+			float y = float(v[1]);
+			float z = float(v[2]) - std::fabs(x) - std::fabs(y);
+
+			// fold the lower hemisphere back out
+			float t = std::min(z, 0.f);
+			x += x >= 0.f ? t : -t;
+			y += y >= 0.f ? t : -t;
+
+			float scale = maxValue / std::sqrt(x * x + y * y + z * z);
+			v[0]        = T(roundToInt(x * scale));
+			v[1]        = T(roundToInt(y * scale));
+			v[2]        = T(roundToInt(z * scale));
+		}
+	}
+
+	// three smallest components of a unit quaternion, the index of the
+	// largest in the low bits of w and the scale in the rest
+	void decodeQuaternion(int16_t* data, size_t count)
+	{
+		const float scale = 1.f / std::sqrt(2.f);
+		for (size_t i = 0; i < count; i++)
+		{
+			int16_t* q = data + i * 4;
+
+			const float s = scale / float(q[3] | 3);
+			const float x = float(q[0]) * s;
+			const float y = float(q[1]) * s;
+			const float z = float(q[2]) * s;
+			const float w = std::sqrt(std::max(1.f - x * x - y * y - z * z, 0.f));
+
+			const uint32_t largest = q[3] & 3;
+			q[(largest + 1) & 3]   = int16_t(roundToInt(x * 32767.f));
+			q[(largest + 2) & 3]   = int16_t(roundToInt(y * 32767.f));
+			q[(largest + 3) & 3]   = int16_t(roundToInt(z * 32767.f));
+			q[(largest + 0) & 3]   = int16_t(int32_t(w * 32767.f + 0.5f));
+		}
+	}
+
+	// 24 bit signed mantissa and 8 bit signed exponent to float
+	void decodeExponential(uint32_t* data, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const int32_t mantissa = int32_t(data[i] << 8) >> 8;
+			const int32_t exponent = int32_t(data[i]) >> 24;
+
+			// 2^exponent times the mantissa, without ldexp
+			uint32_t bits = uint32_t(exponent + 127) << 23;
+			float    power;
+			memcpy(&power, &bits, 4);
+			const float value = power * float(mantissa);
+			memcpy(&data[i], &value, 4);
+		}
+	}
+} // namespace
+
+bool meshoptdec::decode(std::span<const uint8_t> src,
+                        std::span<uint8_t>       dst,
+                        size_t                   count,
+                        size_t                   stride,
+                        Mode                     mode,
+                        Filter                   filter)
+{
+	if (dst.size() < count * stride)
+	{
+		return false;
+	}
+
+	switch (mode)
+	{
+		case Mode::Attributes:
+			if (!decodeVertexBuffer(src, dst.data(), count, stride))
+			{
+				return false;
+			}
+			break;
+		case Mode::Triangles:
+			return filter == Filter::None &&
+			       decodeIndexBuffer(src, dst.data(), count, stride);
+		case Mode::Indices:
+			return filter == Filter::None &&
+			       decodeIndexSequence(src, dst.data(), count, stride);
+	}
+
+	// filters run in place on the decoded attributes
+	switch (filter)
+	{
+		case Filter::None:
+			return true;
+		case Filter::Octahedral:
+			if (stride == 4)
+			{
+				decodeOctahedral(reinterpret_cast<int8_t*>(dst.data()), count);
+				return true;
+			}
+			if (stride == 8)
+			{
+				decodeOctahedral(reinterpret_cast<int16_t*>(dst.data()), count);
+				return true;
+			}
+			return false;
+		case Filter::Quaternion:
+			if (stride != 8)
+			{
+				return false;
+			}
+			decodeQuaternion(reinterpret_cast<int16_t*>(dst.data()), count);
+			return true;
+		case Filter::Exponential:
+			decodeExponential(reinterpret_cast<uint32_t*>(dst.data()),
+			                  count * stride / 4);
+			return true;
+	}
+	return false;
+}
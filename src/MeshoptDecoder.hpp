@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Decoder for buffer views compressed with EXT_meshopt_compression, the
+// vertex and index codecs of meshoptimizer plus its vertex filters
+namespace meshoptdec
+{
+	enum class Mode : uint8_t
+	{
+		Attributes,
+		Triangles,
+		Indices
+	};
+
+	enum class Filter : uint8_t
+	{
+		None,
+		Octahedral,
+		Quaternion,
+		Exponential
+	};
+
+	// Decode count elements of stride bytes from src into dst, which must
+	// hold count * stride bytes. Returns false if src is malformed or the
+	// stride doesn't suit the mode and filter.
+	bool decode(std::span<const uint8_t> src,
+	            std::span<uint8_t>       dst,
+	            size_t                   count,
+	            size_t                   stride,
+	            Mode                     mode,
+	            Filter                   filter);
+} // namespace meshoptdec
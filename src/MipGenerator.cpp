@@ -0,0 +1,258 @@
+#include <MipGenerator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+
+// SSE2 is part of every x86-64 target, other targets use the scalar loops
+#if defined(__SSE2__) || defined(_M_X64)
+#define MIPGEN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	struct SrgbTables
+	{
+		float   m_toLinear[256];
+		uint8_t m_toSrgb[4096]; // indexed by linear value * 4095
+	};
+
+	const SrgbTables& getSrgbTables()
+	{
+		static const SrgbTables tables = []
+		{
+			SrgbTables result;
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				const float c = i / 255.f;
+				result.m_toLinear[i] =
+				c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < 4096; i++)
+			{
+				const float l = i / 4095.f;
+				const float s =
+				l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+				result.m_toSrgb[i] = static_cast<uint8_t>(std::lround(s * 255.f));
+			}
+			return result;
+		}();
+		return tables;
+	}
+
+	// One destination row of the 2x2 box filter, every channel averaged as
+	// is. row1 may equal row0 for the last row of an odd height source.
+	void filterRowLinear(const uint8_t* row0,
+	                     const uint8_t* row1,
+	                     uint32_t       srcMaxX,
+	                     uint8_t*       dst,
+	                     uint32_t       dstWidth)
+	{
+		uint32_t x = 0;
+#ifdef MIPGEN_SSE2
+		// two destination texels from four source texels of each row, as
+		// long as none of them needs clamping
+		const __m128i zero  = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(2);
+		for (; x + 1 < dstWidth && x * 2 + 3 <= srcMaxX; x += 2)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*) (row0 + x * 8));
+			const __m128i b = _mm_loadu_si128((const __m128i*) (row1 + x * 8));
+
+			// vertical sums in 16 bits, texels 0 and 1 in lo, 2 and 3 in hi
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+			                           _mm_unpacklo_epi8(b, zero));
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+			                           _mm_unpackhi_epi8(b, zero));
+
+			// then the horizontal pairs
+			lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+			hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+			__m128i sum = _mm_unpacklo_epi64(lo, hi);
+			sum         = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+			_mm_storel_epi64((__m128i*) (dst + x * 4), _mm_packus_epi16(sum, sum));
+		}
+#endif
+		for (; x < dstWidth; x++)
+		{
+			// clamp so 1 texel wide sources don't read out of bounds
+			const uint32_t x0 = std::min(x * 2, srcMaxX) * 4;
+			const uint32_t x1 = std::min(x * 2 + 1, srcMaxX) * 4;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				dst[x * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+
+	// Same for sRGB color: averaged in linear space, alpha as is
+	void filterRowSrgb(const uint8_t* row0,
+	                   const uint8_t* row1,
+	                   uint32_t       srcMaxX,
+	                   uint8_t*       dst,
+	                   uint32_t       dstWidth)
+	{
+		const SrgbTables& tables   = getSrgbTables();
+		const float*      toLinear = tables.m_toLinear;
+
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			const uint32_t x0 = std::min(x * 2, srcMaxX) * 4;
+			const uint32_t x1 = std::min(x * 2 + 1, srcMaxX) * 4;
+
+			const uint8_t* texels[4] = {row0 + x0, row0 + x1, row1 + x0, row1 + x1};
+
+#ifdef MIPGEN_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (const uint8_t* texel : texels)
+			{
+				sum = _mm_add_ps(sum,
+				                 _mm_set_ps(0.f,
+				                            toLinear[texel[2]],
+				                            toLinear[texel[1]],
+				                            toLinear[texel[0]]));
+			}
+			// mean times the table size, rounded to the nearest entry
+			alignas(16) int32_t indices[4];
+			_mm_store_si128((__m128i*) indices,
+			                _mm_cvtps_epi32(_mm_mul_ps(sum, _mm_set1_ps(4095.f / 4.f))));
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				dst[x * 4 + c] = tables.m_toSrgb[indices[c]];
+			}
+#else
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				const float sum = toLinear[texels[0][c]] + toLinear[texels[1][c]] +
+				                  toLinear[texels[2][c]] + toLinear[texels[3][c]];
+				dst[x * 4 + c] = tables.m_toSrgb[std::lround(sum * (4095.f / 4.f))];
+			}
+#endif
+
+			uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+			dst[x * 4 + 3] = static_cast<uint8_t>((alpha + 2) / 4);
+		}
+	}
+
+	// Share of texels whose alpha, multiplied by scale, passes the cutoff
+	float getAlphaCoverage(std::span<const uint8_t> texels, float cutoff, float scale)
+	{
+		const float threshold = cutoff * 255.f;
+		size_t      passed    = 0;
+		for (size_t i = 3; i < texels.size(); i += 4)
+		{
+			if (texels[i] * scale > threshold)
+			{
+				passed++;
+			}
+		}
+		return float(passed) / float(texels.size() / 4);
+	}
+
+	// Scale the alpha of a level so its coverage matches the full resolution
+	// one (Castaño, "Computing Alpha Mipmaps")
+	void preserveAlphaCoverage(std::span<uint8_t> texels, float cutoff, float coverage)
+	{
+		float low  = 0.f;
+		float high = 4.f;
+		for (uint32_t step = 0; step < 10; step++)
+		{
+			const float scale = (low + high) / 2.f;
+			if (getAlphaCoverage(texels, cutoff, scale) < coverage)
+			{
+				low = scale;
+			}
+			else
+			{
+				high = scale;
+			}
+		}
+
+		const float scale = (low + high) / 2.f;
+		for (size_t i = 3; i < texels.size(); i += 4)
+		{
+			texels[i] =
+			static_cast<uint8_t>(std::min(255l, std::lround(texels[i] * scale)));
+		}
+	}
+} // namespace
+
+uint32_t mipgen::getMipLevelCount(uint32_t width, uint32_t height)
+{
+	return static_cast<uint32_t>(
+	       std::floor(std::log2(std::max(width, height)))) +
+	       1;
+}
+
+void mipgen::buildMipChainRGBA8(std::vector<ImageMipLevel>& levels,
+                                std::vector<uint8_t>&       mipTexels,
+                                const MipFilter&            filter)
+{
+	const VkExtent3D baseExtent = levels[0].m_extent;
+	const uint32_t   levelCount =
+	getMipLevelCount(baseExtent.width, baseExtent.height);
+
+	// size the storage for every level up front, so the spans handed out
+	// below stay valid
+	std::vector<VkExtent3D> extents;
+	size_t                  totalSize = 0;
+	VkExtent3D              extent    = baseExtent;
+	for (uint32_t mip = 1; mip < levelCount; mip++)
+	{
+		extent.width  = std::max(1u, extent.width / 2);
+		extent.height = std::max(1u, extent.height / 2);
+		extents.push_back(extent);
+		totalSize += size_t(extent.width) * extent.height * 4;
+	}
+
+	mipTexels.resize(totalSize);
+	levels.resize(1);
+	levels.reserve(levelCount);
+
+	const bool  alphaTested = filter.m_alphaCutoff >= 0.f;
+	const float coverage =
+	alphaTested ? getAlphaCoverage(levels[0].m_texels, filter.m_alphaCutoff, 1.f)
+	            : 0.f;
+
+	auto filterRow = filter.m_srgb ? filterRowSrgb : filterRowLinear;
+
+	size_t offset = 0;
+	for (const VkExtent3D& dstExtent : extents)
+	{
+		const ImageMipLevel& src      = levels.back();
+		const uint8_t*       srcData  = src.m_texels.data();
+		const uint32_t       srcWidth = src.m_extent.width;
+		const uint32_t       srcMaxX  = src.m_extent.width - 1;
+		const uint32_t       srcMaxY  = src.m_extent.height - 1;
+
+		uint8_t* dstData = mipTexels.data() + offset;
+
+		for (uint32_t y = 0; y < dstExtent.height; y++)
+		{
+			// clamp so 1 texel high sources don't read out of bounds
+			const uint8_t* row0 =
+			srcData + size_t(std::min(y * 2, srcMaxY)) * srcWidth * 4;
+			const uint8_t* row1 =
+			srcData + size_t(std::min(y * 2 + 1, srcMaxY)) * srcWidth * 4;
+
+			filterRow(row0,
+			          row1,
+			          srcMaxX,
+			          dstData + size_t(y) * dstExtent.width * 4,
+			          dstExtent.width);
+		}
+
+		size_t levelSize = size_t(dstExtent.width) * dstExtent.height * 4;
+		if (alphaTested)
+		{
+			preserveAlphaCoverage(
+			{dstData, levelSize}, filter.m_alphaCutoff, coverage);
+		}
+
+		levels.push_back({{dstData, levelSize}, dstExtent});
+		offset += levelSize;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// CPU side mip chain generation, run on the import workers so textures are
+// uploaded with all their levels in a single copy (and can be stored in the
+// baked scene cache) instead of having the GPU blit them down after upload.
+namespace mipgen
+{
+	// How the texels of an image are averaged
+	struct MipFilter
+	{
+		// average color in linear space, for sRGB encoded color textures.
+		// Alpha is linear either way.
+		bool m_srgb {false};
+
+		// keep the share of texels whose alpha passes this cutoff the same on
+		// every level, so alpha tested surfaces don't thin out with distance.
+		// Negative for images that are not alpha tested.
+		float m_alphaCutoff {-1.f};
+	};
+
+	// Number of levels in a full chain, matching ResourceManager::createImage
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	// Build levels 1..n of an RGBA8 image with a 2x2 box filter. levels must
+	// hold the full resolution level; the new levels are appended to it and
+	// their texels are stored in mipTexels.
+	void buildMipChainRGBA8(std::vector<ImageMipLevel>& levels,
+	                        std::vector<uint8_t>&       mipTexels,
+	                        const MipFilter&            filter = {});
+} // namespace mipgen
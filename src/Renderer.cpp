@@ -9,7 +9,12 @@
 #include <imgui.h>
 #include <imgui_impl_vulkan.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <glm/matrix.hpp>
 
 static bool isVisible(const RenderObject& obj, const glm::mat4& viewproj)
 {
@@ -57,6 +62,81 @@ static bool isVisible(const RenderObject& obj, const glm::mat4& viewproj)
 	}
 }
 
+// world space planes of the view frustum, pointing inwards
+static void extractFrustumPlanes(const glm::mat4& viewproj, glm::vec4 planes[6])
+{
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewproj[0][i], viewproj[1][i], viewproj[2][i], viewproj[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // left
+	planes[1] = rows[3] - rows[0]; // right
+	planes[2] = rows[3] + rows[1]; // bottom
+	planes[3] = rows[3] - rows[1]; // top
+	planes[4] = rows[2];           // z >= 0
+	planes[5] = rows[3] - rows[2]; // z <= w
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		// a degenerate plane can't cull anything, let everything pass
+		planes[i] = length > 0.f ? planes[i] / length : glm::vec4(0, 0, 0, 1);
+	}
+}
+
+// Append the instances of an instanced draw whose bounding sphere touches
+// the frustum, and record their range on the draw
+static void cullInstances(RenderObject&          obj,
+                          const glm::vec4        planes[6],
+                          std::vector<uint32_t>& visibleInstances)
+{
+	obj.m_firstVisibleInstance = static_cast<uint32_t>(visibleInstances.size());
+
+	for (uint32_t i = 0; i < obj.m_instanceCount; i++)
+	{
+		glm::mat4 matrix = obj.m_transform * obj.m_instanceTransforms[i];
+
+		// the sphere grows with the largest axis scale
+		glm::vec3 scale(glm::length(glm::vec3(matrix[0])),
+		                glm::length(glm::vec3(matrix[1])),
+		                glm::length(glm::vec3(matrix[2])));
+		glm::vec3 center = matrix * glm::vec4(obj.m_bounds.m_origin, 1.f);
+		float     radius = obj.m_bounds.m_sphereRadius *
+		               std::max(scale.x, std::max(scale.y, scale.z));
+
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; p++)
+		{
+			visible = glm::dot(glm::vec3(planes[p]), center) + planes[p].w > -radius;
+		}
+		if (visible)
+		{
+			visibleInstances.push_back(i);
+		}
+	}
+
+	obj.m_visibleInstanceCount = static_cast<uint32_t>(visibleInstances.size()) -
+	                             obj.m_firstVisibleInstance;
+}
+
+// normal cones only stay valid under rotation and uniform scale, mirrored or
+// squashed transforms skip the back face test
+static bool allowsConeCulling(const glm::mat4& transform)
+{
+	glm::mat3 basis(transform);
+	if (glm::determinant(basis) <= 0.f)
+	{
+		return false;
+	}
+
+	glm::vec3 scale(glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]));
+	float     minScale = std::min(scale.x, std::min(scale.y, scale.z));
+	float     maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+	return maxScale - minScale <= maxScale * 0.01f;
+}
+
 void Renderer::init(VkDevice                     device,
                     ResourceManager*             resourceManager,
                     SwapchainManager*            swapchainManager,
@@ -75,6 +155,7 @@ void Renderer::init(VkDevice                     device,
 	initRenderTargets(windowExtent);
 	initDescriptors();
 	initBackgroundPipelines();
+	initMeshletCullPipeline();
 }
 
 void Renderer::cleanup()
@@ -90,6 +171,11 @@ void Renderer::cleanup()
 	{
 		vkDestroyPipeline(m_device, effect.m_pipeline, nullptr);
 	}
+	if (m_meshletCullPipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(m_device, m_meshletCullPipeline, nullptr);
+	}
+	vkDestroyPipelineLayout(m_device, m_meshletCullPipelineLayout, nullptr);
 
 	// Cleanup descriptor layouts
 	vkDestroyDescriptorSetLayout(m_device, m_drawImageDescriptorLayout, nullptr);
@@ -300,6 +386,58 @@ void Renderer::initBackgroundPipelines()
 	vkDestroyShaderModule(m_device, skyShader, nullptr);
 }
 
+void Renderer::initMeshletCullPipeline()
+{
+	// everything goes through buffer device addresses, no descriptors needed
+	VkPipelineLayoutCreateInfo computeLayout {};
+	computeLayout.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	computeLayout.pNext = nullptr;
+
+	VkPushConstantRange pushConstant {};
+	pushConstant.offset     = 0;
+	pushConstant.size       = sizeof(MeshletCullPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	computeLayout.pPushConstantRanges    = &pushConstant;
+	computeLayout.pushConstantRangeCount = 1;
+
+	VK_CHECK(vkCreatePipelineLayout(
+	m_device, &computeLayout, nullptr, &m_meshletCullPipelineLayout));
+
+	VkShaderModule cullShader;
+	if (!vkutil::loadShaderModule(
+	    "../../shaders/glsl/meshlet_cull.comp.spv", m_device, &cullShader))
+	{
+		// surfaces are drawn directly without the culling pass
+		fmt::print("Error when building the meshlet culling shader \n");
+		return;
+	}
+
+	VkPipelineShaderStageCreateInfo stageinfo {};
+	stageinfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageinfo.pNext  = nullptr;
+	stageinfo.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageinfo.module = cullShader;
+	stageinfo.pName  = "main";
+
+	VkComputePipelineCreateInfo computePipelineCreateInfo {};
+	computePipelineCreateInfo.sType =
+	VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	computePipelineCreateInfo.pNext              = nullptr;
+	computePipelineCreateInfo.layout             = m_meshletCullPipelineLayout;
+	computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	computePipelineCreateInfo.stage              = stageinfo;
+
+	VK_CHECK(vkCreateComputePipelines(m_device,
+	                                  VK_NULL_HANDLE,
+	                                  1,
+	                                  &computePipelineCreateInfo,
+	                                  nullptr,
+	                                  &m_meshletCullPipeline));
+
+	vkDestroyShaderModule(m_device, cullShader, nullptr);
+}
+
 void Renderer::renderFrame(VkCommandBuffer cmd,
                             uint32_t        swapchainImageIndex,
                             FrameData&      currentFrame,
@@ -410,14 +548,146 @@ void Renderer::drawImgui(VkCommandBuffer cmd, VkImageView targetImageView)
 	vkCmdEndRendering(cmd);
 }
 
+MeshletDraws Renderer::cullMeshlets(VkCommandBuffer              cmd,
+                                    FrameData&                   currentFrame,
+                                    const std::vector<uint32_t>& opaqueDraws)
+{
+	// one workgroup per job, keep within the smallest dispatch size limit
+	constexpr size_t MAX_CULL_JOBS = 65535;
+
+	MeshletDraws draws;
+	draws.m_drawJobs.assign(opaqueDraws.size(), -1);
+
+	if (!m_meshletCulling || m_meshletCullPipeline == VK_NULL_HANDLE)
+	{
+		return draws;
+	}
+
+	uint32_t commandCount = 0;
+	for (size_t i = 0; i < opaqueDraws.size(); i++)
+	{
+		const RenderObject& r = m_mainDrawContext.m_OpaqueSurfaces[opaqueDraws[i]];
+		if (r.m_meshletCount == 0 || draws.m_jobs.size() == MAX_CULL_JOBS)
+		{
+			continue;
+		}
+
+		MeshletCullJob job {};
+		job.m_worldMatrix   = r.m_transform;
+		job.m_meshletBuffer = r.m_meshletBufferAddress;
+		job.m_firstMeshlet  = r.m_firstMeshlet;
+		job.m_meshletCount  = r.m_meshletCount;
+		job.m_firstCommand  = commandCount;
+		job.m_coneCulling   = allowsConeCulling(r.m_transform) ? 1 : 0;
+		job.m_baseIndex     = r.m_baseIndex;
+
+		commandCount += r.m_meshletCount;
+		draws.m_drawJobs[i] = static_cast<int32_t>(draws.m_jobs.size());
+		draws.m_jobs.push_back(job);
+	}
+
+	if (draws.m_jobs.empty())
+	{
+		return draws;
+	}
+	m_stats.m_meshletCount = commandCount;
+
+	// the jobs are written by the CPU, the draws and their counts only ever
+	// live on the GPU
+	const size_t jobBytes = draws.m_jobs.size() * sizeof(MeshletCullJob);
+	AllocatedBuffer cullBuffer = m_resourceManager->createBuffer(
+	sizeof(MeshletCullHeader) + jobBytes,
+	VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+	VMA_MEMORY_USAGE_CPU_TO_GPU);
+	AllocatedBuffer commandBuffer = m_resourceManager->createBuffer(
+	commandCount * sizeof(VkDrawIndexedIndirectCommand),
+	VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+	VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+	VMA_MEMORY_USAGE_GPU_ONLY);
+	AllocatedBuffer countBuffer = m_resourceManager->createBuffer(
+	draws.m_jobs.size() * sizeof(uint32_t),
+	VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+	VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+	VMA_MEMORY_USAGE_GPU_ONLY);
+
+	ResourceManager* rm = m_resourceManager;
+	currentFrame.m_deletionQueue.push_function(
+	[rm, cullBuffer, commandBuffer, countBuffer]()
+	{
+		rm->destroyBuffer(cullBuffer);
+		rm->destroyBuffer(commandBuffer);
+		rm->destroyBuffer(countBuffer);
+	});
+
+	MeshletCullHeader* header =
+	(MeshletCullHeader*) cullBuffer.m_info.pMappedData;
+	extractFrustumPlanes(m_sceneData.m_viewproj, header->m_frustumPlanes);
+	header->m_cameraPosition = glm::vec4(m_camera->m_position, 1.f);
+	memcpy(header + 1, draws.m_jobs.data(), jobBytes);
+
+	draws.m_commandBuffer = commandBuffer.m_buffer;
+	draws.m_countBuffer   = countBuffer.m_buffer;
+
+	// the shader appends to the counts, start them at zero
+	vkCmdFillBuffer(cmd, countBuffer.m_buffer, 0, VK_WHOLE_SIZE, 0);
+	vkutil::memoryBarrier(cmd,
+	                      VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+	                      VK_ACCESS_2_TRANSFER_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	                      VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+	                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+	MeshletCullPushConstants pushConstants {};
+	pushConstants.m_cullData     = rm->getBufferAddress(cullBuffer);
+	pushConstants.m_drawCommands = rm->getBufferAddress(commandBuffer);
+	pushConstants.m_drawCounts   = rm->getBufferAddress(countBuffer);
+	pushConstants.m_jobCount     = static_cast<uint32_t>(draws.m_jobs.size());
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_meshletCullPipeline);
+	vkCmdPushConstants(cmd,
+	                   m_meshletCullPipelineLayout,
+	                   VK_SHADER_STAGE_COMPUTE_BIT,
+	                   0,
+	                   sizeof(MeshletCullPushConstants),
+	                   &pushConstants);
+	vkCmdDispatch(cmd, pushConstants.m_jobCount, 1, 1);
+
+	// make the draws visible to the indirect draw calls
+	vkutil::memoryBarrier(cmd,
+	                      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+	                      VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+	                      VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+	return draws;
+}
+
 void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 {
 	// reset counters
 	m_stats.m_drawcallCount = 0;
 	m_stats.m_triangleCount = 0;
+	m_stats.m_meshletCount  = 0;
+	m_stats.m_instanceCount = 0;
 	// begin clock
 	auto start = std::chrono::system_clock::now();
 
+	// instanced draws are culled per instance, the visible ones of every
+	// draw are listed in one buffer
+	glm::vec4 frustumPlanes[6];
+	extractFrustumPlanes(m_sceneData.m_viewproj, frustumPlanes);
+	std::vector<uint32_t> visibleInstances;
+
+	auto cull = [&](RenderObject& r)
+	{
+		if (r.m_instanceCount == 0)
+		{
+			return isVisible(r, m_sceneData.m_viewproj);
+		}
+		cullInstances(r, frustumPlanes, visibleInstances);
+		return r.m_visibleInstanceCount > 0;
+	};
+
 	std::vector<uint32_t> opaqueDraws;
 	opaqueDraws.reserve(m_mainDrawContext.m_OpaqueSurfaces.size());
 	std::vector<uint32_t> transparentDraws;
@@ -425,8 +695,7 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 
 	for (uint32_t i = 0; i < m_mainDrawContext.m_OpaqueSurfaces.size(); i++)
 	{
-		if (isVisible(m_mainDrawContext.m_OpaqueSurfaces[i],
-		              m_sceneData.m_viewproj))
+		if (cull(m_mainDrawContext.m_OpaqueSurfaces[i]))
 		{
 			opaqueDraws.push_back(i);
 		}
@@ -434,8 +703,7 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 	for (uint32_t i = 0; i < m_mainDrawContext.m_TransparentSurfaces.size();
 	     i++)
 	{
-		if (isVisible(m_mainDrawContext.m_TransparentSurfaces[i],
-		              m_sceneData.m_viewproj))
+		if (cull(m_mainDrawContext.m_TransparentSurfaces[i]))
 		{
 			transparentDraws.push_back(i);
 		}
@@ -452,6 +720,10 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 		          m_mainDrawContext.m_OpaqueSurfaces[iB];
 		          if (A.m_material == B.m_material)
 		          {
+			          if (A.m_indexBuffer == B.m_indexBuffer)
+			          {
+				          return A.m_indexType < B.m_indexType;
+			          }
 			          return A.m_indexBuffer < B.m_indexBuffer;
 		          }
 		          else
@@ -481,6 +753,10 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 		return distA > distB;
 	});
 
+	// cull the meshlets of the opaque surfaces on the GPU, has to be recorded
+	// outside of the render pass
+	MeshletDraws meshletDraws = cullMeshlets(cmd, currentFrame, opaqueDraws);
+
 	// begin a render pass with MSAA images that resolve to draw image
 	VkRenderingAttachmentInfo colorAttachment =
 	vkinit::attachmentInfoMsaa(m_msaaColorImage.m_imageView,
@@ -511,6 +787,22 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 	(GPUSceneData*) gpuSceneDataBuffer.m_info.pMappedData;
 	*sceneUniformData = m_sceneData;
 
+	VkDeviceAddress visibleInstanceAddress = 0;
+	if (!visibleInstances.empty())
+	{
+		AllocatedBuffer visibleInstanceBuffer = m_resourceManager->createBuffer(
+		visibleInstances.size() * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU);
+		currentFrame.m_deletionQueue.push_function(
+		[rm, visibleInstanceBuffer]() { rm->destroyBuffer(visibleInstanceBuffer); });
+
+		memcpy(visibleInstanceBuffer.m_info.pMappedData,
+		       visibleInstances.data(),
+		       visibleInstances.size() * sizeof(uint32_t));
+		visibleInstanceAddress = rm->getBufferAddress(visibleInstanceBuffer);
+	}
+
 	// create a descriptor set that binds that buffer and update it
 	VkDescriptorSet globalDescriptor =
 	currentFrame.m_frameDescriptors.allocate(
@@ -528,8 +820,10 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 	MaterialPipeline* lastPipeline    = nullptr;
 	MaterialInstance* lastMaterial    = nullptr;
 	VkBuffer          lastIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType       lastIndexType   = VK_INDEX_TYPE_MAX_ENUM;
 
-	auto draw = [&](const RenderObject& r)
+	// job is the meshlet culling job of the draw, -1 to draw it directly
+	auto draw = [&](const RenderObject& r, int32_t job)
 	{
 		if (r.m_material != lastMaterial)
 		{
@@ -581,17 +875,31 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 			                        nullptr);
 		}
 
-		// rebind index buffer if needed
-		if (r.m_indexBuffer != lastIndexBuffer)
+		// rebind index buffer if needed. Meshes share the arena's index
+		// buffers with indices of both types, the draws address their own
+		// through the first index.
+		if (r.m_indexBuffer != lastIndexBuffer || r.m_indexType != lastIndexType)
 		{
 			lastIndexBuffer = r.m_indexBuffer;
-			vkCmdBindIndexBuffer(cmd, r.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			lastIndexType   = r.m_indexType;
+			vkCmdBindIndexBuffer(cmd, r.m_indexBuffer, 0, r.m_indexType);
 		}
 
 		// calculate final mesh matrix
 		GPUDrawPushConstants push_constants;
-		push_constants.m_worldMatrix  = r.m_transform;
-		push_constants.m_vertexBuffer = r.m_vertexBufferAddress;
+		push_constants.m_worldMatrix    = r.m_transform;
+		push_constants.m_vertexBuffer   = r.m_vertexBufferAddress;
+		push_constants.m_colorBuffer    = r.m_colorBufferAddress;
+		push_constants.m_positionOffset = r.m_positionOffset;
+		push_constants.m_vertexFormat   = r.m_vertexFormat;
+		push_constants.m_positionScale  = r.m_positionScale;
+		push_constants.m_instanceBuffer   = r.m_instanceBufferAddress;
+		push_constants.m_visibleInstances = 0;
+		if (r.m_instanceCount > 0)
+		{
+			push_constants.m_visibleInstances =
+			visibleInstanceAddress + r.m_firstVisibleInstance * sizeof(uint32_t);
+		}
 
 		vkCmdPushConstants(cmd,
 		                   r.m_material->m_pipeline->m_layout,
@@ -600,21 +908,46 @@ void Renderer::drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame)
 		                   sizeof(GPUDrawPushConstants),
 		                   &push_constants);
 
-		vkCmdDrawIndexed(cmd, r.m_indexCount, 1, r.m_firstIndex, 0, 0);
+		if (job >= 0)
+		{
+			// one indexed draw per meshlet that survived culling
+			const MeshletCullJob& cullJob = meshletDraws.m_jobs[job];
+			vkCmdDrawIndexedIndirectCount(
+			cmd,
+			meshletDraws.m_commandBuffer,
+			cullJob.m_firstCommand * sizeof(VkDrawIndexedIndirectCommand),
+			meshletDraws.m_countBuffer,
+			job * sizeof(uint32_t),
+			cullJob.m_meshletCount,
+			sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else if (r.m_instanceCount > 0)
+		{
+			// the shader finds the instance through gl_InstanceIndex
+			vkCmdDrawIndexed(
+			cmd, r.m_indexCount, r.m_visibleInstanceCount, r.m_firstIndex, 0, 0);
+			m_stats.m_instanceCount += r.m_visibleInstanceCount;
+		}
+		else
+		{
+			vkCmdDrawIndexed(cmd, r.m_indexCount, 1, r.m_firstIndex, 0, 0);
+		}
 
-		// add counters for triangles and draws
+		// add counters for triangles and draws, before GPU culling
 		m_stats.m_drawcallCount++;
-		m_stats.m_triangleCount += r.m_indexCount / 3;
+		m_stats.m_triangleCount +=
+		r.m_indexCount / 3 * std::max(r.m_visibleInstanceCount, 1u);
 	};
 
-	for (auto& r : opaqueDraws)
+	for (size_t i = 0; i < opaqueDraws.size(); i++)
 	{
-		draw(m_mainDrawContext.m_OpaqueSurfaces[r]);
+		draw(m_mainDrawContext.m_OpaqueSurfaces[opaqueDraws[i]],
+		     meshletDraws.m_drawJobs[i]);
 	}
 
 	for (auto& r : transparentDraws)
 	{
-		draw(m_mainDrawContext.m_TransparentSurfaces[r]);
+		draw(m_mainDrawContext.m_TransparentSurfaces[r], -1);
 	}
 
 	// Draw skybox last (after all geometry)
@@ -637,6 +970,7 @@ void Renderer::updateScene(float deltaTime, VkExtent2D windowExtent)
 
 	m_mainDrawContext.m_OpaqueSurfaces.clear();
 	m_mainDrawContext.m_TransparentSurfaces.clear();
+	m_mainDrawContext.m_lodSurfaceCount = 0;
 
 	m_camera->update(deltaTime);
 	// camera view
@@ -652,10 +986,18 @@ void Renderer::updateScene(float deltaTime, VkExtent2D windowExtent)
 	// to opengl and gltf axis
 	projection[1][1] *= -1;
 
+	// error in pixels = error / distance * lodScale, for the window's height
+	// and the 70 degree vertical field of view
+	m_mainDrawContext.m_cameraPosition = m_camera->m_position;
+	m_mainDrawContext.m_lodScale =
+	windowExtent.height / (2.f * std::tan(glm::radians(70.f) / 2.f));
+	m_mainDrawContext.m_lodPixelError = m_lodPixelError;
+
 	for (auto& [name, scene] : m_loadedScenes)
 	{
 		scene->Draw(glm::mat4 {1.f}, m_mainDrawContext);
 	}
+	m_stats.m_lodSurfaceCount = m_mainDrawContext.m_lodSurfaceCount;
 
 	m_sceneData.m_view = view;
 	// camera projection
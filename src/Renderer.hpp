@@ -23,6 +23,9 @@ struct EngineStats
 	int   m_drawcallCount;
 	float m_sceneUpdateTime;
 	float m_meshDrawTime;
+	int   m_meshletCount; // submitted to the culling pass
+	int   m_lodSurfaceCount; // drawn with a simplified LOD
+	int   m_instanceCount; // visible instances of instanced draws
 };
 
 struct ComputePushConstants
@@ -43,22 +46,93 @@ struct ComputeEffect
 	ComputePushConstants m_data;
 };
 
+// one opaque draw for the meshlet culling pass, mirrors CullJob in
+// meshlet_cull.comp
+struct MeshletCullJob
+{
+	glm::mat4       m_worldMatrix;
+	VkDeviceAddress m_meshletBuffer;
+	uint32_t        m_firstMeshlet;
+	uint32_t        m_meshletCount;
+	uint32_t        m_firstCommand; // first draw command slot of this job
+	uint32_t        m_coneCulling;
+	uint32_t        m_baseIndex; // added to the index ranges of the meshlets
+	uint32_t        m_pad1;
+};
+static_assert(sizeof(MeshletCullJob) == 96);
+
+// view data at the start of the cull buffer, followed by the jobs
+struct MeshletCullHeader
+{
+	glm::vec4 m_frustumPlanes[6];
+	glm::vec4 m_cameraPosition;
+};
+
+struct MeshletCullPushConstants
+{
+	VkDeviceAddress m_cullData;
+	VkDeviceAddress m_drawCommands;
+	VkDeviceAddress m_drawCounts;
+	uint32_t        m_jobCount;
+};
+
+// indirect draws the culling pass produced for one frame
+struct MeshletDraws
+{
+	VkBuffer m_commandBuffer = VK_NULL_HANDLE;
+	VkBuffer m_countBuffer   = VK_NULL_HANDLE;
+
+	std::vector<MeshletCullJob> m_jobs;
+	// per opaque draw, -1 if it is drawn directly
+	std::vector<int32_t> m_drawJobs;
+};
+
 struct RenderObject
 {
-	uint32_t m_indexCount;
-	uint32_t m_firstIndex;
-	VkBuffer m_indexBuffer;
+	uint32_t    m_indexCount;
+	uint32_t    m_firstIndex;
+	VkBuffer    m_indexBuffer; // a geometry arena page, shared by many meshes
+	VkIndexType m_indexType;
+	uint32_t    m_baseIndex; // first index of the mesh, meshlets are relative
 
 	MaterialInstance* m_material;
 	Bounds            m_bounds;
 	glm::mat4         m_transform;
 	VkDeviceAddress   m_vertexBufferAddress;
+
+	// vertex layout of the mesh and what the shader needs to decode it
+	VertexFormat    m_vertexFormat;
+	VkDeviceAddress m_colorBufferAddress;
+	glm::vec3       m_positionScale;
+	glm::vec3       m_positionOffset;
+
+	// meshlets of the surface, 0 if the mesh has none
+	VkDeviceAddress m_meshletBufferAddress;
+	uint32_t        m_firstMeshlet;
+	uint32_t        m_meshletCount;
+
+	// instances of an EXT_mesh_gpu_instancing node, relative to m_transform.
+	// m_instanceCount is 0 for regular draws.
+	uint32_t         m_instanceCount {0};
+	const glm::mat4* m_instanceTransforms {nullptr};
+	VkDeviceAddress  m_instanceBufferAddress {0};
+	// range of the instances that survived culling, filled by the renderer
+	uint32_t m_firstVisibleInstance {0};
+	uint32_t m_visibleInstanceCount {0};
 };
 
 struct DrawContext
 {
 	std::vector<RenderObject> m_OpaqueSurfaces;
 	std::vector<RenderObject> m_TransparentSurfaces;
+
+	// LOD selection: surfaces use their coarsest LOD whose error stays below
+	// m_lodPixelError pixels. m_lodScale is the size in pixels of one unit
+	// seen from one unit away, 0 always draws the full surfaces.
+	glm::vec3 m_cameraPosition {0.f};
+	float     m_lodScale {0.f};
+	float     m_lodPixelError {1.f};
+	uint32_t  m_lodSurfaceCount {0};
 };
 
 class Renderer
@@ -92,6 +166,14 @@ public:
 	{
 		return m_msaaSamples;
 	}
+	bool& getMeshletCulling()
+	{
+		return m_meshletCulling;
+	}
+	float& getLodPixelError()
+	{
+		return m_lodPixelError;
+	}
 	EngineStats& getStats()
 	{
 		return m_stats;
@@ -138,8 +220,10 @@ private:
 	VkExtent2D     m_drawExtent;
 
 	// Render settings
-	float                     m_renderScale  = 1.f;
-	VkSampleCountFlagBits     m_msaaSamples  = VK_SAMPLE_COUNT_4_BIT;
+	float                     m_renderScale    = 1.f;
+	VkSampleCountFlagBits     m_msaaSamples    = VK_SAMPLE_COUNT_4_BIT;
+	bool                      m_meshletCulling = true;
+	float                     m_lodPixelError  = 1.f;
 
 	// Scene data
 	DrawContext                                              m_mainDrawContext;
@@ -157,16 +241,24 @@ private:
 	std::vector<ComputeEffect> m_backgroundEffects;
 	int                        m_currentBackgroundEffect {0};
 
+	// Meshlet culling, null if the pipeline could not be built
+	VkPipeline       m_meshletCullPipeline       = VK_NULL_HANDLE;
+	VkPipelineLayout m_meshletCullPipelineLayout = VK_NULL_HANDLE;
+
 	// Statistics
 	EngineStats m_stats;
 
 	// Private rendering functions
 	void drawBackground(VkCommandBuffer cmd);
 	void drawGeometry(VkCommandBuffer cmd, FrameData& currentFrame);
+	MeshletDraws cullMeshlets(VkCommandBuffer              cmd,
+	                          FrameData&                   currentFrame,
+	                          const std::vector<uint32_t>& opaqueDraws);
 	void drawImgui(VkCommandBuffer cmd, VkImageView targetImageView);
 
 	// Initialization helpers
 	void initRenderTargets(VkExtent2D windowExtent);
 	void initDescriptors();
 	void initBackgroundPipelines();
+	void initMeshletCullPipeline();
 };
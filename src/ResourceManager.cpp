@@ -2,24 +2,41 @@
 
 #include <Images.hpp>
 #include <Initializers.hpp>
+#include <StbStaging.hpp>
 #include <VulkanTools.hpp>
 
+#include <bit>
 #include <cmath>
 #include <cstring>
+#include <limits>
 
+#include <stb_image.h>
 #include <vk_mem_alloc.h>
 
+// full mip chain down to 1x1
+static uint32_t getMipLevelCount(VkExtent3D size)
+{
+	return static_cast<uint32_t>(
+	       std::floor(std::log2(std::max(size.width, size.height)))) +
+	       1;
+}
+
 void ResourceManager::init(VkInstance       instance,
                            VkPhysicalDevice physicalDevice,
                            VkDevice         device,
                            VkQueue          graphicsQueue,
-                           uint32_t         graphicsQueueFamily)
+                           uint32_t         graphicsQueueFamily,
+                           VkQueue          transferQueue,
+                           uint32_t         transferQueueFamily,
+                           bool             externalMemoryHost,
+                           bool             textureCompressionBC)
 {
-	m_instance            = instance;
-	m_physicalDevice      = physicalDevice;
-	m_device              = device;
-	m_graphicsQueue       = graphicsQueue;
-	m_graphicsQueueFamily = graphicsQueueFamily;
+	m_instance             = instance;
+	m_physicalDevice       = physicalDevice;
+	m_device               = device;
+	m_graphicsQueue        = graphicsQueue;
+	m_graphicsQueueFamily  = graphicsQueueFamily;
+	m_textureCompressionBC = textureCompressionBC;
 
 	// initialize the memory allocator
 	VmaAllocatorCreateInfo allocatorInfo = {};
@@ -35,33 +52,47 @@ void ResourceManager::init(VkInstance       instance,
 	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_4;
 	VK_CHECK(vmaCreateAllocator(&allocatorInfo, &m_allocator));
 
+	// mapped files are imported in steps of this alignment
+	if (externalMemoryHost)
+	{
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT};
+		VkPhysicalDeviceProperties2 properties {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &hostProperties};
+		vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+		m_hostPointerAlignment = hostProperties.minImportedHostPointerAlignment;
+	}
+
 	m_mainDeletionQueue.push_function([&]()
 	                                  { vmaDestroyAllocator(m_allocator); });
 
-	// Initialize immediate submit resources
-	VkCommandPoolCreateInfo commandPoolInfo =
-	    vkinit::commandPoolCreateInfo(m_graphicsQueueFamily,
-	                                  VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-
-	VK_CHECK(vkCreateCommandPool(
-	    m_device, &commandPoolInfo, nullptr, &m_immCommandPool));
-
-	// allocate the command buffer for immediate submits
-	VkCommandBufferAllocateInfo cmdAllocInfo =
-	    vkinit::commandBufferAllocateInfo(m_immCommandPool, 1);
-
-	VK_CHECK(
-	    vkAllocateCommandBuffers(m_device, &cmdAllocInfo, &m_immCommandBuffer));
-
-	// Create fence for immediate submit synchronization
-	VkFenceCreateInfo fenceCreateInfo =
-	    vkinit::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
-	VK_CHECK(vkCreateFence(m_device, &fenceCreateInfo, nullptr, &m_immFence));
-
-	m_mainDeletionQueue.push_function(
-	    [=]() { vkDestroyCommandPool(m_device, m_immCommandPool, nullptr); });
+	// immediate submit resources are made per thread, see getImmediateContext
 	m_mainDeletionQueue.push_function(
-	    [=]() { vkDestroyFence(m_device, m_immFence, nullptr); });
+	[this]()
+	{
+		for (auto& [thread, context] : m_immContexts)
+		{
+			vkDestroyCommandPool(m_device, context.m_commandPool, nullptr);
+			vkDestroyFence(m_device, context.m_fence, nullptr);
+		}
+		m_immContexts.clear();
+	});
+
+	// mesh ranges may still be read by uploads in flight, so the arena goes
+	// after the upload queue
+	m_geometryArena.init(m_device, m_allocator);
+	m_mainDeletionQueue.push_function([this]() { m_geometryArena.cleanup(); });
+
+	// staging buffers of the upload queue live in the allocator, so it is
+	// cleaned up before that
+	m_uploadQueue.init(m_device,
+	                   m_allocator,
+	                   m_graphicsQueue,
+	                   m_graphicsQueueFamily,
+	                   transferQueue,
+	                   transferQueueFamily);
+	m_mainDeletionQueue.push_function([this]() { m_uploadQueue.cleanup(); });
 }
 
 void ResourceManager::cleanup()
@@ -69,9 +100,10 @@ void ResourceManager::cleanup()
 	m_mainDeletionQueue.flush();
 }
 
-AllocatedBuffer ResourceManager::createBuffer(size_t             allocSize,
-                                              VkBufferUsageFlags usage,
-                                              VmaMemoryUsage     memoryUsage)
+AllocatedBuffer ResourceManager::createBuffer(size_t                   allocSize,
+                                              VkBufferUsageFlags       usage,
+                                              VmaMemoryUsage           memoryUsage,
+                                              VmaAllocationCreateFlags flags)
 {
 	// allocate buffer
 	VkBufferCreateInfo bufferInfo = {.sType =
@@ -83,7 +115,7 @@ AllocatedBuffer ResourceManager::createBuffer(size_t             allocSize,
 
 	VmaAllocationCreateInfo vmaallocInfo = {};
 	vmaallocInfo.usage                   = memoryUsage;
-	vmaallocInfo.flags                   = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	vmaallocInfo.flags                   = VMA_ALLOCATION_CREATE_MAPPED_BIT | flags;
 	AllocatedBuffer newBuffer;
 
 	// allocate the buffer
@@ -97,16 +129,355 @@ AllocatedBuffer ResourceManager::createBuffer(size_t             allocSize,
 	return newBuffer;
 }
 
+AllocatedBuffer ResourceManager::createBuffer(std::span<const std::byte> data,
+                                              VkBufferUsageFlags         usage)
+{
+	return createDeviceBuffer(data.size(),
+	                          usage,
+	                          [data](void* dst)
+	                          { memcpy(dst, data.data(), data.size()); });
+}
+
+AllocatedBuffer
+ResourceManager::createDeviceBuffer(size_t                            size,
+                                    VkBufferUsageFlags                usage,
+                                    const std::function<void(void*)>& write)
+{
+	// device local memory the host can write to on UMA devices and with
+	// resizable BAR, VMA falls back to memory without host access otherwise
+	AllocatedBuffer buffer =
+	createBuffer(size,
+	             usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+	             VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+	             VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT);
+
+	fillBuffer(buffer, 0, size, write);
+	return buffer;
+}
+
+void ResourceManager::fillBuffer(const AllocatedBuffer&            buffer,
+                                 VkDeviceSize                      offset,
+                                 size_t                            size,
+                                 const std::function<void(void*)>& write)
+{
+	VkMemoryPropertyFlags memoryFlags;
+	vmaGetAllocationMemoryProperties(m_allocator, buffer.m_allocation, &memoryFlags);
+	if ((memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+	    buffer.m_info.pMappedData)
+	{
+		// no copy and no transfer submission, the host writes are visible
+		// to every queue submission made after them
+		write(static_cast<uint8_t*>(buffer.m_info.pMappedData) + offset);
+		VK_CHECK(vmaFlushAllocation(m_allocator, buffer.m_allocation, offset, size));
+		return;
+	}
+
+	StagingAllocation staging = m_uploadQueue.allocateStaging(size);
+	write(staging.m_data);
+
+	VkBufferCopy copy {0};
+	copy.srcOffset = staging.m_offset;
+	copy.dstOffset = offset;
+	copy.size      = size;
+	m_uploadQueue.copyBuffer(staging, buffer.m_buffer, copy);
+}
+
+GeometryAllocation
+ResourceManager::uploadGeometry(GeometryArena::Kind               kind,
+                                size_t                            size,
+                                const std::function<void(void*)>& write)
+{
+	GeometryAllocation allocation = m_geometryArena.allocate(kind, size);
+	fillBuffer(m_geometryArena.getBuffer(allocation), allocation.m_offset, size, write);
+	return allocation;
+}
+
+GeometryAllocation ResourceManager::uploadGeometry(GeometryArena::Kind        kind,
+                                                   std::span<const std::byte> data,
+                                                   HostMemoryImport*          source)
+{
+	// data in imported host memory is copied by the GPU, the CPU never
+	// touches it
+	if (source && source->contains(data))
+	{
+		GeometryAllocation allocation = m_geometryArena.allocate(kind, data.size());
+
+		VkBufferCopy copy {0};
+		copy.srcOffset = reinterpret_cast<const uint8_t*>(data.data()) - source->m_data;
+		copy.dstOffset = allocation.m_offset;
+		copy.size      = data.size();
+		m_uploadQueue.copyBuffer(source->m_buffer, allocation.m_buffer, copy);
+
+		source->m_copiedBytes += data.size();
+		return allocation;
+	}
+
+	return uploadGeometry(kind,
+	                      data.size(),
+	                      [data](void* dst)
+	                      { memcpy(dst, data.data(), data.size()); });
+}
+
+std::optional<HostMemoryImport>
+ResourceManager::importMappedFile(std::shared_ptr<const MappedFile> file)
+{
+	if (m_hostPointerAlignment == 0 || !file || !file->isOpen())
+	{
+		return {};
+	}
+
+	// the imported range has to start and end on the driver's alignment,
+	// which may be coarser than the pages of the mapping
+	const uintptr_t alignment = m_hostPointerAlignment;
+	const uintptr_t begin     = reinterpret_cast<uintptr_t>(file->data());
+	const uintptr_t start     = (begin + alignment - 1) & ~(alignment - 1);
+	const uintptr_t end       = (begin + file->size()) & ~(alignment - 1);
+	if (end <= start)
+	{
+		return {};
+	}
+
+	// the GPU only reads from it, the mapping stays read only
+	void* pointer = reinterpret_cast<void*>(start);
+
+	// fails for memory the driver can't import, such as file mappings on
+	// some platforms
+	VkMemoryHostPointerPropertiesEXT pointerProperties {
+	.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+	if (vkGetMemoryHostPointerPropertiesEXT(
+	    m_device,
+	    VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+	    pointer,
+	    &pointerProperties) != VK_SUCCESS)
+	{
+		return {};
+	}
+
+	HostMemoryImport import;
+	import.m_file = std::move(file);
+	import.m_data = reinterpret_cast<const uint8_t*>(start);
+	import.m_size = end - start;
+
+	VkExternalMemoryBufferCreateInfo externalInfo {
+	.sType       = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+	.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT};
+	VkBufferCreateInfo bufferInfo {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+	                               .pNext = &externalInfo};
+	bufferInfo.size  = import.m_size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	VK_CHECK(vkCreateBuffer(m_device, &bufferInfo, nullptr, &import.m_buffer));
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(m_device, import.m_buffer, &requirements);
+	const uint32_t memoryTypes =
+	requirements.memoryTypeBits & pointerProperties.memoryTypeBits;
+
+	VkImportMemoryHostPointerInfoEXT importInfo {
+	.sType        = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+	.handleType   = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+	.pHostPointer = pointer};
+	VkMemoryAllocateInfo allocInfo {.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+	                                .pNext = &importInfo};
+	allocInfo.allocationSize  = import.m_size;
+	allocInfo.memoryTypeIndex = std::countr_zero(memoryTypes);
+
+	if (memoryTypes == 0 ||
+	    vkAllocateMemory(m_device, &allocInfo, nullptr, &import.m_memory) != VK_SUCCESS)
+	{
+		vkDestroyBuffer(m_device, import.m_buffer, nullptr);
+		return {};
+	}
+	VK_CHECK(vkBindBufferMemory(m_device, import.m_buffer, import.m_memory, 0));
+	return import;
+}
+
+void ResourceManager::releaseMappedFile(HostMemoryImport&& import)
+{
+	// copies out of it may still be in flight. The file is unmapped when the
+	// last reference goes, after the memory was freed.
+	m_uploadQueue.deferRelease(
+	[device = m_device,
+	 buffer = import.m_buffer,
+	 memory = import.m_memory,
+	 file   = std::move(import.m_file)]()
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	});
+}
+
 void ResourceManager::destroyBuffer(const AllocatedBuffer& buffer)
 {
 	vmaDestroyBuffer(m_allocator, buffer.m_buffer, buffer.m_allocation);
 }
 
+VkDeviceAddress
+ResourceManager::getBufferAddress(const AllocatedBuffer& buffer) const
+{
+	VkBufferDeviceAddressInfo deviceAdressInfo {
+	.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+	.buffer = buffer.m_buffer};
+	return vkGetBufferDeviceAddress(m_device, &deviceAdressInfo);
+}
+
+void ResourceManager::destroyMesh(const GPUMeshBuffers& mesh)
+{
+	// the ranges are reused by the next meshes uploaded, empty ones are
+	// skipped by the arena
+	m_geometryArena.free(mesh.m_indexAllocation);
+	m_geometryArena.free(mesh.m_vertexAllocation);
+	m_geometryArena.free(mesh.m_colorAllocation);
+	m_geometryArena.free(mesh.m_meshletAllocation);
+}
+
+AllocatedImage
+ResourceManager::acquireImage(uint64_t                               contentHash,
+                              size_t                                 size,
+                              const std::function<AllocatedImage()>& create)
+{
+	{
+		std::lock_guard lock(m_sharedMutex);
+		m_sharedStats.m_imageRequests++;
+
+		auto it = m_sharedImages.find(contentHash);
+		if (it != m_sharedImages.end())
+		{
+			it->second.m_refCount++;
+			m_sharedStats.m_imageHits++;
+			m_sharedStats.m_bytesSaved += it->second.m_size;
+			return it->second.m_resource;
+		}
+	}
+
+	// made without the lock, other threads keep loading meanwhile
+	AllocatedImage image = create();
+
+	std::unique_lock lock(m_sharedMutex);
+	auto [it, inserted] =
+	m_sharedImages.try_emplace(contentHash, SharedResource<AllocatedImage> {image, size, 1});
+	if (inserted)
+	{
+		m_sharedImageHashes[image.m_image] = contentHash;
+		return image;
+	}
+
+	// another thread made the same image first, ours goes once its upload
+	// is done
+	it->second.m_refCount++;
+	m_sharedStats.m_imageHits++;
+	m_sharedStats.m_bytesSaved += it->second.m_size;
+	AllocatedImage shared = it->second.m_resource;
+	lock.unlock();
+
+	m_uploadQueue.deferRelease([this, image]() { destroyImage(image); });
+	return shared;
+}
+
+void ResourceManager::releaseImage(const AllocatedImage& image)
+{
+	std::lock_guard lock(m_sharedMutex);
+
+	auto hash = m_sharedImageHashes.find(image.m_image);
+	if (hash == m_sharedImageHashes.end())
+	{
+		destroyImage(image);
+		return;
+	}
+
+	auto it = m_sharedImages.find(hash->second);
+	if (--it->second.m_refCount > 0)
+	{
+		m_sharedStats.m_bytesSaved -= it->second.m_size;
+		return;
+	}
+
+	destroyImage(image);
+	m_sharedImages.erase(it);
+	m_sharedImageHashes.erase(hash);
+}
+
+GPUMeshBuffers
+ResourceManager::acquireMesh(uint64_t                               contentHash,
+                             size_t                                 size,
+                             const std::function<GPUMeshBuffers()>& create)
+{
+	{
+		std::lock_guard lock(m_sharedMutex);
+		m_sharedStats.m_meshRequests++;
+
+		auto it = m_sharedMeshes.find(contentHash);
+		if (it != m_sharedMeshes.end())
+		{
+			it->second.m_refCount++;
+			m_sharedStats.m_meshHits++;
+			m_sharedStats.m_bytesSaved += it->second.m_size;
+			return it->second.m_resource;
+		}
+	}
+
+	GPUMeshBuffers mesh = create();
+
+	std::unique_lock lock(m_sharedMutex);
+	auto [it, inserted] =
+	m_sharedMeshes.try_emplace(contentHash, SharedResource<GPUMeshBuffers> {mesh, size, 1});
+	if (inserted)
+	{
+		m_sharedMeshHashes[mesh.m_vertexBufferAddress] = contentHash;
+		return mesh;
+	}
+
+	// lost the race like in acquireImage
+	it->second.m_refCount++;
+	m_sharedStats.m_meshHits++;
+	m_sharedStats.m_bytesSaved += it->second.m_size;
+	GPUMeshBuffers shared = it->second.m_resource;
+	lock.unlock();
+
+	m_uploadQueue.deferRelease([this, mesh]() { destroyMesh(mesh); });
+	return shared;
+}
+
+void ResourceManager::releaseMesh(const GPUMeshBuffers& mesh)
+{
+	std::lock_guard lock(m_sharedMutex);
+
+	auto hash = m_sharedMeshHashes.find(mesh.m_vertexBufferAddress);
+	if (hash == m_sharedMeshHashes.end())
+	{
+		destroyMesh(mesh);
+		return;
+	}
+
+	auto it = m_sharedMeshes.find(hash->second);
+	if (--it->second.m_refCount > 0)
+	{
+		m_sharedStats.m_bytesSaved -= it->second.m_size;
+		return;
+	}
+
+	destroyMesh(mesh);
+	m_sharedMeshes.erase(it);
+	m_sharedMeshHashes.erase(hash);
+}
+
 AllocatedImage ResourceManager::createImage(VkExtent3D            size,
                                             VkFormat              format,
                                             VkImageUsageFlags     usage,
                                             bool                  mipmapped,
                                             VkSampleCountFlagBits numSamples)
+{
+	uint32_t mipLevels = mipmapped ? getMipLevelCount(size) : 1;
+
+	return allocateImage(size, format, usage, mipLevels, numSamples);
+}
+
+AllocatedImage ResourceManager::allocateImage(VkExtent3D            size,
+                                              VkFormat              format,
+                                              VkImageUsageFlags     usage,
+                                              uint32_t              mipLevels,
+                                              VkSampleCountFlagBits numSamples,
+                                              VkComponentMapping    components)
 {
 	AllocatedImage newImage;
 	newImage.m_imageFormat = format;
@@ -114,12 +485,7 @@ AllocatedImage ResourceManager::createImage(VkExtent3D            size,
 
 	VkImageCreateInfo img_info =
 	vkinit::imageCreateInfo(format, usage, size, 0, 1, numSamples);
-	if (mipmapped)
-	{
-		img_info.mipLevels = static_cast<uint32_t>(std::floor(
-		                     std::log2(std::max(size.width, size.height)))) +
-		                     1;
-	}
+	img_info.mipLevels = mipLevels;
 
 	// always allocate images on dedicated GPU memory
 	VmaAllocationCreateInfo allocinfo = {};
@@ -147,6 +513,7 @@ AllocatedImage ResourceManager::createImage(VkExtent3D            size,
 	VkImageViewCreateInfo view_info =
 	vkinit::imageViewCreateInfo(format, newImage.m_image, aspectFlag);
 	view_info.subresourceRange.levelCount = img_info.mipLevels;
+	view_info.components                  = components;
 
 	VK_CHECK(
 	vkCreateImageView(m_device, &view_info, nullptr, &newImage.m_imageView));
@@ -162,12 +529,47 @@ VkImageUsageFlags     usage,
 bool                  mipmapped,
 VkSampleCountFlagBits numSamples)
 {
-	size_t          data_size    = size.depth * size.width * size.height * 4;
-	AllocatedBuffer uploadbuffer = createBuffer(
-	data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	size_t            data_size = size.depth * size.width * size.height * 4;
+	StagingAllocation staging   = m_uploadQueue.allocateStaging(data_size);
+
+	memcpy(staging.m_data, data, data_size);
+
+	return createImage(staging, size, format, usage, mipmapped, numSamples);
+}
+
+std::optional<AllocatedImage> ResourceManager::loadImage(const char*       path,
+                                                         VkFormat          format,
+                                                         VkImageUsageFlags usage,
+                                                         bool              mipmapped)
+{
+	int width, height, channels;
+	if (!stbi_info(path, &width, &height, &channels))
+	{
+		return {};
+	}
 
-	memcpy(uploadbuffer.m_info.pMappedData, data, data_size);
+	// the staging memory is recycled with its batch even if decoding fails
+	const size_t      data_size = size_t(width) * height * 4;
+	StagingAllocation staging =
+	m_uploadQueue.allocateStaging(data_size + stbstaging::TARGET_SLACK);
+	if (!stbstaging::loadInto(
+	    path, staging.m_data, data_size + stbstaging::TARGET_SLACK, width, height))
+	{
+		m_uploadQueue.cancel(staging);
+		return {};
+	}
 
+	VkExtent3D size {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+	return createImage(staging, size, format, usage, mipmapped, VK_SAMPLE_COUNT_1_BIT);
+}
+
+AllocatedImage ResourceManager::createImage(const StagingAllocation& staging,
+                                            VkExtent3D               size,
+                                            VkFormat                 format,
+                                            VkImageUsageFlags        usage,
+                                            bool                     mipmapped,
+                                            VkSampleCountFlagBits    numSamples)
+{
 	AllocatedImage new_image = createImage(
 	size,
 	format,
@@ -175,51 +577,106 @@ VkSampleCountFlagBits numSamples)
 	mipmapped,
 	numSamples);
 
-	immediateSubmit(
-	[&](VkCommandBuffer cmd)
+	VkBufferImageCopy copyRegion = {};
+	copyRegion.bufferOffset      = staging.m_offset;
+	copyRegion.bufferRowLength   = 0;
+	copyRegion.bufferImageHeight = 0;
+
+	copyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	copyRegion.imageSubresource.mipLevel       = 0;
+	copyRegion.imageSubresource.baseArrayLayer = 0;
+	copyRegion.imageSubresource.layerCount     = 1;
+	copyRegion.imageExtent                     = size;
+
+	// the mips are blitted on the graphics queue once the base level is in
+	m_uploadQueue.copyImage(
+	staging,
+	new_image.m_image,
+	mipmapped ? getMipLevelCount(size) : 1,
+	std::span(&copyRegion, 1),
+	[image = new_image.m_image, extent = new_image.m_imageExtent, mipmapped](
+	VkCommandBuffer cmd)
 	{
-		vkutil::transitionImage(cmd,
-		                        new_image.m_image,
-		                        VK_IMAGE_LAYOUT_UNDEFINED,
-		                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-		VkBufferImageCopy copyRegion = {};
-		copyRegion.bufferOffset      = 0;
-		copyRegion.bufferRowLength   = 0;
-		copyRegion.bufferImageHeight = 0;
-
-		copyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-		copyRegion.imageSubresource.mipLevel       = 0;
-		copyRegion.imageSubresource.baseArrayLayer = 0;
-		copyRegion.imageSubresource.layerCount     = 1;
-		copyRegion.imageExtent                     = size;
-
-		// copy the buffer into the image
-		vkCmdCopyBufferToImage(cmd,
-		                       uploadbuffer.m_buffer,
-		                       new_image.m_image,
-		                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		                       1,
-		                       &copyRegion);
-
 		if (mipmapped)
 		{
 			vkutil::generateMipmaps(
-			cmd,
-			new_image.m_image,
-			VkExtent2D {new_image.m_imageExtent.width,
-			            new_image.m_imageExtent.height});
+			cmd, image, VkExtent2D {extent.width, extent.height});
 		}
 		else
 		{
 			vkutil::transitionImage(cmd,
-			                        new_image.m_image,
+			                        image,
 			                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 		}
 	});
 
-	destroyBuffer(uploadbuffer);
+	return new_image;
+}
+
+AllocatedImage ResourceManager::createImage(std::span<const ImageMipLevel> levels,
+                                            VkFormat                       format,
+                                            VkImageUsageFlags              usage,
+                                            VkComponentMapping             components)
+{
+	size_t data_size = 0;
+	for (const ImageMipLevel& level : levels)
+	{
+		data_size += level.m_texels.size();
+	}
+
+	StagingAllocation staging = m_uploadQueue.allocateStaging(data_size);
+
+	// pack every level into the staging memory, one copy region per level.
+	// Compressed levels are whole blocks, so every offset stays a multiple of
+	// the block size as the copy requires.
+	std::vector<VkBufferImageCopy> copyRegions;
+	copyRegions.reserve(levels.size());
+
+	size_t offset = 0;
+	for (uint32_t mip = 0; mip < levels.size(); mip++)
+	{
+		const ImageMipLevel& level = levels[mip];
+		memcpy((char*) staging.m_data + offset,
+		       level.m_texels.data(),
+		       level.m_texels.size());
+
+		VkBufferImageCopy copyRegion = {};
+		copyRegion.bufferOffset      = staging.m_offset + offset;
+		copyRegion.bufferRowLength   = 0;
+		copyRegion.bufferImageHeight = 0;
+
+		copyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.mipLevel       = mip;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount     = 1;
+		copyRegion.imageExtent                     = level.m_extent;
+		copyRegions.push_back(copyRegion);
+
+		offset += level.m_texels.size();
+	}
+
+	AllocatedImage new_image =
+	allocateImage(levels[0].m_extent,
+	              format,
+	              usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+	              static_cast<uint32_t>(levels.size()),
+	              VK_SAMPLE_COUNT_1_BIT,
+	              components);
+
+	// copy all levels in one go
+	m_uploadQueue.copyImage(staging,
+	                        new_image.m_image,
+	                        static_cast<uint32_t>(levels.size()),
+	                        copyRegions,
+	                        [image = new_image.m_image](VkCommandBuffer cmd)
+	                        {
+		                        vkutil::transitionImage(
+		                        cmd,
+		                        image,
+		                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	                        });
 
 	return new_image;
 }
@@ -230,13 +687,44 @@ void ResourceManager::destroyImage(const AllocatedImage& img)
 	vmaDestroyImage(m_allocator, img.m_image, img.m_allocation);
 }
 
+ResourceManager::ImmediateContext& ResourceManager::getImmediateContext()
+{
+	std::lock_guard lock(m_immMutex);
+
+	auto [it, inserted] = m_immContexts.try_emplace(std::this_thread::get_id());
+	ImmediateContext& context = it->second;
+	if (!inserted)
+	{
+		return context;
+	}
+
+	// command pools may only be used by one thread at a time
+	VkCommandPoolCreateInfo commandPoolInfo =
+	    vkinit::commandPoolCreateInfo(m_graphicsQueueFamily,
+	                                  VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VK_CHECK(vkCreateCommandPool(
+	    m_device, &commandPoolInfo, nullptr, &context.m_commandPool));
+
+	VkCommandBufferAllocateInfo cmdAllocInfo =
+	    vkinit::commandBufferAllocateInfo(context.m_commandPool, 1);
+	VK_CHECK(vkAllocateCommandBuffers(
+	    m_device, &cmdAllocInfo, &context.m_commandBuffer));
+
+	VkFenceCreateInfo fenceCreateInfo =
+	    vkinit::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+	VK_CHECK(vkCreateFence(m_device, &fenceCreateInfo, nullptr, &context.m_fence));
+
+	return context;
+}
+
 void ResourceManager::immediateSubmit(
     std::function<void(VkCommandBuffer cmd)>&& function)
 {
-	VK_CHECK(vkResetFences(m_device, 1, &m_immFence));
-	VK_CHECK(vkResetCommandBuffer(m_immCommandBuffer, 0));
+	ImmediateContext& context = getImmediateContext();
+	VK_CHECK(vkResetFences(m_device, 1, &context.m_fence));
+	VK_CHECK(vkResetCommandBuffer(context.m_commandBuffer, 0));
 
-	VkCommandBuffer cmd = m_immCommandBuffer;
+	VkCommandBuffer cmd = context.m_commandBuffer;
 
 	VkCommandBufferBeginInfo cmdBeginInfo =
 	    vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
@@ -247,87 +735,131 @@ void ResourceManager::immediateSubmit(
 
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
+	// the commands may touch resources that are still being uploaded
+	m_uploadQueue.flush();
+	VkSemaphoreSubmitInfo uploadWait =
+	m_uploadQueue.getWaitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
 	VkCommandBufferSubmitInfo cmdinfo = vkinit::commandBufferSubmitInfo(cmd);
-	VkSubmitInfo2 submit = vkinit::submitInfo(&cmdinfo, nullptr, nullptr);
+	VkSubmitInfo2 submit = vkinit::submitInfo(&cmdinfo, nullptr, &uploadWait);
 
 	// submit command buffer to the queue and execute it.
 	//  _renderFence will now block until the graphic commands finish execution
-	VK_CHECK(vkQueueSubmit2(m_graphicsQueue, 1, &submit, m_immFence));
+	{
+		auto queueLock = m_uploadQueue.lockQueues();
+		VK_CHECK(vkQueueSubmit2(m_graphicsQueue, 1, &submit, context.m_fence));
+	}
 
-	VK_CHECK(vkWaitForFences(m_device, 1, &m_immFence, true, 9999999999));
+	VK_CHECK(vkWaitForFences(m_device, 1, &context.m_fence, true, 9999999999));
 }
 
-// Note that this pattern is not very efficient, as we are waiting for the GPU
-// command to fully execute before continuing with our CPU side logic. This is
-// something people generally put on a background thread, whose sole job is to
-// execute uploads like this one, and deleting/reusing the staging buffers.
-GPUMeshBuffers ResourceManager::uploadMesh(std::span<uint32_t> indices,
-                                           std::span<Vertex>   vertices)
+GPUMeshBuffers ResourceManager::uploadMesh(std::span<const uint32_t>   indices,
+                                           std::span<const Vertex>     vertices,
+                                           std::span<const GPUMeshlet> meshlets,
+                                           HostMemoryImport*           source)
 {
-	const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-	const size_t indexBufferSize  = indices.size() * sizeof(uint32_t);
+	return uploadMeshData(indices,
+	                      vertices.size(),
+	                      std::as_bytes(vertices),
+	                      {},
+	                      std::as_bytes(meshlets),
+	                      source);
+}
 
-	GPUMeshBuffers newSurface;
+GPUMeshBuffers ResourceManager::uploadMesh(std::span<const uint32_t>     indices,
+                                           std::span<const PackedVertex> vertices,
+                                           std::span<const uint32_t>     colors,
+                                           glm::vec3 positionScale,
+                                           glm::vec3 positionOffset,
+                                           std::span<const GPUMeshlet> meshlets,
+                                           HostMemoryImport*           source)
+{
+	GPUMeshBuffers newSurface = uploadMeshData(indices,
+	                                           vertices.size(),
+	                                           std::as_bytes(vertices),
+	                                           std::as_bytes(colors),
+	                                           std::as_bytes(meshlets),
+	                                           source);
+	newSurface.m_vertexFormat   = VertexFormat::Packed;
+	newSurface.m_positionScale  = positionScale;
+	newSurface.m_positionOffset = positionOffset;
+	return newSurface;
+}
 
-	// create vertex buffer
-	newSurface.m_vertexBuffer = createBuffer(
-	vertexBufferSize,
-	VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-	VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-	VMA_MEMORY_USAGE_GPU_ONLY);
+// Every buffer is a range of the geometry arena. Data in imported host memory
+// is copied on the GPU. Elsewhere, where device local memory is host visible,
+// it is written straight into the arena.
+// Otherwise the copies are only queued: the buffers can be used by any
+// graphics submission that waits on the upload queue, the staging memory is
+// recycled once they completed.
+GPUMeshBuffers
+ResourceManager::uploadMeshData(std::span<const uint32_t>  indices,
+                                size_t                     vertexCount,
+                                std::span<const std::byte> vertexData,
+                                std::span<const std::byte> colorData,
+                                std::span<const std::byte> meshletData,
+                                HostMemoryImport*          source)
+{
+	// indices address the whole mesh, so its vertex count decides whether
+	// they fit in 16 bits. 0xFFFF is left out as it is the restart index.
+	const bool shortIndices = vertexCount < std::numeric_limits<uint16_t>::max();
 
-	// find the address of the vertex buffer
-	VkBufferDeviceAddressInfo deviceAdressInfo {
-	.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-	.buffer = newSurface.m_vertexBuffer.m_buffer};
-	newSurface.m_vertexBufferAddress =
-	vkGetBufferDeviceAddress(m_device, &deviceAdressInfo);
+	const size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+	const size_t indexBufferSize = indices.size() * indexSize;
 
-	// create index buffer
-	newSurface.m_indexBuffer = createBuffer(
-	indexBufferSize,
-	VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-	VMA_MEMORY_USAGE_GPU_ONLY);
+	GPUMeshBuffers newSurface;
+	newSurface.m_indexType =
+	shortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
-	AllocatedBuffer staging =
-	createBuffer(vertexBufferSize + indexBufferSize,
-	             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	             VMA_MEMORY_USAGE_CPU_ONLY);
+	// create vertex buffer
+	newSurface.m_vertexAllocation =
+	uploadGeometry(GeometryArena::Kind::Storage, vertexData, source);
+	newSurface.m_vertexBufferAddress =
+	m_geometryArena.getAddress(newSurface.m_vertexAllocation);
 
-	void* data = staging.m_info.pMappedData;
+	// create the color stream, only packed meshes with non white colors have one
+	if (!colorData.empty())
+	{
+		newSurface.m_colorAllocation =
+		uploadGeometry(GeometryArena::Kind::Storage, colorData, source);
+		newSurface.m_colorBufferAddress =
+		m_geometryArena.getAddress(newSurface.m_colorAllocation);
+	}
 
-	// copy vertex buffer
-	memcpy(data, vertices.data(), vertexBufferSize);
-	// copy index buffer
-	memcpy((char*) data + vertexBufferSize, indices.data(), indexBufferSize);
+	// create the meshlet buffer, read by the cluster culling pass
+	if (!meshletData.empty())
+	{
+		newSurface.m_meshletAllocation =
+		uploadGeometry(GeometryArena::Kind::Storage, meshletData, source);
+		newSurface.m_meshletBufferAddress =
+		m_geometryArena.getAddress(newSurface.m_meshletAllocation);
+	}
 
-	immediateSubmit(
-	[&](VkCommandBuffer cmd)
+	// create index buffer, 32 bit indices are used as they are and 16 bit
+	// ones are narrowed on the way in
+	if (!shortIndices)
 	{
-		VkBufferCopy vertexCopy {0};
-		vertexCopy.dstOffset = 0;
-		vertexCopy.srcOffset = 0;
-		vertexCopy.size      = vertexBufferSize;
-
-		vkCmdCopyBuffer(cmd,
-		                staging.m_buffer,
-		                newSurface.m_vertexBuffer.m_buffer,
-		                1,
-		                &vertexCopy);
-
-		VkBufferCopy indexCopy {0};
-		indexCopy.dstOffset = 0;
-		indexCopy.srcOffset = vertexBufferSize;
-		indexCopy.size      = indexBufferSize;
-
-		vkCmdCopyBuffer(cmd,
-		                staging.m_buffer,
-		                newSurface.m_indexBuffer.m_buffer,
-		                1,
-		                &indexCopy);
-	});
+		newSurface.m_indexAllocation = uploadGeometry(
+		GeometryArena::Kind::Index, std::as_bytes(indices), source);
+	}
+	else
+	{
+		newSurface.m_indexAllocation = uploadGeometry(
+		GeometryArena::Kind::Index,
+		indexBufferSize,
+		[&](void* data)
+		{
+			uint16_t* shortData = (uint16_t*) data;
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				shortData[i] = static_cast<uint16_t>(indices[i]);
+			}
+		});
+	}
 
-	destroyBuffer(staging);
+	// the arena aligns index ranges to 4 bytes, whole indices of either type
+	newSurface.m_firstIndex =
+	static_cast<uint32_t>(newSurface.m_indexAllocation.m_offset / indexSize);
 
 	return newSurface;
 }
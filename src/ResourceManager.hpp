@@ -1,30 +1,81 @@
 #pragma once
 
+#include <GeometryArena.hpp>
+#include <MappedFile.hpp>
 #include <Types.hpp>
+#include <UploadQueue.hpp>
 #include <deque>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
 
 struct DeletionQueue
 {
 	std::deque<std::function<void()>> deletors;
+	std::mutex                        mutex; // functions may be pushed from any thread
 
 	void push_function(std::function<void()>&& function)
 	{
+		std::lock_guard lock(mutex);
 		deletors.push_back(function);
 	}
 
 	void flush()
 	{
+		// taken out first, so the functions may push again
+		std::deque<std::function<void()>> functions;
+		{
+			std::lock_guard lock(mutex);
+			functions.swap(deletors);
+		}
+
 		// reverse iterate the deletion queue to execute all the functions
-		for (auto it = deletors.rbegin(); it != deletors.rend(); it++)
+		for (auto it = functions.rbegin(); it != functions.rend(); it++)
 		{
 			(*it)(); // call functors
 		}
+	}
+};
+
+// How well files share their images and meshes, see
+// ResourceManager::acquireImage
+struct SharedResourceStats
+{
+	uint64_t m_imageRequests {0};
+	uint64_t m_imageHits {0};
+	uint64_t m_meshRequests {0};
+	uint64_t m_meshHits {0};
+	size_t   m_bytesSaved {0}; // by the hits still in use
+};
+
+// A mapped file imported as host memory with VK_EXT_external_memory_host,
+// the GPU copies baked data out of it without going through staging. See
+// ResourceManager::importMappedFile.
+struct HostMemoryImport
+{
+	std::shared_ptr<const MappedFile> m_file; // kept mapped while imported
+	VkBuffer                          m_buffer {VK_NULL_HANDLE};
+	VkDeviceMemory                    m_memory {VK_NULL_HANDLE};
+
+	// the imported part of the mapping, offset 0 of m_buffer
+	const uint8_t* m_data {nullptr};
+	size_t         m_size {0};
 
-		deletors.clear();
+	size_t m_copiedBytes {0};
+
+	bool contains(std::span<const std::byte> bytes) const
+	{
+		const uint8_t* start = reinterpret_cast<const uint8_t*>(bytes.data());
+		return !bytes.empty() && start >= m_data &&
+		       start + bytes.size() <= m_data + m_size;
 	}
 };
 
+// Creation, upload and destruction of buffers, images and meshes may be
+// called from any thread once init returned; init and cleanup may not.
 class ResourceManager
 {
 public:
@@ -35,20 +86,39 @@ public:
 	ResourceManager& operator=(const ResourceManager& other) = delete;
 	ResourceManager& operator=(ResourceManager&& other)      = delete;
 
-	// Initialize the resource manager with Vulkan objects
-	void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, VkQueue graphicsQueue, uint32_t graphicsQueueFamily);
+	// Initialize the resource manager with Vulkan objects. Uploads go to the
+	// transfer queue, which may be the graphics queue itself.
+	// externalMemoryHost is set if VK_EXT_external_memory_host is enabled,
+	// textureCompressionBC if the textureCompressionBC feature is.
+	void init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, VkQueue graphicsQueue, uint32_t graphicsQueueFamily, VkQueue transferQueue, uint32_t transferQueueFamily, bool externalMemoryHost, bool textureCompressionBC);
 
 	// Cleanup all resources
 	void cleanup();
 
-	// Immediate submit for one-time GPU commands (uploads, transitions, etc.)
+	// Immediate submit for one-time GPU commands, waits for them and for the
+	// uploads queued before. Every thread records into a command pool of its
+	// own.
 	void immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function);
 
 	// Buffer management
-	AllocatedBuffer createBuffer(size_t             allocSize,
-	                              VkBufferUsageFlags usage,
-	                              VmaMemoryUsage     memoryUsage);
+	AllocatedBuffer createBuffer(size_t                   allocSize,
+	                              VkBufferUsageFlags       usage,
+	                              VmaMemoryUsage           memoryUsage,
+	                              VmaAllocationCreateFlags flags = 0);
+	// Buffer with initial data in device local memory, written like the
+	// buffers of uploadMesh
+	AllocatedBuffer createBuffer(std::span<const std::byte> data,
+	                              VkBufferUsageFlags         usage);
 	void            destroyBuffer(const AllocatedBuffer& buffer);
+	// buffer has to be created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+	VkDeviceAddress getBufferAddress(const AllocatedBuffer& buffer) const;
+
+	// Import a mapped file as host memory, so uploads of data inside it are
+	// copies on the GPU alone. Empty without VK_EXT_external_memory_host or
+	// if the driver can't import the mapping; uploads then use staging.
+	std::optional<HostMemoryImport> importMappedFile(std::shared_ptr<const MappedFile> file);
+	// Free the import once the copies queued from it completed
+	void releaseMappedFile(HostMemoryImport&& import);
 
 	// Image management (without initial data)
 	AllocatedImage createImage(VkExtent3D            size,
@@ -57,7 +127,8 @@ public:
 	                            bool                  mipmapped  = false,
 	                            VkSampleCountFlagBits numSamples = VK_SAMPLE_COUNT_1_BIT);
 
-	// Image management (with initial data)
+	// Image management (with initial data). The data is uploaded through the
+	// upload queue, so the image is ready once the queue's current batch is.
 	AllocatedImage createImage(void*                 data,
 	                            VkExtent3D            size,
 	                            VkFormat              format,
@@ -65,11 +136,73 @@ public:
 	                            bool                  mipmapped  = false,
 	                            VkSampleCountFlagBits numSamples = VK_SAMPLE_COUNT_1_BIT);
 
+	// Decode an image file as RGBA8 straight into staging memory and upload
+	// it like createImage above, without the texels passing through the
+	// heap first. Empty if the file can't be decoded.
+	std::optional<AllocatedImage> loadImage(const char*       path,
+	                                        VkFormat          format,
+	                                        VkImageUsageFlags usage,
+	                                        bool              mipmapped = false);
+
+	// Image management (with every mip level supplied by the caller, no mip
+	// generation on the GPU). Block compressed levels hold whole 4x4 blocks;
+	// components swizzles the image view.
+	AllocatedImage createImage(std::span<const ImageMipLevel> levels,
+	                            VkFormat                       format,
+	                            VkImageUsageFlags              usage,
+	                            VkComponentMapping             components = {});
+
+	// Destroys right away, nothing waits for frames in flight. Like
+	// destroyMesh and the release calls below, only call it once the GPU no
+	// longer reads the resource, e.g. after vkDeviceWaitIdle with the queues
+	// locked, see UploadQueue::lockQueues.
 	void destroyImage(const AllocatedImage& img);
 
-	// Mesh upload (creates vertex + index buffers and uploads data)
-	GPUMeshBuffers uploadMesh(std::span<uint32_t> indices,
-	                          std::span<Vertex>   vertices);
+	// Mesh upload (sub-allocates vertex + index buffers from the geometry
+	// arena and queues their data on the upload queue). Meshes with meshlets
+	// also get a meshlet buffer for GPU cluster culling. Indices are stored in
+	// 16 bits when every vertex can be addressed with them.
+	GPUMeshBuffers uploadMesh(std::span<const uint32_t>   indices,
+	                          std::span<const Vertex>     vertices,
+	                          std::span<const GPUMeshlet> meshlets = {},
+	                          HostMemoryImport*           source   = nullptr);
+
+	// Mesh upload for the packed vertex layout, with an optional RGBA8 color
+	// stream (empty if the mesh has no vertex colors)
+	GPUMeshBuffers uploadMesh(std::span<const uint32_t>     indices,
+	                          std::span<const PackedVertex> vertices,
+	                          std::span<const uint32_t>     colors,
+	                          glm::vec3                     positionScale,
+	                          glm::vec3                     positionOffset,
+	                          std::span<const GPUMeshlet>   meshlets = {},
+	                          HostMemoryImport*             source   = nullptr);
+
+	// Free the arena ranges of an uploaded mesh. The next upload may reuse
+	// them at once, so the device has to be idle like for destroyImage.
+	void destroyMesh(const GPUMeshBuffers& mesh);
+
+	// Content addressed sharing: returns the image made from data with the
+	// same hash while one is still alive, otherwise the one create makes.
+	// Every call holds a reference, dropped with releaseImage; the last one
+	// destroys the image. size is its data size, for the stats.
+	AllocatedImage acquireImage(uint64_t                               contentHash,
+	                            size_t                                 size,
+	                            const std::function<AllocatedImage()>& create);
+	// Images that were never shared are destroyed right away. The last
+	// release destroys immediately too, so releasing requires an idle device.
+	void releaseImage(const AllocatedImage& image);
+
+	// Same as acquireImage, for mesh buffers
+	GPUMeshBuffers acquireMesh(uint64_t                               contentHash,
+	                           size_t                                 size,
+	                           const std::function<GPUMeshBuffers()>& create);
+	void           releaseMesh(const GPUMeshBuffers& mesh);
+
+	SharedResourceStats getSharedResourceStats() const
+	{
+		std::lock_guard lock(m_sharedMutex);
+		return m_sharedStats;
+	}
 
 	// Accessors
 	VmaAllocator getAllocator() const
@@ -82,7 +215,68 @@ public:
 		return m_mainDeletionQueue;
 	}
 
+	UploadQueue& getUploadQueue()
+	{
+		return m_uploadQueue;
+	}
+
+	const GeometryArena& getGeometryArena() const
+	{
+		return m_geometryArena;
+	}
+
+	// Whether images can use BC formats, otherwise textures stay RGBA8
+	bool supportsBlockCompression() const
+	{
+		return m_textureCompressionBC;
+	}
+
 private:
+	GPUMeshBuffers uploadMeshData(std::span<const uint32_t>  indices,
+	                              size_t                     vertexCount,
+	                              std::span<const std::byte> vertexData,
+	                              std::span<const std::byte> colorData,
+	                              std::span<const std::byte> meshletData,
+	                              HostMemoryImport*          source);
+
+	// Create a buffer in device local memory and fill it with fillBuffer
+	AllocatedBuffer createDeviceBuffer(size_t                            size,
+	                                   VkBufferUsageFlags                usage,
+	                                   const std::function<void(void*)>& write);
+	// Fill size bytes at offset through write: straight into the buffer
+	// where its memory is host visible, otherwise into staging memory with a
+	// copy queued on the upload queue
+	void fillBuffer(const AllocatedBuffer&            buffer,
+	                VkDeviceSize                      offset,
+	                size_t                            size,
+	                const std::function<void(void*)>& write);
+
+	// Sub-allocate a range of the geometry arena and fill it like fillBuffer
+	GeometryAllocation uploadGeometry(GeometryArena::Kind               kind,
+	                                  size_t                            size,
+	                                  const std::function<void(void*)>& write);
+	// Same with a copy of data, done on the GPU if data lies in source
+	GeometryAllocation uploadGeometry(GeometryArena::Kind        kind,
+	                                  std::span<const std::byte> data,
+	                                  HostMemoryImport*          source);
+
+	// Create an RGBA8 image and queue the copy of its texels, already in
+	// staging memory
+	AllocatedImage createImage(const StagingAllocation& staging,
+	                           VkExtent3D               size,
+	                           VkFormat                 format,
+	                           VkImageUsageFlags        usage,
+	                           bool                     mipmapped,
+	                           VkSampleCountFlagBits    numSamples);
+
+	// Create an image and its view with an explicit number of mip levels
+	AllocatedImage allocateImage(VkExtent3D            size,
+	                             VkFormat              format,
+	                             VkImageUsageFlags     usage,
+	                             uint32_t              mipLevels,
+	                             VkSampleCountFlagBits numSamples,
+	                             VkComponentMapping    components = {});
+
 	VmaAllocator     m_allocator {VK_NULL_HANDLE};
 	VkDevice         m_device {VK_NULL_HANDLE};
 	VkInstance       m_instance {VK_NULL_HANDLE};
@@ -90,10 +284,44 @@ private:
 	VkQueue          m_graphicsQueue {VK_NULL_HANDLE};
 	uint32_t         m_graphicsQueueFamily {0};
 
-	// Immediate submit resources for one-time GPU commands
-	VkFence         m_immFence {VK_NULL_HANDLE};
-	VkCommandBuffer m_immCommandBuffer {VK_NULL_HANDLE};
-	VkCommandPool   m_immCommandPool {VK_NULL_HANDLE};
+	// Immediate submit resources of one thread, created on its first
+	// immediateSubmit
+	struct ImmediateContext
+	{
+		VkCommandPool   m_commandPool {VK_NULL_HANDLE};
+		VkCommandBuffer m_commandBuffer {VK_NULL_HANDLE};
+		VkFence         m_fence {VK_NULL_HANDLE};
+	};
+	ImmediateContext& getImmediateContext();
+
+	// nodes of the map don't move, so a context stays valid while others are
+	// added
+	std::mutex                                            m_immMutex;
+	std::unordered_map<std::thread::id, ImmediateContext> m_immContexts;
+
+	UploadQueue   m_uploadQueue;
+	GeometryArena m_geometryArena;
+
+	// 0 without VK_EXT_external_memory_host
+	VkDeviceSize m_hostPointerAlignment {0};
+	bool         m_textureCompressionBC {false};
+
+	template <typename T>
+	struct SharedResource
+	{
+		T        m_resource;
+		size_t   m_size;
+		uint32_t m_refCount;
+	};
+
+	// shared resources by content hash, and the hash by handle for release.
+	// Meshes are known by their vertex address, their buffers are shared.
+	std::unordered_map<uint64_t, SharedResource<AllocatedImage>> m_sharedImages;
+	std::unordered_map<VkImage, uint64_t>                        m_sharedImageHashes;
+	std::unordered_map<uint64_t, SharedResource<GPUMeshBuffers>> m_sharedMeshes;
+	std::unordered_map<VkDeviceAddress, uint64_t>                m_sharedMeshHashes;
+	SharedResourceStats                                          m_sharedStats;
+	mutable std::mutex                                           m_sharedMutex;
 
 	DeletionQueue m_mainDeletionQueue;
 };
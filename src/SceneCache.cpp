@@ -0,0 +1,528 @@
+#include <SceneCache.hpp>
+
+#include <TextureCompressor.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <type_traits>
+
+namespace
+{
+	constexpr char CACHE_MAGIC[8] = {'A', 'G', 'N', 'I', 'S', 'C', 'N', '\0'};
+	constexpr uint64_t BLOB_ALIGNMENT = 16;
+	constexpr uint8_t  IMAGE_MISSING  = 0;
+	constexpr uint8_t  IMAGE_PRESENT  = 1;
+
+	struct CacheHeader
+	{
+		char     m_magic[8];
+		uint32_t m_formatVersion;
+		uint32_t m_loaderVersion;
+		uint64_t m_sourceHash;
+		uint64_t m_sourceSize;
+	};
+
+	class CacheWriter
+	{
+	public:
+		explicit CacheWriter(std::ofstream& stream) : m_stream(stream) {}
+
+		template <typename T>
+		void write(const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			writeBytes(&value, sizeof(T));
+		}
+
+		void writeString(const std::string& value)
+		{
+			write(static_cast<uint32_t>(value.size()));
+			writeBytes(value.data(), value.size());
+		}
+
+		// size prefixed and aligned, so the reader can hand out spans
+		// straight into the mapped file
+		template <typename T>
+		void writeBlob(std::span<const T> data)
+		{
+			write(static_cast<uint64_t>(data.size_bytes()));
+
+			static const uint8_t padding[BLOB_ALIGNMENT] = {};
+			uint64_t             misalignment = m_offset % BLOB_ALIGNMENT;
+			if (misalignment != 0)
+			{
+				writeBytes(padding, BLOB_ALIGNMENT - misalignment);
+			}
+			writeBytes(data.data(), data.size_bytes());
+		}
+
+		bool good() const
+		{
+			return m_stream.good();
+		}
+
+	private:
+		void writeBytes(const void* data, size_t size)
+		{
+			m_stream.write(static_cast<const char*>(data), size);
+			m_offset += size;
+		}
+
+		std::ofstream& m_stream;
+		uint64_t       m_offset {0};
+	};
+
+	// Reads from the mapped cache. Any out of bounds access flags the reader
+	// as failed and returns zeroed data, so callers only check once per
+	// record instead of after every field.
+	class CacheReader
+	{
+	public:
+		explicit CacheReader(std::span<const uint8_t> data) : m_data(data) {}
+
+		template <typename T>
+		T read()
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			T value {};
+			if (require(sizeof(T)))
+			{
+				memcpy(&value, m_data.data() + m_offset, sizeof(T));
+				m_offset += sizeof(T);
+			}
+			return value;
+		}
+
+		// element counts can't exceed the remaining bytes, which keeps a
+		// corrupt count from triggering a huge allocation
+		uint32_t readCount()
+		{
+			uint32_t count = read<uint32_t>();
+			if (count > m_data.size() - m_offset)
+			{
+				m_failed = true;
+				return 0;
+			}
+			return count;
+		}
+
+		std::string readString()
+		{
+			uint32_t size = readCount();
+			if (!require(size))
+			{
+				return {};
+			}
+			std::string value(
+			reinterpret_cast<const char*>(m_data.data() + m_offset), size);
+			m_offset += size;
+			return value;
+		}
+
+		template <typename T>
+		std::span<const T> readBlob()
+		{
+			uint64_t size = read<uint64_t>();
+			m_offset      = (m_offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+			if (size % sizeof(T) != 0 || !require(size))
+			{
+				m_failed = true;
+				return {};
+			}
+			std::span<const T> blob(
+			reinterpret_cast<const T*>(m_data.data() + m_offset),
+			size / sizeof(T));
+			m_offset += size;
+			return blob;
+		}
+
+		bool failed() const
+		{
+			return m_failed;
+		}
+
+		bool atEnd() const
+		{
+			return m_offset == m_data.size();
+		}
+
+	private:
+		bool require(uint64_t size)
+		{
+			if (m_failed || m_offset > m_data.size() ||
+			    size > m_data.size() - m_offset)
+			{
+				m_failed = true;
+				return false;
+			}
+			return true;
+		}
+
+		std::span<const uint8_t> m_data;
+		size_t                   m_offset {0};
+		bool                     m_failed {false};
+	};
+
+	bool isValidTexture(const ImportedTexture& texture,
+	                    const ImportedScene&   scene)
+	{
+		return texture.m_imageIndex < (int32_t) scene.m_images.size() &&
+		       texture.m_samplerIndex < (int32_t) scene.m_samplers.size();
+	}
+
+	// cross references have to be in range before the loader follows them
+	bool validateScene(const ImportedScene& scene)
+	{
+		for (const ImportedMaterial& material : scene.m_materials)
+		{
+			if (!isValidTexture(material.m_colorTexture, scene) ||
+			    !isValidTexture(material.m_metalRoughTexture, scene) ||
+			    !isValidTexture(material.m_normalTexture, scene) ||
+			    !isValidTexture(material.m_occlusionTexture, scene))
+			{
+				return false;
+			}
+		}
+
+		for (size_t meshIndex = 0; meshIndex < scene.m_meshes.size(); meshIndex++)
+		{
+			const ImportedMesh& mesh = scene.m_meshes[meshIndex];
+			if (mesh.m_vertexFormat != VertexFormat::Full &&
+			    mesh.m_vertexFormat != VertexFormat::Packed)
+			{
+				return false;
+			}
+
+			bool validVertices =
+			mesh.m_vertexFormat == VertexFormat::Full
+			? mesh.m_packedVertices.empty() && mesh.m_colors.empty()
+			: mesh.m_vertices.empty() &&
+			  (mesh.m_colors.empty() ||
+			   mesh.m_colors.size() == mesh.m_packedVertices.size());
+			if (!validVertices)
+			{
+				return false;
+			}
+
+			for (const ImportedSurface& surface : mesh.m_surfaces)
+			{
+				// shared geometry comes from an owning surface of this or an
+				// earlier mesh
+				const ImportedMesh* geometryMesh = &mesh;
+				if (surface.m_sourceMesh >= 0 || surface.m_sourceSurface >= 0)
+				{
+					if (surface.m_sourceMesh < 0 ||
+					    surface.m_sourceMesh > (int64_t) meshIndex ||
+					    surface.m_sourceSurface < 0 ||
+					    surface.m_sourceSurface >=
+					    (int64_t) scene.m_meshes[surface.m_sourceMesh]
+					    .m_surfaces.size() ||
+					    scene.m_meshes[surface.m_sourceMesh]
+					    .m_surfaces[surface.m_sourceSurface]
+					    .m_sourceSurface >= 0)
+					{
+						return false;
+					}
+					geometryMesh = &scene.m_meshes[surface.m_sourceMesh];
+				}
+
+				if (surface.m_materialIndex >= scene.m_materials.size() ||
+				    uint64_t(surface.m_startIndex) + surface.m_count >
+				    geometryMesh->m_indices.size() ||
+				    uint64_t(surface.m_firstMeshlet) + surface.m_meshletCount >
+				    geometryMesh->m_meshlets.size())
+				{
+					return false;
+				}
+
+				if (surface.m_lodCount > MAX_SURFACE_LODS)
+				{
+					return false;
+				}
+				for (uint32_t l = 0; l < surface.m_lodCount; l++)
+				{
+					const SurfaceLod& lod = surface.m_lods[l];
+					if (uint64_t(lod.m_startIndex) + lod.m_count >
+					    geometryMesh->m_indices.size() ||
+					    uint64_t(lod.m_firstMeshlet) + lod.m_meshletCount >
+					    geometryMesh->m_meshlets.size())
+					{
+						return false;
+					}
+				}
+			}
+
+			for (const GPUMeshlet& meshlet : mesh.m_meshlets)
+			{
+				if (uint64_t(meshlet.m_firstIndex) + meshlet.m_indexCount >
+				    mesh.m_indices.size())
+				{
+					return false;
+				}
+			}
+		}
+
+		for (const ImportedNode& node : scene.m_nodes)
+		{
+			if (node.m_meshIndex >= (int32_t) scene.m_meshes.size())
+			{
+				return false;
+			}
+			for (uint32_t child : node.m_children)
+			{
+				if (child >= scene.m_nodes.size())
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+} // namespace
+
+std::filesystem::path
+scenecache::getCachePath(const std::filesystem::path& sourcePath)
+{
+	std::filesystem::path cachePath = sourcePath;
+	cachePath += ".agnicache";
+	return cachePath;
+}
+
+bool scenecache::read(const std::filesystem::path& cachePath,
+                      uint64_t                     sourceHash,
+                      uint64_t                     sourceSize,
+                      ImportedScene&               scene)
+{
+	MappedFile file;
+	if (!file.open(cachePath))
+	{
+		return false;
+	}
+
+	CacheReader reader(file.bytes());
+
+	CacheHeader header = reader.read<CacheHeader>();
+	if (reader.failed() ||
+	    memcmp(header.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+	    header.m_formatVersion != FORMAT_VERSION ||
+	    header.m_loaderVersion != LOADER_VERSION ||
+	    header.m_sourceHash != sourceHash || header.m_sourceSize != sourceSize)
+	{
+		return false;
+	}
+
+	ImportedScene cached;
+
+	cached.m_samplers.resize(reader.readCount());
+	for (ImportedSampler& sampler : cached.m_samplers)
+	{
+		sampler = reader.read<ImportedSampler>();
+	}
+
+	cached.m_images.resize(reader.readCount());
+	for (ImportedImage& image : cached.m_images)
+	{
+		image.m_name = reader.readString();
+		if (reader.read<uint8_t>() == IMAGE_MISSING)
+		{
+			continue;
+		}
+
+		DecodedImage& decoded = image.m_image.emplace();
+		decoded.m_format      = reader.read<VkFormat>();
+		decoded.m_components  = reader.read<VkComponentMapping>();
+		decoded.m_levels.resize(reader.readCount());
+		for (ImageMipLevel& level : decoded.m_levels)
+		{
+			level.m_extent.width  = reader.read<uint32_t>();
+			level.m_extent.height = reader.read<uint32_t>();
+			level.m_extent.depth  = 1;
+			level.m_texels        = reader.readBlob<uint8_t>();
+
+			// also rejects formats we don't know
+			const size_t expectedSize =
+			texcompress::getLevelSize(decoded.m_format, level.m_extent);
+			if (expectedSize == 0 || level.m_texels.size() != expectedSize)
+			{
+				return false;
+			}
+		}
+		if (decoded.m_levels.empty())
+		{
+			return false;
+		}
+	}
+
+	cached.m_materials.resize(reader.readCount());
+	for (ImportedMaterial& material : cached.m_materials)
+	{
+		material.m_name      = reader.readString();
+		material.m_constants = reader.read<GltfPbrMaterial::MaterialConstants>();
+		material.m_passType  = reader.read<MaterialPass>();
+		material.m_colorTexture      = reader.read<ImportedTexture>();
+		material.m_metalRoughTexture = reader.read<ImportedTexture>();
+		material.m_normalTexture     = reader.read<ImportedTexture>();
+		material.m_occlusionTexture  = reader.read<ImportedTexture>();
+	}
+
+	cached.m_meshes.resize(reader.readCount());
+	for (ImportedMesh& mesh : cached.m_meshes)
+	{
+		mesh.m_name = reader.readString();
+		mesh.m_surfaces.resize(reader.readCount());
+		for (ImportedSurface& surface : mesh.m_surfaces)
+		{
+			surface = reader.read<ImportedSurface>();
+		}
+		mesh.m_vertexFormat   = reader.read<VertexFormat>();
+		mesh.m_positionScale  = reader.read<glm::vec3>();
+		mesh.m_positionOffset = reader.read<glm::vec3>();
+		mesh.m_vertices       = reader.readBlob<Vertex>();
+		mesh.m_packedVertices = reader.readBlob<PackedVertex>();
+		mesh.m_colors         = reader.readBlob<uint32_t>();
+		mesh.m_indices        = reader.readBlob<uint32_t>();
+		mesh.m_meshlets       = reader.readBlob<GPUMeshlet>();
+	}
+
+	cached.m_nodes.resize(reader.readCount());
+	for (ImportedNode& node : cached.m_nodes)
+	{
+		node.m_name           = reader.readString();
+		node.m_meshIndex      = reader.read<int32_t>();
+		node.m_localTransform = reader.read<glm::mat4>();
+		node.m_children.resize(reader.readCount());
+		for (uint32_t& child : node.m_children)
+		{
+			child = reader.read<uint32_t>();
+		}
+		std::span<const glm::mat4> instances = reader.readBlob<glm::mat4>();
+		node.m_instances.assign(instances.begin(), instances.end());
+	}
+
+	if (reader.failed() || !reader.atEnd() || !validateScene(cached))
+	{
+		return false;
+	}
+
+	cached.m_cacheFile = std::make_shared<MappedFile>(std::move(file));
+	scene              = std::move(cached);
+	return true;
+}
+
+bool scenecache::write(const std::filesystem::path& cachePath,
+                       uint64_t                     sourceHash,
+                       uint64_t                     sourceSize,
+                       const ImportedScene&         scene)
+{
+	std::filesystem::path tempPath = cachePath;
+	tempPath += ".tmp";
+
+	bool written = false;
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			return false;
+		}
+
+		CacheWriter writer(stream);
+
+		CacheHeader header {};
+		memcpy(header.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.m_formatVersion = FORMAT_VERSION;
+		header.m_loaderVersion = LOADER_VERSION;
+		header.m_sourceHash    = sourceHash;
+		header.m_sourceSize    = sourceSize;
+		writer.write(header);
+
+		writer.write(static_cast<uint32_t>(scene.m_samplers.size()));
+		for (const ImportedSampler& sampler : scene.m_samplers)
+		{
+			writer.write(sampler);
+		}
+
+		writer.write(static_cast<uint32_t>(scene.m_images.size()));
+		for (const ImportedImage& image : scene.m_images)
+		{
+			writer.writeString(image.m_name);
+			if (!image.m_image.has_value())
+			{
+				writer.write(IMAGE_MISSING);
+				continue;
+			}
+
+			writer.write(IMAGE_PRESENT);
+			writer.write(image.m_image->m_format);
+			writer.write(image.m_image->m_components);
+			writer.write(static_cast<uint32_t>(image.m_image->m_levels.size()));
+			for (const ImageMipLevel& level : image.m_image->m_levels)
+			{
+				writer.write(level.m_extent.width);
+				writer.write(level.m_extent.height);
+				writer.writeBlob(level.m_texels);
+			}
+		}
+
+		writer.write(static_cast<uint32_t>(scene.m_materials.size()));
+		for (const ImportedMaterial& material : scene.m_materials)
+		{
+			writer.writeString(material.m_name);
+			writer.write(material.m_constants);
+			writer.write(material.m_passType);
+			writer.write(material.m_colorTexture);
+			writer.write(material.m_metalRoughTexture);
+			writer.write(material.m_normalTexture);
+			writer.write(material.m_occlusionTexture);
+		}
+
+		writer.write(static_cast<uint32_t>(scene.m_meshes.size()));
+		for (const ImportedMesh& mesh : scene.m_meshes)
+		{
+			writer.writeString(mesh.m_name);
+			writer.write(static_cast<uint32_t>(mesh.m_surfaces.size()));
+			for (const ImportedSurface& surface : mesh.m_surfaces)
+			{
+				writer.write(surface);
+			}
+			writer.write(mesh.m_vertexFormat);
+			writer.write(mesh.m_positionScale);
+			writer.write(mesh.m_positionOffset);
+			writer.writeBlob(mesh.m_vertices);
+			writer.writeBlob(mesh.m_packedVertices);
+			writer.writeBlob(mesh.m_colors);
+			writer.writeBlob(mesh.m_indices);
+			writer.writeBlob(mesh.m_meshlets);
+		}
+
+		writer.write(static_cast<uint32_t>(scene.m_nodes.size()));
+		for (const ImportedNode& node : scene.m_nodes)
+		{
+			writer.writeString(node.m_name);
+			writer.write(node.m_meshIndex);
+			writer.write(node.m_localTransform);
+			writer.write(static_cast<uint32_t>(node.m_children.size()));
+			for (uint32_t child : node.m_children)
+			{
+				writer.write(child);
+			}
+			writer.writeBlob(std::span<const glm::mat4>(node.m_instances));
+		}
+
+		stream.flush();
+		written = writer.good();
+	}
+
+	std::error_code error;
+	if (written)
+	{
+		std::filesystem::rename(tempPath, cachePath, error);
+	}
+	if (!written || error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <ImportedScene.hpp>
+
+#include <cstdint>
+#include <filesystem>
+
+// Baked binary form of an ImportedScene, stored next to the source .glb.
+// Vertex, index and texel blobs are aligned inside the file, so a cache hit
+// only maps the file and copies those blobs straight into staging buffers,
+// or has the GPU copy the geometry out of the mapping where it can be
+// imported; no glTF parsing, tangent generation or image decoding happens.
+namespace scenecache
+{
+	// Layout of the cache file itself
+	constexpr uint32_t FORMAT_VERSION = 7;
+
+	// Bump whenever the import step produces different data (vertex layout,
+	// tangent generation, mip filtering, ...), so old caches get rebuilt
+	constexpr uint32_t LOADER_VERSION = 8;
+
+	// Where the cache for a source file lives
+	std::filesystem::path getCachePath(const std::filesystem::path& sourcePath);
+
+	// Load a cache baked from a source with the given content hash and size.
+	// Import settings that change the output are folded into the hash.
+	// Returns false if there is no cache, it is stale or it is malformed; on
+	// success the scene's spans point into scene.m_cacheFile.
+	bool read(const std::filesystem::path& cachePath,
+	          uint64_t                     sourceHash,
+	          uint64_t                     sourceSize,
+	          ImportedScene&               scene);
+
+	// Bake an imported scene. Written to a temporary file first and renamed
+	// into place, so a crash never leaves a truncated cache behind.
+	bool write(const std::filesystem::path& cachePath,
+	           uint64_t                     sourceHash,
+	           uint64_t                     sourceSize,
+	           const ImportedScene&         scene);
+} // namespace scenecache
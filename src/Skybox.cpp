@@ -5,6 +5,7 @@
 #include <Pipelines.hpp>
 #include <ResourceManager.hpp>
 #include <Skybox.hpp>
+#include <StbStaging.hpp>
 #include <VulkanTools.hpp>
 
 #include <cmath>
@@ -130,8 +131,7 @@ void Skybox::cleanup(AgniEngine* engine)
 	clearPipelineResources(engine->m_device);
 
 	// Cleanup mesh buffers
-	engine->m_resourceManager.destroyBuffer(m_meshBuffers.m_indexBuffer);
-	engine->m_resourceManager.destroyBuffer(m_meshBuffers.m_vertexBuffer);
+	engine->m_resourceManager.destroyMesh(m_meshBuffers);
 
 	// Cleanup material
 	if (m_skyboxMaterial)
@@ -193,8 +193,10 @@ void Skybox::draw(VkCommandBuffer cmd,
 	                        nullptr);
 
 	// Bind index buffer
-	vkCmdBindIndexBuffer(
-	cmd, m_meshBuffers.m_indexBuffer.m_buffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(cmd,
+	                     m_meshBuffers.m_indexAllocation.m_buffer,
+	                     0,
+	                     m_meshBuffers.m_indexType);
 
 	// Push constants for vertex buffer address
 	SkyBoxPushConstants skyboxPush;
@@ -260,7 +262,7 @@ void Skybox::createCubeMesh(AgniEngine* engine)
 	m_meshBuffers =
 	engine->m_resourceManager.uploadMesh(cubeIndices, cubeVertices);
 	m_indexCount = static_cast<uint32_t>(cubeIndices.size());
-	m_firstIndex = 0;
+	m_firstIndex = m_meshBuffers.m_firstIndex;
 }
 
 void Skybox::createMaterial(AgniEngine* engine)
@@ -315,55 +317,40 @@ Skybox::createCubemap(ResourceManager&                  resourceManager,
                       VkImageUsageFlags                 usage,
                       bool                              mipmapped)
 {
-	// Load all 6 faces
-	std::array<stbi_uc*, 6> faceData;
-	int                     width, height, channels;
-
-	// Load first face to get dimensions
-	faceData[0] =
-	stbi_load(faceFiles[0].c_str(), &width, &height, &channels, 4);
-	if (!faceData[0])
+	// the faces are decoded straight into one staging allocation, the size
+	// of the first one sets the size of all
+	int width, height, channels;
+	if (!stbi_info(faceFiles[0].c_str(), &width, &height, &channels))
 	{
 		fmt::println("Failed to load cubemap face: {}", faceFiles[0]);
 		throw std::runtime_error("Failed to load cubemap face");
 	}
 
-	// Load remaining faces (ensure they match dimensions)
-	for (int i = 1; i < 6; i++)
+	size_t faceSize  = size_t(width) * height * 4; // 4 bytes per pixel (RGBA)
+	size_t totalSize = faceSize * 6;
+
+	UploadQueue&      uploads = resourceManager.getUploadQueue();
+	StagingAllocation staging =
+	uploads.allocateStaging(totalSize + stbstaging::TARGET_SLACK);
+
+	// faces are decoded in order, so one face's slack may overlap the next
+	for (int i = 0; i < 6; i++)
 	{
-		int w, h, c;
-		faceData[i] = stbi_load(faceFiles[i].c_str(), &w, &h, &c, 4);
-		if (!faceData[i] || w != width || h != height)
+		uint8_t* faceData = static_cast<uint8_t*>(staging.m_data) + i * faceSize;
+		if (!stbstaging::loadInto(faceFiles[i].c_str(),
+		                          faceData,
+		                          faceSize + stbstaging::TARGET_SLACK,
+		                          width,
+		                          height))
 		{
 			fmt::println(
 			"Failed to load or dimension mismatch for cubemap face: {}",
 			faceFiles[i]);
-			// Clean up loaded faces
-			for (int j = 0; j <= i; j++)
-			{
-				if (faceData[j])
-					stbi_image_free(faceData[j]);
-			}
+			uploads.cancel(staging);
 			throw std::runtime_error("Failed to load cubemap face");
 		}
 	}
 
-	// Calculate total size for all 6 faces
-	size_t faceSize  = width * height * 4; // 4 bytes per pixel (RGBA)
-	size_t totalSize = faceSize * 6;
-
-	// Create staging buffer
-	AllocatedBuffer uploadBuffer = resourceManager.createBuffer(
-	totalSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-	// Copy all faces into staging buffer
-	uint8_t* bufferData = (uint8_t*) uploadBuffer.m_info.pMappedData;
-	for (int i = 0; i < 6; i++)
-	{
-		memcpy(bufferData + (i * faceSize), faceData[i], faceSize);
-		stbi_image_free(faceData[i]);
-	}
-
 	// Create cubemap image
 	AllocatedImage cubemap;
 	cubemap.m_imageFormat = format;
@@ -408,23 +395,42 @@ Skybox::createCubemap(ResourceManager&                  resourceManager,
 	VK_CHECK(
 	vkCreateImageView(device, &view_info, nullptr, &cubemap.m_imageView));
 
-	// Upload data to GPU
-	resourceManager.immediateSubmit(
-	[&](VkCommandBuffer cmd)
+	// Copy each face from staging into its layer
+	std::array<VkBufferImageCopy, 6> copyRegions;
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		VkBufferImageCopy copyRegion               = {};
+		copyRegion.bufferOffset                    = staging.m_offset + face * faceSize;
+		copyRegion.bufferRowLength                 = 0;
+		copyRegion.bufferImageHeight               = 0;
+		copyRegion.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.mipLevel       = 0;
+		copyRegion.imageSubresource.baseArrayLayer = face;
+		copyRegion.imageSubresource.layerCount     = 1;
+		copyRegion.imageExtent = {(uint32_t) width, (uint32_t) height, 1};
+		copyRegions[face]      = copyRegion;
+	}
+
+	uploads.copyImage(
+	staging,
+	cubemap.m_image,
+	img_info.mipLevels,
+	copyRegions,
+	[image = cubemap.m_image, mipLevels = img_info.mipLevels](VkCommandBuffer cmd)
 	{
-		// Transition to transfer dst
+		// Transition to shader read
 		VkImageMemoryBarrier2 barrier {
 		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
-		barrier.srcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-		barrier.srcAccessMask = 0;
-		barrier.dstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-		barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-		barrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
-		barrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.image         = cubemap.m_image;
+		barrier.srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask  = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
+		barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.image         = image;
 		barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
 		barrier.subresourceRange.baseMipLevel   = 0;
-		barrier.subresourceRange.levelCount     = img_info.mipLevels;
+		barrier.subresourceRange.levelCount     = mipLevels;
 		barrier.subresourceRange.baseArrayLayer = 0;
 		barrier.subresourceRange.layerCount     = 6;
 
@@ -432,40 +438,8 @@ Skybox::createCubemap(ResourceManager&                  resourceManager,
 		depInfo.imageMemoryBarrierCount = 1;
 		depInfo.pImageMemoryBarriers    = &barrier;
 		vkCmdPipelineBarrier2(cmd, &depInfo);
-
-		// Copy each face from buffer to image
-		for (uint32_t face = 0; face < 6; face++)
-		{
-			VkBufferImageCopy copyRegion           = {};
-			copyRegion.bufferOffset                = face * faceSize;
-			copyRegion.bufferRowLength             = 0;
-			copyRegion.bufferImageHeight           = 0;
-			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.imageSubresource.mipLevel   = 0;
-			copyRegion.imageSubresource.baseArrayLayer = face;
-			copyRegion.imageSubresource.layerCount     = 1;
-			copyRegion.imageExtent = {(uint32_t) width, (uint32_t) height, 1};
-
-			vkCmdCopyBufferToImage(cmd,
-			                       uploadBuffer.m_buffer,
-			                       cubemap.m_image,
-			                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			                       1,
-			                       &copyRegion);
-		}
-
-		// Transition to shader read
-		barrier.srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
-		barrier.dstStageMask  = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-		barrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT;
-		barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		vkCmdPipelineBarrier2(cmd, &depInfo);
-	});
-
-	resourceManager.destroyBuffer(uploadBuffer);
+	},
+	6);
 
 	return cubemap;
 }
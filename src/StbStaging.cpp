@@ -0,0 +1,88 @@
+#include <StbStaging.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <stb_image.h>
+
+namespace
+{
+	struct DecodeTarget
+	{
+		void*  m_data {nullptr};
+		size_t m_minSize {0}; // texels of the decoded image
+		size_t m_capacity {0};
+		bool   m_taken {false};
+	};
+
+	thread_local DecodeTarget t_target;
+} // namespace
+
+void* stbstaging::allocate(size_t size)
+{
+	// the first allocation that fits the decoded image is the image, or an
+	// intermediate of the same size that is freed before the final one is
+	// made. Either way the target only ever holds one of them.
+	if (t_target.m_data != nullptr && !t_target.m_taken &&
+	    size >= t_target.m_minSize && size <= t_target.m_capacity)
+	{
+		t_target.m_taken = true;
+		return t_target.m_data;
+	}
+	return std::malloc(size);
+}
+
+void* stbstaging::reallocate(void* ptr, size_t oldSize, size_t newSize)
+{
+	if (ptr != nullptr && ptr == t_target.m_data)
+	{
+		// a buffer that keeps growing isn't the image, move it out
+		void* moved = std::malloc(newSize);
+		if (moved != nullptr)
+		{
+			memcpy(moved, ptr, std::min(oldSize, newSize));
+			t_target.m_taken = false;
+		}
+		return moved;
+	}
+	return std::realloc(ptr, newSize);
+}
+
+void stbstaging::release(void* ptr)
+{
+	if (ptr != nullptr && ptr == t_target.m_data)
+	{
+		t_target.m_taken = false;
+		return;
+	}
+	std::free(ptr);
+}
+
+bool stbstaging::loadInto(const char* path, void* target, size_t capacity, int width, int height)
+{
+	const size_t imageSize = size_t(width) * height * 4;
+	if (capacity < imageSize)
+	{
+		return false;
+	}
+
+	t_target = {target, imageSize, capacity, false};
+
+	int      w, h, channels;
+	stbi_uc* pixels = stbi_load(path, &w, &h, &channels, 4);
+
+	const bool decoded = pixels != nullptr && w == width && h == height;
+	if (pixels != nullptr && pixels != target)
+	{
+		// the image landed on the heap after all
+		if (decoded)
+		{
+			memcpy(target, pixels, imageSize);
+		}
+		stbi_image_free(pixels);
+	}
+
+	t_target = {};
+	return decoded;
+}
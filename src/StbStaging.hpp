@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// stb_image allocates through the hooks below (see Images.cpp). While a
+// decode target is set on the calling thread, the allocation stb makes for
+// the decoded RGBA8 image is placed in the target instead of on the heap, so
+// texels can be decoded straight into mapped staging memory.
+namespace stbstaging
+{
+	// Extra bytes a target needs past the texels; some decoders allocate
+	// their output a little larger than the image
+	constexpr size_t TARGET_SLACK = 16;
+
+	// Decode an image file as RGBA8 into target, which holds capacity bytes,
+	// at least width * height * 4 + TARGET_SLACK. width and height are what
+	// stbi_info reports for the file. Returns false if decoding failed or the
+	// image turned out to have another size. If the decoder ends up putting
+	// the image elsewhere it is copied into target.
+	bool loadInto(const char* path, void* target, size_t capacity, int width, int height);
+
+	// allocation hooks for stb_image
+	void* allocate(size_t size);
+	void* reallocate(void* ptr, size_t oldSize, size_t newSize);
+	void  release(void* ptr);
+} // namespace stbstaging
@@ -0,0 +1,509 @@
+#include <TextureCompressor.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// texels of one 4x4 block as floats, RGBA
+	using BlockTexels = float[16][4];
+
+	// BC7 mode 6 interpolation weights, in 64ths
+	constexpr uint32_t BC7_WEIGHTS[16] = {
+	0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+	// Writes little endian bit fields, as the BC7 layout is defined
+	struct BitWriter
+	{
+		uint8_t* m_out;
+		uint32_t m_position {0};
+
+		void write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t b = 0; b < bits; b++, m_position++)
+			{
+				if ((value >> b) & 1)
+				{
+					m_out[m_position / 8] |= uint8_t(1 << (m_position % 8));
+				}
+			}
+		}
+	};
+
+	// Texels of the block at (blockX, blockY). Blocks hanging over the edge
+	// of small levels repeat the last row and column.
+	void loadBlock(const ImageMipLevel& level,
+	               uint32_t             blockX,
+	               uint32_t             blockY,
+	               BlockTexels&         block)
+	{
+		const uint32_t width  = level.m_extent.width;
+		const uint32_t height = level.m_extent.height;
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				const uint32_t sx = std::min(blockX * 4 + x, width - 1);
+				const uint32_t sy = std::min(blockY * 4 + y, height - 1);
+				const uint8_t* texel =
+				level.m_texels.data() + (size_t(sy) * width + sx) * 4;
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					block[y * 4 + x][c] = texel[c];
+				}
+			}
+		}
+	}
+
+	// End points of the segment through the block's texels along their
+	// direction of largest variance, found by power iteration on the
+	// covariance of the first channels
+	void fitEndpoints(const BlockTexels& block,
+	                  uint32_t           channels,
+	                  float (&low)[4],
+	                  float (&high)[4])
+	{
+		float mean[4] = {};
+		for (const float* texel : block)
+		{
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				mean[c] += texel[c] / 16.f;
+			}
+		}
+
+		float covariance[4][4] = {};
+		for (const float* texel : block)
+		{
+			for (uint32_t i = 0; i < channels; i++)
+			{
+				for (uint32_t j = 0; j < channels; j++)
+				{
+					covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+				}
+			}
+		}
+
+		float axis[4] = {1.f, 1.f, 1.f, 1.f};
+		for (uint32_t iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float largest = 0.f;
+			for (uint32_t i = 0; i < channels; i++)
+			{
+				for (uint32_t j = 0; j < channels; j++)
+				{
+					next[i] += covariance[i][j] * axis[j];
+				}
+				largest = std::max(largest, std::abs(next[i]));
+			}
+			if (largest == 0.f)
+			{
+				break;
+			}
+			for (uint32_t i = 0; i < channels; i++)
+			{
+				axis[i] = next[i] / largest;
+			}
+		}
+
+		float length = 0.f;
+		for (uint32_t c = 0; c < channels; c++)
+		{
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+
+		float minProjection = 0.f;
+		float maxProjection = 0.f;
+		for (const float* texel : block)
+		{
+			float projection = 0.f;
+			for (uint32_t c = 0; c < channels; c++)
+			{
+				projection += (texel[c] - mean[c]) * axis[c] / length;
+			}
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			const float direction = c < channels ? axis[c] / length : 0.f;
+			low[c]  = std::clamp(mean[c] + direction * minProjection, 0.f, 255.f);
+			high[c] = std::clamp(mean[c] + direction * maxProjection, 0.f, 255.f);
+		}
+	}
+
+	template<uint32_t Channels>
+	uint32_t findNearest(const float* texel, const float (*palette)[4], uint32_t count)
+	{
+		uint32_t best      = 0;
+		float    bestError = INFINITY;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float error = 0.f;
+			for (uint32_t c = 0; c < Channels; c++)
+			{
+				const float d = texel[c] - palette[i][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best      = i;
+			}
+		}
+		return best;
+	}
+
+	uint16_t packRGB565(const float (&color)[4])
+	{
+		const uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.f / 255.f));
+		const uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.f / 255.f));
+		const uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.f / 255.f));
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpackRGB565(uint16_t packed, float (&color)[4])
+	{
+		const uint32_t r = (packed >> 11) & 31;
+		const uint32_t g = (packed >> 5) & 63;
+		const uint32_t b = packed & 31;
+		color[0]         = float((r << 3) | (r >> 2));
+		color[1]         = float((g << 2) | (g >> 4));
+		color[2]         = float((b << 3) | (b >> 2));
+		color[3]         = 255.f;
+	}
+
+	// 8 bytes: two RGB565 end points and 2 bit indices, always in the four
+	// color mode
+	void encodeBC1(const BlockTexels& block, uint8_t* out)
+	{
+		float low[4], high[4];
+		fitEndpoints(block, 3, low, high);
+
+		uint16_t color0 = packRGB565(high);
+		uint16_t color1 = packRGB565(low);
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		// equal end points select the three color mode, where index 0 is
+		// still color0
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			float palette[4][4];
+			unpackRGB565(color0, palette[0]);
+			unpackRGB565(color1, palette[1]);
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+				palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				indices |= findNearest<3>(block[i], palette, 4) << (i * 2);
+			}
+		}
+
+		memcpy(out, &color0, 2);
+		memcpy(out + 2, &color1, 2);
+		memcpy(out + 4, &indices, 4);
+	}
+
+	// 8 bytes: two 8 bit end points and 3 bit indices, in the eight value
+	// mode
+	void encodeBC4(const BlockTexels& block, uint32_t channel, uint8_t* out)
+	{
+		float low  = 255.f;
+		float high = 0.f;
+		for (const float* texel : block)
+		{
+			low  = std::min(low, texel[channel]);
+			high = std::max(high, texel[channel]);
+		}
+
+		const uint8_t value0 = static_cast<uint8_t>(std::lround(high));
+		const uint8_t value1 = static_cast<uint8_t>(std::lround(low));
+
+		// index 0 is value0, 1 is value1 and 2..7 step from value0 to value1
+		uint64_t indices = 0;
+		if (value0 > value1)
+		{
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const float t = (block[i][channel] - value1) / float(value0 - value1);
+				const long  step = std::clamp(std::lround(t * 7.f), 0l, 7l);
+				const uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+				indices |= index << (i * 3);
+			}
+		}
+
+		out[0] = value0;
+		out[1] = value1;
+		for (uint32_t b = 0; b < 6; b++)
+		{
+			out[2 + b] = static_cast<uint8_t>(indices >> (b * 8));
+		}
+	}
+
+	// RGBA7 end point with the p-bit that lands closest to the wanted value
+	struct Bc7Endpoint
+	{
+		uint32_t m_color[4];
+		uint32_t m_pbit;
+	};
+
+	Bc7Endpoint quantizeBc7Endpoint(const float (&value)[4])
+	{
+		Bc7Endpoint best {};
+		float       bestError = INFINITY;
+		for (uint32_t pbit = 0; pbit < 2; pbit++)
+		{
+			Bc7Endpoint endpoint {};
+			endpoint.m_pbit = pbit;
+			float error     = 0.f;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				endpoint.m_color[c] = static_cast<uint32_t>(
+				std::clamp(std::lround((value[c] - pbit) / 2.f), 0l, 127l));
+				const float d = float((endpoint.m_color[c] << 1) | pbit) - value[c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best      = endpoint;
+			}
+		}
+		return best;
+	}
+
+	// 16 bytes of BC7 mode 6: one subset, RGBA7 end points with a p-bit
+	// each and 4 bit indices
+	void encodeBC7(const BlockTexels& block, uint8_t* out)
+	{
+		float low[4], high[4];
+		fitEndpoints(block, 4, low, high);
+
+		Bc7Endpoint endpoints[2] = {quantizeBc7Endpoint(low),
+		                            quantizeBc7Endpoint(high)};
+
+		float palette[16][4];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				const uint32_t e0 =
+				(endpoints[0].m_color[c] << 1) | endpoints[0].m_pbit;
+				const uint32_t e1 =
+				(endpoints[1].m_color[c] << 1) | endpoints[1].m_pbit;
+				palette[i][c] = float(
+				((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6);
+			}
+		}
+
+		uint32_t indices[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			indices[i] = findNearest<4>(block[i], palette, 16);
+		}
+
+		// the first index is stored without its top bit, the weights are
+		// symmetric so swapping the end points flips every index
+		if (indices[0] >= 8)
+		{
+			std::swap(endpoints[0], endpoints[1]);
+			for (uint32_t& index : indices)
+			{
+				index = 15 - index;
+			}
+		}
+
+		memset(out, 0, 16);
+		BitWriter writer {out};
+		writer.write(1 << 6, 7); // mode 6
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.write(endpoints[0].m_color[c], 7);
+			writer.write(endpoints[1].m_color[c], 7);
+		}
+		writer.write(endpoints[0].m_pbit, 1);
+		writer.write(endpoints[1].m_pbit, 1);
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			writer.write(indices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	bool hasTranslucentTexels(const ImageMipLevel& level)
+	{
+		for (size_t i = 3; i < level.m_texels.size(); i += 4)
+		{
+			if (level.m_texels[i] != 255)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+} // namespace
+
+uint32_t texcompress::getBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return 8;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+size_t texcompress::getLevelSize(VkFormat format, VkExtent3D extent)
+{
+	if (format == VK_FORMAT_R8G8B8A8_UNORM)
+	{
+		return size_t(extent.width) * extent.height * 4;
+	}
+
+	const size_t blocksX = (extent.width + 3) / 4;
+	const size_t blocksY = (extent.height + 3) / 4;
+	return blocksX * blocksY * getBlockSize(format);
+}
+
+bool texcompress::compress(DecodedImage& image, uint32_t usage)
+{
+	enum class Encoder
+	{
+		BC1,
+		BC4,
+		BC5,
+		BC7
+	};
+
+	Encoder            encoder;
+	VkFormat           format;
+	VkComponentMapping components {};
+	// BC4 and BC5 store these channels of the source
+	uint32_t channel0 = 0;
+	uint32_t channel1 = 1;
+
+	if (usage == USAGE_COLOR)
+	{
+		const bool translucent = hasTranslucentTexels(image.m_levels[0]);
+		encoder = translucent ? Encoder::BC7 : Encoder::BC1;
+		format  = translucent ? VK_FORMAT_BC7_UNORM_BLOCK
+		                      : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+	}
+	else if (usage == USAGE_NORMAL)
+	{
+		// the shader rebuilds z from x and y
+		encoder = Encoder::BC5;
+		format  = VK_FORMAT_BC5_UNORM_BLOCK;
+	}
+	else if (usage == USAGE_METAL_ROUGH)
+	{
+		// roughness and metalness sit in green and blue, the view moves them
+		// back there
+		encoder    = Encoder::BC5;
+		format     = VK_FORMAT_BC5_UNORM_BLOCK;
+		channel0   = 1;
+		channel1   = 2;
+		components = {VK_COMPONENT_SWIZZLE_ONE,
+		              VK_COMPONENT_SWIZZLE_R,
+		              VK_COMPONENT_SWIZZLE_G,
+		              VK_COMPONENT_SWIZZLE_ONE};
+	}
+	else if (usage == USAGE_OCCLUSION)
+	{
+		encoder = Encoder::BC4;
+		format  = VK_FORMAT_BC4_UNORM_BLOCK;
+	}
+	else if (usage == (USAGE_METAL_ROUGH | USAGE_OCCLUSION))
+	{
+		encoder = Encoder::BC7;
+		format  = VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+	else
+	{
+		return false;
+	}
+
+	const uint32_t blockSize = getBlockSize(format);
+
+	size_t totalSize = 0;
+	for (const ImageMipLevel& level : image.m_levels)
+	{
+		totalSize += getLevelSize(format, level.m_extent);
+	}
+
+	std::vector<uint8_t>       blocks(totalSize);
+	std::vector<ImageMipLevel> levels;
+	levels.reserve(image.m_levels.size());
+
+	size_t offset = 0;
+	for (const ImageMipLevel& level : image.m_levels)
+	{
+		const uint32_t blocksX = (level.m_extent.width + 3) / 4;
+		const uint32_t blocksY = (level.m_extent.height + 3) / 4;
+
+		uint8_t* out = blocks.data() + offset;
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++, out += blockSize)
+			{
+				BlockTexels block;
+				loadBlock(level, bx, by, block);
+				switch (encoder)
+				{
+					case Encoder::BC1:
+						encodeBC1(block, out);
+						break;
+					case Encoder::BC4:
+						encodeBC4(block, channel0, out);
+						break;
+					case Encoder::BC5:
+						encodeBC4(block, channel0, out);
+						encodeBC4(block, channel1, out + 8);
+						break;
+					case Encoder::BC7:
+						encodeBC7(block, out);
+						break;
+				}
+			}
+		}
+
+		const size_t levelSize = getLevelSize(format, level.m_extent);
+		levels.push_back({{blocks.data() + offset, levelSize}, level.m_extent});
+		offset += levelSize;
+	}
+
+	// the RGBA8 texels are no longer needed
+	image.m_blocks     = std::move(blocks);
+	image.m_levels     = std::move(levels);
+	image.m_format     = format;
+	image.m_components = components;
+	image.m_pixels.reset();
+	std::vector<uint8_t>().swap(image.m_mipTexels);
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <ImportedScene.hpp>
+
+#include <cstdint>
+#include <span>
+
+// CPU encoders for the BC block formats, used to shrink imported textures to
+// a quarter or an eighth of their RGBA8 size. Quality is that of a fast
+// principal axis fit, not of an offline compressor.
+namespace texcompress
+{
+	// How the materials of a scene sample an image, a mask of these
+	enum TextureUsage : uint32_t
+	{
+		USAGE_COLOR       = 1 << 0,
+		USAGE_METAL_ROUGH = 1 << 1,
+		USAGE_NORMAL      = 1 << 2,
+		USAGE_OCCLUSION   = 1 << 3,
+	};
+
+	// Bytes per 4x4 block of a BC format, 0 for any other format
+	uint32_t getBlockSize(VkFormat format);
+
+	// Bytes of one level of an image, 0 for formats we can't load
+	size_t getLevelSize(VkFormat format, VkExtent3D extent);
+
+	// Encode every level of an RGBA8 image into the block format that suits
+	// its usage: BC1 or BC7 for color, BC5 for normals and metal-rough, BC4
+	// for occlusion and BC7 for packed occlusion-metal-rough. The RGBA8
+	// texels are released. Images used in ways no single format serves are
+	// left untouched, returns false for those.
+	bool compress(DecodedImage& image, uint32_t usage);
+} // namespace texcompress
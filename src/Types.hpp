@@ -28,6 +28,13 @@ struct AllocatedImage
 	VkFormat      m_imageFormat;
 };
 
+// CPU side texels of a single mip level, tightly packed
+struct ImageMipLevel
+{
+	std::span<const uint8_t> m_texels;
+	VkExtent3D               m_extent;
+};
+
 struct AllocatedBuffer
 {
 	VkBuffer          m_buffer;
@@ -46,13 +53,79 @@ struct Vertex
 	glm::vec4 m_tangent;
 };
 
-// holds the resources needed for a mesh
+// layout of the vertices a mesh stores on the GPU
+enum class VertexFormat : uint32_t
+{
+	Full   = 0, // Vertex
+	Packed = 1  // PackedVertex
+};
+
+// 20 byte alternative to Vertex. Positions are unorm16 inside the mesh's
+// bounding box (dequantized with GPUMeshBuffers::m_positionScale/Offset),
+// normal and tangent are octahedral snorm16x2 and uvs are half floats.
+// Vertex colors live in an optional separate RGBA8 stream.
+struct PackedVertex
+{
+	uint32_t m_positionXY; // unorm16 x | unorm16 y << 16
+	uint32_t m_positionZ;  // unorm16 z | tangent handedness (1 = -1) << 16
+	uint32_t m_normal;     // octahedral snorm16x2
+	uint32_t m_tangent;    // octahedral snorm16x2
+	uint32_t m_uv;         // half2
+};
+static_assert(sizeof(PackedVertex) == 20);
+
+// A small cluster of a mesh's triangles, culled on its own by the GPU.
+// Meshlets cover a contiguous range of the mesh's index buffer.
+struct GPUMeshlet
+{
+	glm::vec3 m_center; // bounding sphere, mesh space
+	float     m_radius;
+	glm::vec3 m_coneAxis; // average facing of the triangles
+	float     m_coneCutoff; // cos of the cone spread, > 1 never culls
+	uint32_t  m_firstIndex;
+	uint32_t  m_indexCount;
+	uint32_t  m_pad0;
+	uint32_t  m_pad1;
+};
+static_assert(sizeof(GPUMeshlet) == 48);
+
+// range of a GeometryArena page
+struct GeometryAllocation
+{
+	VkBuffer             m_buffer {VK_NULL_HANDLE};
+	VkDeviceSize         m_offset {0};
+	VmaVirtualAllocation m_allocation {VK_NULL_HANDLE};
+	uint32_t             m_page {0};
+};
+
+// holds the resources needed for a mesh, all of them ranges of the geometry
+// arena
 struct GPUMeshBuffers
 {
 
-	AllocatedBuffer m_indexBuffer;
-	AllocatedBuffer m_vertexBuffer;
-	VkDeviceAddress m_vertexBufferAddress;
+	GeometryAllocation m_indexAllocation;
+	GeometryAllocation m_vertexAllocation;
+	VkDeviceAddress    m_vertexBufferAddress {0};
+
+	// meshes with few enough vertices store 16 bit indices. Index buffers
+	// are shared, the mesh's own start at m_firstIndex.
+	VkIndexType m_indexType {VK_INDEX_TYPE_UINT32};
+	uint32_t    m_firstIndex {0};
+
+	VertexFormat m_vertexFormat {VertexFormat::Full};
+
+	// optional RGBA8 color per vertex, packed meshes only
+	GeometryAllocation m_colorAllocation {};
+	VkDeviceAddress    m_colorBufferAddress {0};
+
+	// dequantization of packed positions: position = offset + q * scale
+	glm::vec3 m_positionScale {1.f};
+	glm::vec3 m_positionOffset {0.f};
+
+	// meshlets of every surface, read by the cluster culling pass. Their
+	// index ranges start at m_firstIndex too.
+	GeometryAllocation m_meshletAllocation {};
+	VkDeviceAddress    m_meshletBufferAddress {0};
 };
 
 // bounding volume for frustum culling
@@ -63,12 +136,35 @@ struct Bounds
 	glm::vec3 m_extents;
 };
 
+// simplified versions of a surface kept next to the full one
+constexpr uint32_t MAX_SURFACE_LODS = 4;
+
+// a simplified surface, drawn from its own index and meshlet ranges in the
+// buffers of the full one
+struct SurfaceLod
+{
+	uint32_t m_startIndex;
+	uint32_t m_count;
+	uint32_t m_firstMeshlet;
+	uint32_t m_meshletCount;
+	float    m_error; // largest deviation from the full surface, mesh space
+};
+
 // push constants for our mesh object draws
 struct GPUDrawPushConstants
 {
 	glm::mat4       m_worldMatrix;
 	VkDeviceAddress m_vertexBuffer;
+	VkDeviceAddress m_colorBuffer; // 0 if the mesh has no color stream
+	glm::vec3       m_positionOffset;
+	VertexFormat    m_vertexFormat;
+	glm::vec3       m_positionScale;
+	// instance transforms and the visible ones to draw, 0 if not instanced
+	VkDeviceAddress m_instanceBuffer;
+	VkDeviceAddress m_visibleInstances;
 };
+// 128 bytes is the smallest push constant size every device supports
+static_assert(sizeof(GPUDrawPushConstants) <= 128);
 
 struct GPUSceneData
 {
@@ -0,0 +1,588 @@
+#include <UploadQueue.hpp>
+
+#include <Images.hpp>
+#include <Initializers.hpp>
+#include <VulkanTools.hpp>
+
+#include <algorithm>
+
+void UploadQueue::init(VkDevice     device,
+                       VmaAllocator allocator,
+                       VkQueue      graphicsQueue,
+                       uint32_t     graphicsQueueFamily,
+                       VkQueue      transferQueue,
+                       uint32_t     transferQueueFamily)
+{
+	m_device              = device;
+	m_allocator           = allocator;
+	m_graphicsQueue       = graphicsQueue;
+	m_graphicsQueueFamily = graphicsQueueFamily;
+	m_transferQueue       = transferQueue;
+	m_transferQueueFamily = transferQueueFamily;
+
+	VkSemaphoreTypeCreateInfo timelineInfo {
+	.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+	.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+	.initialValue  = 0};
+	VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphoreCreateInfo();
+	semaphoreInfo.pNext                 = &timelineInfo;
+	VK_CHECK(vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_timeline));
+	if (hasTransferQueue())
+	{
+		VK_CHECK(vkCreateSemaphore(
+		m_device, &semaphoreInfo, nullptr, &m_transferTimeline));
+	}
+
+	for (Batch& batch : m_batches)
+	{
+		VkCommandPoolCreateInfo poolInfo =
+		vkinit::commandPoolCreateInfo(m_transferQueueFamily);
+		VK_CHECK(
+		vkCreateCommandPool(m_device, &poolInfo, nullptr, &batch.m_transferPool));
+
+		VkCommandBufferAllocateInfo cmdAllocInfo =
+		vkinit::commandBufferAllocateInfo(batch.m_transferPool, 1);
+		VK_CHECK(
+		vkAllocateCommandBuffers(m_device, &cmdAllocInfo, &batch.m_transferCmd));
+
+		// with a single family everything is recorded into one command buffer
+		if (!hasTransferQueue())
+		{
+			batch.m_graphicsCmd = batch.m_transferCmd;
+			continue;
+		}
+
+		poolInfo = vkinit::commandPoolCreateInfo(m_graphicsQueueFamily);
+		VK_CHECK(
+		vkCreateCommandPool(m_device, &poolInfo, nullptr, &batch.m_graphicsPool));
+
+		cmdAllocInfo = vkinit::commandBufferAllocateInfo(batch.m_graphicsPool, 1);
+		VK_CHECK(
+		vkAllocateCommandBuffers(m_device, &cmdAllocInfo, &batch.m_graphicsCmd));
+	}
+
+	// one persistently mapped buffer for the staging of every upload
+	VkBufferCreateInfo ringInfo = {.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+	ringInfo.size               = STAGING_RING_SIZE;
+	ringInfo.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	// images are decoded straight into the ring and the decoders read back
+	// what they wrote, so ask for cached memory rather than write combined.
+	// The ring is never flushed, keep it coherent.
+	VmaAllocationCreateInfo ringAllocInfo = {};
+	ringAllocInfo.usage                   = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+	ringAllocInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+	                      VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	ringAllocInfo.requiredFlags =
+	VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VK_CHECK(vmaCreateBuffer(m_allocator,
+	                         &ringInfo,
+	                         &ringAllocInfo,
+	                         &m_stagingRing.m_buffer,
+	                         &m_stagingRing.m_allocation,
+	                         &m_stagingRing.m_info));
+	m_stagingStats.m_ringSize = STAGING_RING_SIZE;
+
+	fmt::print("Uploads run on {}\n",
+	           hasTransferQueue() ? "a dedicated transfer queue"
+	                              : "the graphics queue");
+}
+
+void UploadQueue::cleanup()
+{
+	if (m_device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// anything still recording was never needed by a frame
+	wait(flush());
+
+	for (Batch& batch : m_batches)
+	{
+		releaseBatch(batch);
+		vkDestroyCommandPool(m_device, batch.m_transferPool, nullptr);
+		if (batch.m_graphicsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyCommandPool(m_device, batch.m_graphicsPool, nullptr);
+		}
+	}
+	vmaDestroyBuffer(m_allocator, m_stagingRing.m_buffer, m_stagingRing.m_allocation);
+	vkDestroySemaphore(m_device, m_timeline, nullptr);
+	if (m_transferTimeline != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(m_device, m_transferTimeline, nullptr);
+	}
+	m_device = VK_NULL_HANDLE;
+}
+
+UploadQueue::Batch& UploadQueue::getOpenBatch(std::unique_lock<std::mutex>& lock)
+{
+	for (;;)
+	{
+		m_batchChanged.wait(lock, [this] {
+			return !m_recording || !m_batches[m_currentBatch].m_closing;
+		});
+
+		Batch& batch = m_batches[m_currentBatch];
+		if (m_recording)
+		{
+			return batch;
+		}
+
+		const uint64_t completion = batch.m_completionValue;
+		if (getCompletedValue() >= completion)
+		{
+			break;
+		}
+
+		// only when every batch is still in flight. Another thread may have
+		// started the batch by the time the lock is back.
+		lock.unlock();
+		wait({completion});
+		lock.lock();
+	}
+
+	Batch& batch = m_batches[m_currentBatch];
+	releaseBatch(batch);
+
+	VK_CHECK(vkResetCommandPool(m_device, batch.m_transferPool, 0));
+	if (batch.m_graphicsPool != VK_NULL_HANDLE)
+	{
+		VK_CHECK(vkResetCommandPool(m_device, batch.m_graphicsPool, 0));
+	}
+
+	VkCommandBufferBeginInfo beginInfo =
+	vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(batch.m_transferCmd, &beginInfo));
+
+	m_recording = true;
+	return batch;
+}
+
+void UploadQueue::releaseBatch(Batch& batch)
+{
+	for (const AllocatedBuffer& staging : batch.m_staging)
+	{
+		vmaDestroyBuffer(m_allocator, staging.m_buffer, staging.m_allocation);
+	}
+	batch.m_staging.clear();
+	batch.m_stagingSize = 0;
+	batch.m_bufferBarriers.clear();
+	batch.m_imageBarriers.clear();
+	batch.m_graphicsWork.clear();
+	for (const std::function<void()>& release : batch.m_releases)
+	{
+		release();
+	}
+	batch.m_releases.clear();
+
+	// batches complete in order, so everything up to here is free again
+	m_ringTail                = std::max(m_ringTail, batch.m_ringEnd);
+	batch.m_ringEnd           = 0;
+	m_stagingStats.m_ringUsed = m_ringHead - m_ringTail;
+}
+
+void UploadQueue::unpin(uint32_t batch)
+{
+	if (--m_batches[batch].m_pins == 0)
+	{
+		m_batchChanged.notify_all();
+	}
+}
+
+void UploadQueue::cancel(const StagingAllocation& staging)
+{
+	std::lock_guard lock(m_mutex);
+	unpin(staging.m_batch);
+}
+
+void UploadQueue::copyBuffer(const StagingAllocation& staging,
+                             VkBuffer                 destination,
+                             const VkBufferCopy&      region)
+{
+	// the pin keeps the batch open, even while another thread flushes it
+	std::lock_guard lock(m_mutex);
+	recordBufferCopy(m_batches[staging.m_batch], staging.m_buffer, destination, region);
+	unpin(staging.m_batch);
+}
+
+void UploadQueue::copyBuffer(VkBuffer source, VkBuffer destination, const VkBufferCopy& region)
+{
+	std::unique_lock lock(m_mutex);
+	recordBufferCopy(getOpenBatch(lock), source, destination, region);
+}
+
+void UploadQueue::recordBufferCopy(Batch&              batch,
+                                   VkBuffer            source,
+                                   VkBuffer            destination,
+                                   const VkBufferCopy& region)
+{
+	vkCmdCopyBuffer(batch.m_transferCmd, source, destination, 1, &region);
+
+	if (hasTransferQueue())
+	{
+		VkBufferMemoryBarrier2 barrier {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+		barrier.srcStageMask        = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = m_transferQueueFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsQueueFamily;
+		barrier.buffer              = destination;
+		barrier.offset              = region.dstOffset;
+		barrier.size                = region.size;
+		batch.m_bufferBarriers.push_back(barrier);
+	}
+}
+
+void UploadQueue::copyImage(const StagingAllocation&                  staging,
+                            VkImage                                   image,
+                            uint32_t                                  mipLevels,
+                            std::span<const VkBufferImageCopy>        regions,
+                            std::function<void(VkCommandBuffer cmd)>&& finish,
+                            uint32_t                                  layerCount)
+{
+	std::lock_guard lock(m_mutex);
+	Batch&          batch = m_batches[staging.m_batch];
+
+	VkImageSubresourceRange range {};
+	range.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel   = 0;
+	range.levelCount     = mipLevels;
+	range.baseArrayLayer = 0;
+	range.layerCount     = layerCount;
+
+	VkImageMemoryBarrier2 toTransfer {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+	toTransfer.srcStageMask     = VK_PIPELINE_STAGE_2_NONE;
+	toTransfer.dstStageMask     = VK_PIPELINE_STAGE_2_COPY_BIT;
+	toTransfer.dstAccessMask    = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	toTransfer.oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransfer.newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransfer.image            = image;
+	toTransfer.subresourceRange = range;
+
+	VkDependencyInfo depInfo {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+	depInfo.imageMemoryBarrierCount = 1;
+	depInfo.pImageMemoryBarriers    = &toTransfer;
+	vkCmdPipelineBarrier2(batch.m_transferCmd, &depInfo);
+
+	vkCmdCopyBufferToImage(batch.m_transferCmd,
+	                       staging.m_buffer,
+	                       image,
+	                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                       static_cast<uint32_t>(regions.size()),
+	                       regions.data());
+
+	if (hasTransferQueue())
+	{
+		// the layout stays, the graphics queue moves on from TRANSFER_DST
+		VkImageMemoryBarrier2 barrier {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+		barrier.srcStageMask        = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = m_transferQueueFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsQueueFamily;
+		barrier.image               = image;
+		barrier.subresourceRange    = range;
+		batch.m_imageBarriers.push_back(barrier);
+	}
+
+	batch.m_graphicsWork.push_back(std::move(finish));
+	unpin(staging.m_batch);
+}
+
+StagingAllocation UploadQueue::allocateStaging(size_t size, size_t alignment)
+{
+	std::unique_lock lock(m_mutex);
+
+	// anything that waits lets other threads allocate, so the batch and the
+	// ring are looked at again afterwards
+	for (;;)
+	{
+		Batch& batch = getOpenBatch(lock);
+		if (batch.m_stagingSize >= MAX_BATCH_STAGING_SIZE && batch.m_pins == 0)
+		{
+			// earlier allocations have their copies queued, so the batch can go
+			flush(lock);
+			continue;
+		}
+
+		if (size > MAX_RING_ALLOCATION)
+		{
+			VkBufferCreateInfo bufferInfo = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+			bufferInfo.size  = size;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+			VmaAllocationCreateInfo allocInfo = {};
+			allocInfo.usage                   = VMA_MEMORY_USAGE_CPU_ONLY;
+			allocInfo.flags                   = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+			AllocatedBuffer staging;
+			VK_CHECK(vmaCreateBuffer(m_allocator,
+			                         &bufferInfo,
+			                         &allocInfo,
+			                         &staging.m_buffer,
+			                         &staging.m_allocation,
+			                         &staging.m_info));
+
+			batch.m_staging.push_back(staging);
+			batch.m_stagingSize += size;
+			batch.m_pins++;
+			m_stagingStats.m_dedicatedAllocations++;
+			return {staging.m_buffer, 0, staging.m_info.pMappedData, m_currentBatch};
+		}
+
+		// allocations never wrap around the end of the buffer
+		uint64_t start = (m_ringHead + alignment - 1) / alignment * alignment;
+		if (start % STAGING_RING_SIZE + size > STAGING_RING_SIZE)
+		{
+			start = (start / STAGING_RING_SIZE + 1) * STAGING_RING_SIZE;
+		}
+
+		if (start + size - m_ringTail > STAGING_RING_SIZE)
+		{
+			reclaimRing(lock, start + size);
+			continue;
+		}
+
+		m_ringHead      = start + size;
+		batch.m_ringEnd = m_ringHead;
+		batch.m_stagingSize += size;
+		batch.m_pins++;
+
+		m_stagingStats.m_ringAllocations++;
+		m_stagingStats.m_ringUsed     = m_ringHead - m_ringTail;
+		m_stagingStats.m_peakRingUsed =
+		std::max(m_stagingStats.m_peakRingUsed, m_stagingStats.m_ringUsed);
+
+		const VkDeviceSize offset = start % STAGING_RING_SIZE;
+		return {m_stagingRing.m_buffer,
+		        offset,
+		        static_cast<char*>(m_stagingRing.m_info.pMappedData) + offset,
+		        m_currentBatch};
+	}
+}
+
+void UploadQueue::reclaimRing(std::unique_lock<std::mutex>& lock, uint64_t end)
+{
+	m_stagingStats.m_stalls++;
+
+	// the open batch may hold the space itself
+	if (m_recording && m_batches[m_currentBatch].m_ringEnd > m_ringTail)
+	{
+		flush(lock);
+	}
+
+	while (end - m_ringTail > STAGING_RING_SIZE)
+	{
+		// oldest batch still holding ring space
+		Batch* oldest = nullptr;
+		for (Batch& batch : m_batches)
+		{
+			if (batch.m_ringEnd > m_ringTail &&
+			    (oldest == nullptr ||
+			     batch.m_completionValue < oldest->m_completionValue))
+			{
+				oldest = &batch;
+			}
+		}
+		if (oldest == nullptr)
+		{
+			// nothing in flight, the whole ring is free
+			m_ringTail = m_ringHead;
+			break;
+		}
+		// the open batch of another thread, its space comes back once it
+		// was flushed
+		if (m_recording && oldest == &m_batches[m_currentBatch])
+		{
+			break;
+		}
+
+		const uint64_t completion = oldest->m_completionValue;
+		if (getCompletedValue() < completion)
+		{
+			// other threads may release or reuse it meanwhile, so the
+			// oldest batch is looked for again
+			lock.unlock();
+			wait({completion});
+			lock.lock();
+			continue;
+		}
+		releaseBatch(*oldest);
+	}
+}
+
+UploadToken UploadQueue::flush()
+{
+	std::unique_lock lock(m_mutex);
+	return flush(lock);
+}
+
+UploadToken UploadQueue::flush(std::unique_lock<std::mutex>& lock)
+{
+	if (!m_recording)
+	{
+		return {m_timelineValue};
+	}
+
+	Batch& batch = m_batches[m_currentBatch];
+	if (batch.m_closing)
+	{
+		// another thread is submitting it
+		m_batchChanged.wait(lock, [&batch] { return !batch.m_closing; });
+		return {batch.m_completionValue};
+	}
+
+	// copies from staging memory handed out before are queued first
+	batch.m_closing = true;
+	m_batchChanged.wait(lock, [&batch] { return batch.m_pins == 0; });
+
+	VkCommandBufferBeginInfo beginInfo =
+	vkinit::commandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	VkSemaphoreSubmitInfo copiesDone = vkinit::semaphoreSubmitInfo(
+	VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_transferTimeline);
+
+	if (hasTransferQueue())
+	{
+		// release everything written to the graphics family
+		VkDependencyInfo releaseInfo {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+		releaseInfo.bufferMemoryBarrierCount =
+		static_cast<uint32_t>(batch.m_bufferBarriers.size());
+		releaseInfo.pBufferMemoryBarriers = batch.m_bufferBarriers.data();
+		releaseInfo.imageMemoryBarrierCount =
+		static_cast<uint32_t>(batch.m_imageBarriers.size());
+		releaseInfo.pImageMemoryBarriers = batch.m_imageBarriers.data();
+		vkCmdPipelineBarrier2(batch.m_transferCmd, &releaseInfo);
+		VK_CHECK(vkEndCommandBuffer(batch.m_transferCmd));
+
+		copiesDone.value = ++m_transferTimelineValue;
+
+		VkCommandBufferSubmitInfo cmdInfo =
+		vkinit::commandBufferSubmitInfo(batch.m_transferCmd);
+		VkSubmitInfo2 submit = vkinit::submitInfo(&cmdInfo, &copiesDone, nullptr);
+		std::lock_guard queueLock(m_queueMutex);
+		VK_CHECK(vkQueueSubmit2(m_transferQueue, 1, &submit, VK_NULL_HANDLE));
+
+		// and acquire it with matching barriers
+		for (VkBufferMemoryBarrier2& barrier : batch.m_bufferBarriers)
+		{
+			barrier.srcStageMask  = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+		}
+		for (VkImageMemoryBarrier2& barrier : batch.m_imageBarriers)
+		{
+			barrier.srcStageMask  = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask =
+			VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+		}
+
+		VK_CHECK(vkBeginCommandBuffer(batch.m_graphicsCmd, &beginInfo));
+		VkDependencyInfo acquireInfo = releaseInfo;
+		vkCmdPipelineBarrier2(batch.m_graphicsCmd, &acquireInfo);
+	}
+	else
+	{
+		vkutil::memoryBarrier(batch.m_graphicsCmd,
+		                      VK_PIPELINE_STAGE_2_COPY_BIT,
+		                      VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		                      VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		                      VK_ACCESS_2_MEMORY_READ_BIT |
+		                      VK_ACCESS_2_MEMORY_WRITE_BIT);
+	}
+
+	for (auto& work : batch.m_graphicsWork)
+	{
+		work(batch.m_graphicsCmd);
+	}
+	VK_CHECK(vkEndCommandBuffer(batch.m_graphicsCmd));
+
+	VkSemaphoreSubmitInfo batchDone = vkinit::semaphoreSubmitInfo(
+	VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_timeline);
+	batchDone.value = ++m_timelineValue;
+
+	VkCommandBufferSubmitInfo cmdInfo =
+	vkinit::commandBufferSubmitInfo(batch.m_graphicsCmd);
+	VkSubmitInfo2 submit = vkinit::submitInfo(
+	&cmdInfo, &batchDone, hasTransferQueue() ? &copiesDone : nullptr);
+	{
+		std::lock_guard queueLock(m_queueMutex);
+		VK_CHECK(vkQueueSubmit2(m_graphicsQueue, 1, &submit, VK_NULL_HANDLE));
+	}
+
+	batch.m_completionValue = m_timelineValue;
+	batch.m_closing         = false;
+	m_currentBatch          = (m_currentBatch + 1) % BATCH_COUNT;
+	m_recording             = false;
+	m_batchChanged.notify_all();
+
+	return {m_timelineValue};
+}
+
+uint64_t UploadQueue::getCompletedValue() const
+{
+	uint64_t value = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline, &value));
+	return value;
+}
+
+bool UploadQueue::isComplete(UploadToken token) const
+{
+	return getCompletedValue() >= token.m_value;
+}
+
+void UploadQueue::wait(UploadToken token) const
+{
+	if (token.m_value == 0)
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores    = &m_timeline;
+	waitInfo.pValues        = &token.m_value;
+	VK_CHECK(vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX));
+}
+
+void UploadQueue::deferRelease(std::function<void()>&& release)
+{
+	// batches complete in order, so the open one finishes after everything
+	// queued before
+	std::unique_lock lock(m_mutex);
+	getOpenBatch(lock).m_releases.push_back(std::move(release));
+}
+
+void UploadQueue::collect()
+{
+	std::lock_guard lock(m_mutex);
+	const uint64_t  completed = getCompletedValue();
+	for (uint32_t i = 0; i < BATCH_COUNT; i++)
+	{
+		Batch& batch = m_batches[i];
+		if ((m_recording && i == m_currentBatch) ||
+		    (batch.m_staging.empty() && batch.m_ringEnd == 0 &&
+		     batch.m_releases.empty()) ||
+		    batch.m_completionValue > completed)
+		{
+			continue;
+		}
+		releaseBatch(batch);
+	}
+}
+
+VkSemaphoreSubmitInfo UploadQueue::getWaitInfo(VkPipelineStageFlags2 stageMask) const
+{
+	std::lock_guard       lock(m_mutex);
+	VkSemaphoreSubmitInfo waitInfo = vkinit::semaphoreSubmitInfo(stageMask, m_timeline);
+	waitInfo.value                 = m_timelineValue;
+	return waitInfo;
+}
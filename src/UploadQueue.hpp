@@ -0,0 +1,212 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// Mapped staging memory for one upload
+struct StagingAllocation
+{
+	VkBuffer     m_buffer {VK_NULL_HANDLE};
+	VkDeviceSize m_offset {0}; // copy source offset in m_buffer
+	void*        m_data {nullptr};
+	uint32_t     m_batch {0}; // the batch its copy is recorded into
+};
+
+// How the staging ring is doing
+struct StagingStats
+{
+	size_t   m_ringSize {0};
+	size_t   m_ringUsed {0}; // queued or in flight
+	size_t   m_peakRingUsed {0};
+	uint64_t m_ringAllocations {0};
+	uint64_t m_dedicatedAllocations {0}; // too large for the ring
+	uint64_t m_stalls {0}; // allocations that had to wait for the GPU
+};
+
+// Completes once the GPU finished every upload queued before it was handed
+// out, see UploadQueue::isComplete
+struct UploadToken
+{
+	uint64_t m_value {0};
+};
+
+// Batches copies from staging memory and submits them without waiting for
+// them on the CPU. Staging memory comes from a persistently mapped ring
+// buffer, whose regions are recycled once the batch that read them completed.
+// Copies run on a transfer-only queue family when the device has one, and the
+// buffers and images are handed over to the graphics family afterwards;
+// anything that needs the graphics queue (mip blits, the layout for sampling)
+// follows there. Every batch signals a timeline semaphore from the graphics
+// queue that graphics submissions reading uploaded data wait on, see
+// getWaitInfo. The transfer half signals a timeline of its own, values of one
+// timeline have to increase in submission order and two queues don't keep it.
+// Thread safe. Recording and submitting are guarded by one lock, held only as
+// long as a copy takes to record; staging memory is written without it. A
+// staging allocation pins its batch, which isn't submitted before the copy out
+// of it was queued.
+class UploadQueue
+{
+public:
+	void init(VkDevice     device,
+	          VmaAllocator allocator,
+	          VkQueue      graphicsQueue,
+	          uint32_t     graphicsQueueFamily,
+	          VkQueue      transferQueue,
+	          uint32_t     transferQueueFamily);
+
+	// Waits for the batches in flight
+	void cleanup();
+
+	// Staging memory for the next upload, valid until its batch completed.
+	// Every allocation is handed to exactly one copy, or to cancel, before
+	// the same thread allocates again. Uploads too large for the ring get a
+	// buffer of their own.
+	StagingAllocation allocateStaging(size_t size, size_t alignment = 16);
+	// Give up on a staging allocation without copying out of it
+	void cancel(const StagingAllocation& staging);
+
+	void copyBuffer(const StagingAllocation& staging,
+	                VkBuffer                 destination,
+	                const VkBufferCopy&      region);
+	// From a buffer other than staging memory, see deferRelease
+	void copyBuffer(VkBuffer source, VkBuffer destination, const VkBufferCopy& region);
+
+	// Copy into the levels of an image, which is left in
+	// TRANSFER_DST_OPTIMAL. finish runs on the graphics queue once the copy
+	// is done and has to move the image to its final layout.
+	void copyImage(const StagingAllocation&                  staging,
+	               VkImage                                   image,
+	               uint32_t                                  mipLevels,
+	               std::span<const VkBufferImageCopy>        regions,
+	               std::function<void(VkCommandBuffer cmd)>&& finish,
+	               uint32_t                                  layerCount = 1);
+
+	// Submit the queued uploads. Returns the token of the last batch, which
+	// is this one if anything was queued.
+	UploadToken flush();
+
+	bool isComplete(UploadToken token) const;
+	void wait(UploadToken token) const;
+
+	// Destroy the staging buffers of completed batches, once per frame is
+	// enough
+	void collect();
+
+	// Run release once every upload queued so far completed, for copy
+	// sources other than staging memory
+	void deferRelease(std::function<void()>&& release);
+
+	// Wait on every batch flushed so far, for graphics submissions
+	VkSemaphoreSubmitInfo getWaitInfo(VkPipelineStageFlags2 stageMask) const;
+
+	// Held around every other submission to the graphics queue and around
+	// present, Vulkan queues are externally synchronized
+	std::unique_lock<std::mutex> lockQueues()
+	{
+		return std::unique_lock(m_queueMutex);
+	}
+
+	StagingStats getStagingStats() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_stagingStats;
+	}
+
+	bool hasTransferQueue() const
+	{
+		return m_transferQueueFamily != m_graphicsQueueFamily;
+	}
+
+private:
+	// batches in flight before queueing more waits for the oldest
+	static constexpr uint32_t BATCH_COUNT = 4;
+
+	static constexpr size_t STAGING_RING_SIZE = 64 * 1024 * 1024;
+	// larger uploads get a dedicated staging buffer
+	static constexpr size_t MAX_RING_ALLOCATION = STAGING_RING_SIZE / 2;
+	// staging memory a batch collects before it gets flushed on its own
+	static constexpr size_t MAX_BATCH_STAGING_SIZE = STAGING_RING_SIZE / 2;
+
+	struct Batch
+	{
+		VkCommandPool   m_transferPool {VK_NULL_HANDLE};
+		VkCommandPool   m_graphicsPool {VK_NULL_HANDLE};
+		VkCommandBuffer m_transferCmd {VK_NULL_HANDLE};
+		VkCommandBuffer m_graphicsCmd {VK_NULL_HANDLE};
+
+		// timeline value signaled once the batch completed
+		uint64_t m_completionValue {0};
+
+		// ownership release barriers on the transfer queue, the graphics
+		// queue acquires with the same ones
+		std::vector<VkBufferMemoryBarrier2> m_bufferBarriers;
+		std::vector<VkImageMemoryBarrier2>  m_imageBarriers;
+
+		std::vector<std::function<void(VkCommandBuffer cmd)>> m_graphicsWork;
+		// dedicated staging buffers, and where the batch's ring
+		// allocations end
+		std::vector<AllocatedBuffer>                            m_staging;
+		size_t                                                  m_stagingSize {0};
+		uint64_t                                                m_ringEnd {0};
+		// see deferRelease
+		std::vector<std::function<void()>>                      m_releases;
+
+		// staging allocations whose copy isn't queued yet, and set while
+		// flush waits for them
+		uint32_t m_pins {0};
+		bool     m_closing {false};
+	};
+
+	// The rest expects m_mutex to be held. Whatever waits, on
+	// m_batchChanged or on the GPU, lets other threads in meanwhile.
+
+	// the batch to record into, started on first use. Waits while the
+	// current one is being flushed or still in flight.
+	Batch&      getOpenBatch(std::unique_lock<std::mutex>& lock);
+	UploadToken flush(std::unique_lock<std::mutex>& lock);
+	void        unpin(uint32_t batch);
+	void        releaseBatch(Batch& batch);
+	uint64_t    getCompletedValue() const;
+	// wait for batches in flight until the ring can hold an allocation
+	// ending at end
+	void reclaimRing(std::unique_lock<std::mutex>& lock, uint64_t end);
+	void recordBufferCopy(Batch&              batch,
+	                      VkBuffer            source,
+	                      VkBuffer            destination,
+	                      const VkBufferCopy& region);
+
+	VkDevice     m_device {VK_NULL_HANDLE};
+	VmaAllocator m_allocator {VK_NULL_HANDLE};
+	VkQueue      m_graphicsQueue {VK_NULL_HANDLE};
+	uint32_t     m_graphicsQueueFamily {0};
+	VkQueue      m_transferQueue {VK_NULL_HANDLE};
+	uint32_t     m_transferQueueFamily {0};
+
+	VkSemaphore m_timeline {VK_NULL_HANDLE};
+	uint64_t    m_timelineValue {0}; // last value a submission signals
+	// the copies of a batch on the transfer queue, only the batch's graphics
+	// submission waits on it
+	VkSemaphore m_transferTimeline {VK_NULL_HANDLE};
+	uint64_t    m_transferTimelineValue {0};
+
+	// ring positions only grow, the buffer offset is position % size. Head
+	// is where the next allocation goes, tail the oldest byte in use.
+	AllocatedBuffer m_stagingRing {};
+	uint64_t        m_ringHead {0};
+	uint64_t        m_ringTail {0};
+	StagingStats    m_stagingStats;
+
+	Batch    m_batches[BATCH_COUNT];
+	uint32_t m_currentBatch {0};
+	bool     m_recording {false};
+
+	mutable std::mutex      m_mutex;
+	std::condition_variable m_batchChanged; // pins dropped or a batch went
+	// every submission to the graphics and transfer queue, see lockQueues
+	std::mutex m_queueMutex;
+};
@@ -0,0 +1,169 @@
+#include <UploadStressTest.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// a mesh of GRID_SIZE x GRID_SIZE vertices, small enough that thousands
+	// of them fit a single page of the geometry arena
+	constexpr uint32_t GRID_SIZE   = 16;
+	constexpr size_t   BUFFER_SIZE = 16 * 1024;
+	constexpr uint32_t IMAGE_SIZE  = 64;
+	// one immediate submit per this many resources, for the per-thread pools
+	constexpr uint32_t SUBMIT_INTERVAL = 64;
+
+	// what one thread made, destroyed on the main thread afterwards
+	struct ThreadResources
+	{
+		std::vector<GPUMeshBuffers>  m_meshes;
+		std::vector<AllocatedBuffer> m_buffers;
+		std::vector<AllocatedImage>  m_images;
+		size_t                       m_bytes {0};
+	};
+
+	void createResources(ResourceManager& resources,
+	                     uint32_t         seed,
+	                     uint32_t         count,
+	                     ThreadResources& created)
+	{
+		// data differs per thread so nothing could be shared even if it went
+		// through the content hashed paths
+		std::vector<Vertex> vertices(GRID_SIZE * GRID_SIZE);
+		for (uint32_t i = 0; i < vertices.size(); i++)
+		{
+			Vertex& vertex    = vertices[i];
+			vertex.m_position = {float(i % GRID_SIZE), float(seed), float(i / GRID_SIZE)};
+			vertex.m_normal   = {0, 1, 0};
+			vertex.m_uv_x     = float(i % GRID_SIZE) / GRID_SIZE;
+			vertex.m_uv_y     = float(i / GRID_SIZE) / GRID_SIZE;
+			vertex.m_color    = glm::vec4 {1.f};
+			vertex.m_tangent  = {1, 0, 0, 1};
+		}
+
+		std::vector<uint32_t> indices;
+		indices.reserve((GRID_SIZE - 1) * (GRID_SIZE - 1) * 6);
+		for (uint32_t y = 0; y + 1 < GRID_SIZE; y++)
+		{
+			for (uint32_t x = 0; x + 1 < GRID_SIZE; x++)
+			{
+				const uint32_t corner = y * GRID_SIZE + x;
+				indices.insert(indices.end(),
+				               {corner,
+				                corner + GRID_SIZE,
+				                corner + 1,
+				                corner + 1,
+				                corner + GRID_SIZE,
+				                corner + GRID_SIZE + 1});
+			}
+		}
+
+		std::vector<std::byte> bufferData(BUFFER_SIZE, std::byte(seed));
+		std::vector<uint32_t>  texels(IMAGE_SIZE * IMAGE_SIZE, 0xff000000 | seed);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			switch (i % 3)
+			{
+				case 0:
+					created.m_meshes.push_back(resources.uploadMesh(indices, vertices));
+					created.m_bytes += vertices.size() * sizeof(Vertex) +
+					                   indices.size() * sizeof(uint32_t);
+					break;
+				case 1:
+					created.m_buffers.push_back(resources.createBuffer(
+					bufferData,
+					VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+					VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT));
+					created.m_bytes += bufferData.size();
+					break;
+				default:
+					created.m_images.push_back(
+					resources.createImage(texels.data(),
+					                      VkExtent3D {IMAGE_SIZE, IMAGE_SIZE, 1},
+					                      VK_FORMAT_R8G8B8A8_UNORM,
+					                      VK_IMAGE_USAGE_SAMPLED_BIT,
+					                      true));
+					created.m_bytes += texels.size() * sizeof(uint32_t);
+					break;
+			}
+
+			if (i % SUBMIT_INTERVAL == SUBMIT_INTERVAL - 1)
+			{
+				resources.immediateSubmit([](VkCommandBuffer) {});
+			}
+		}
+	}
+} // namespace
+
+UploadStressResult
+uploadstress::run(ResourceManager& resources, uint32_t threadCount, uint32_t perThread)
+{
+	UploadStressResult result;
+	result.m_threadCount = threadCount;
+
+	std::vector<ThreadResources> created(threadCount);
+	std::vector<std::thread>     threads;
+	threads.reserve(threadCount);
+
+	auto start = std::chrono::system_clock::now();
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back(createResources,
+		                     std::ref(resources),
+		                     i + 1,
+		                     perThread,
+		                     std::ref(created[i]));
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	auto queued = std::chrono::system_clock::now();
+
+	UploadQueue& uploads = resources.getUploadQueue();
+	uploads.wait(uploads.flush());
+	auto end = std::chrono::system_clock::now();
+
+	result.m_queueTime =
+	std::chrono::duration_cast<std::chrono::microseconds>(queued - start).count() /
+	1000.f;
+	result.m_totalTime =
+	std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() /
+	1000.f;
+
+	// the uploads are done, so nothing reads them anymore
+	for (const ThreadResources& thread : created)
+	{
+		for (const GPUMeshBuffers& mesh : thread.m_meshes)
+		{
+			resources.destroyMesh(mesh);
+		}
+		for (const AllocatedBuffer& buffer : thread.m_buffers)
+		{
+			resources.destroyBuffer(buffer);
+		}
+		for (const AllocatedImage& image : thread.m_images)
+		{
+			resources.destroyImage(image);
+		}
+
+		result.m_resourceCount += static_cast<uint32_t>(
+		thread.m_meshes.size() + thread.m_buffers.size() + thread.m_images.size());
+		result.m_bytes += thread.m_bytes;
+	}
+
+	const float seconds = result.m_totalTime / 1000.f;
+	fmt::print("Upload stress: {} resources ({:.1f} MB) from {} threads, queued "
+	           "in {:.2f} ms, done in {:.2f} ms ({:.0f} resources/s, {:.1f} MB/s)\n",
+	           result.m_resourceCount,
+	           result.m_bytes / (1024.f * 1024.f),
+	           threadCount,
+	           result.m_queueTime,
+	           result.m_totalTime,
+	           result.m_resourceCount / seconds,
+	           result.m_bytes / (1024.f * 1024.f) / seconds);
+	return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <ResourceManager.hpp>
+
+#include <cstdint>
+
+// Result of one stress run, for the stats window
+struct UploadStressResult
+{
+	uint32_t m_threadCount {0};
+	uint32_t m_resourceCount {0}; // meshes, buffers and images
+	size_t   m_bytes {0}; // uploaded data
+	float    m_queueTime {0}; // ms until every thread queued its uploads
+	float    m_totalTime {0}; // ms until the GPU finished them
+};
+
+// Exercises ResourceManager from several threads at once: each creates and
+// uploads its share of small meshes, buffers and images, with an immediate
+// submit now and then. Everything is destroyed again once the uploads
+// completed, so it can run with a scene loaded.
+namespace uploadstress
+{
+	UploadStressResult run(ResourceManager& resources, uint32_t threadCount, uint32_t perThread);
+} // namespace uploadstress
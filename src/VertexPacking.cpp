@@ -0,0 +1,111 @@
+#include <VertexPacking.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/packing.hpp>
+
+namespace
+{
+	// Half floats keep at least 1/1024 precision up to this magnitude, about a
+	// texel on a 1k texture
+	constexpr float PACKED_UV_LIMIT = 2.f;
+
+	constexpr float UNORM16_MAX = 65535.f;
+} // namespace
+
+bool vertexpack::canPack(std::span<const Vertex> vertices)
+{
+	for (const Vertex& v : vertices)
+	{
+		if (std::abs(v.m_uv_x) > PACKED_UV_LIMIT ||
+		    std::abs(v.m_uv_y) > PACKED_UV_LIMIT)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t vertexpack::encodeOctahedral(glm::vec3 direction)
+{
+	float length =
+	std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (length == 0.f)
+	{
+		// degenerate input (e.g. failed tangent generation), decodes to +Z
+		return 0;
+	}
+	direction /= length;
+
+	glm::vec2 encoded(direction.x, direction.y);
+	if (direction.z < 0.f)
+	{
+		// fold the lower hemisphere over the diagonals
+		glm::vec2 signs(direction.x >= 0.f ? 1.f : -1.f,
+		                direction.y >= 0.f ? 1.f : -1.f);
+		encoded = (1.f - glm::abs(glm::vec2(direction.y, direction.x))) * signs;
+	}
+
+	return glm::packSnorm2x16(encoded);
+}
+
+vertexpack::PackedMesh vertexpack::packVertices(std::span<const Vertex> vertices)
+{
+	PackedMesh packed;
+	if (vertices.empty())
+	{
+		return packed;
+	}
+
+	glm::vec3 minpos = vertices[0].m_position;
+	glm::vec3 maxpos = vertices[0].m_position;
+	bool      hasColor = false;
+	for (const Vertex& v : vertices)
+	{
+		minpos   = glm::min(minpos, v.m_position);
+		maxpos   = glm::max(maxpos, v.m_position);
+		hasColor = hasColor || v.m_color != glm::vec4(1.f);
+	}
+
+	glm::vec3 extent        = maxpos - minpos;
+	packed.m_positionOffset = minpos;
+	packed.m_positionScale  = extent / UNORM16_MAX;
+
+	// flat axes quantize to 0, avoid dividing by their zero extent
+	glm::vec3 quantizeScale(extent.x > 0.f ? UNORM16_MAX / extent.x : 0.f,
+	                        extent.y > 0.f ? UNORM16_MAX / extent.y : 0.f,
+	                        extent.z > 0.f ? UNORM16_MAX / extent.z : 0.f);
+
+	packed.m_vertices.resize(vertices.size());
+	if (hasColor)
+	{
+		packed.m_colors.resize(vertices.size());
+	}
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& v   = vertices[i];
+		PackedVertex& out = packed.m_vertices[i];
+
+		glm::vec3 q = glm::clamp(
+		glm::round((v.m_position - minpos) * quantizeScale), 0.f, UNORM16_MAX);
+
+		uint32_t handedness = v.m_tangent.w < 0.f ? 1u : 0u;
+
+		out.m_positionXY = uint32_t(q.x) | (uint32_t(q.y) << 16);
+		out.m_positionZ  = uint32_t(q.z) | (handedness << 16);
+		out.m_normal     = encodeOctahedral(v.m_normal);
+		out.m_tangent    = encodeOctahedral(glm::vec3(v.m_tangent));
+		out.m_uv         = glm::packHalf2x16(glm::vec2(v.m_uv_x, v.m_uv_y));
+
+		if (hasColor)
+		{
+			packed.m_colors[i] =
+			glm::packUnorm4x8(glm::clamp(v.m_color, 0.f, 1.f));
+		}
+	}
+
+	return packed;
+}
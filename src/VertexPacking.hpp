@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <span>
+#include <vector>
+
+// Conversion of full vertices into the compact PackedVertex layout
+namespace vertexpack
+{
+	// Result of packing one mesh
+	struct PackedMesh
+	{
+		std::vector<PackedVertex> m_vertices;
+		std::vector<uint32_t>     m_colors; // RGBA8, empty if all are white
+		glm::vec3                 m_positionScale {1.f};
+		glm::vec3                 m_positionOffset {0.f};
+	};
+
+	// Whether the packed layout can represent these vertices without visible
+	// loss. Half float uvs lose too much precision on heavily tiled meshes.
+	bool canPack(std::span<const Vertex> vertices);
+
+	PackedMesh packVertices(std::span<const Vertex> vertices);
+
+	// Octahedral mapping of a unit vector to snorm16x2
+	uint32_t encodeOctahedral(glm::vec3 direction);
+} // namespace vertexpack
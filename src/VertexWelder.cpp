@@ -0,0 +1,96 @@
+#include <VertexWelder.hpp>
+
+#include <Hash.hpp>
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+	// every attribute quantized to its tolerance grid
+	struct WeldKey
+	{
+		std::array<int64_t, 16> m_cells;
+
+		bool operator==(const WeldKey& other) const = default;
+	};
+
+	struct WeldKeyHash
+	{
+		size_t operator()(const WeldKey& key) const
+		{
+			return static_cast<size_t>(hashutil::xxhash64(
+			std::span<const int64_t>(key.m_cells.data(), key.m_cells.size())));
+		}
+	};
+
+	int64_t quantize(float value, float tolerance)
+	{
+		if (tolerance <= 0.f)
+		{
+			// exact match, but -0 and +0 are still the same value
+			return value == 0.f ? 0 : std::bit_cast<int32_t>(value);
+		}
+		return std::llround(value / tolerance);
+	}
+
+	WeldKey makeKey(const Vertex& v, const vertexweld::Tolerances& tolerances)
+	{
+		WeldKey key;
+		key.m_cells = {
+		quantize(v.m_position.x, tolerances.m_position),
+		quantize(v.m_position.y, tolerances.m_position),
+		quantize(v.m_position.z, tolerances.m_position),
+		quantize(v.m_normal.x, tolerances.m_normal),
+		quantize(v.m_normal.y, tolerances.m_normal),
+		quantize(v.m_normal.z, tolerances.m_normal),
+		quantize(v.m_uv_x, tolerances.m_uv),
+		quantize(v.m_uv_y, tolerances.m_uv),
+		quantize(v.m_tangent.x, tolerances.m_normal),
+		quantize(v.m_tangent.y, tolerances.m_normal),
+		quantize(v.m_tangent.z, tolerances.m_normal),
+		v.m_tangent.w < 0.f ? -1 : 1,
+		quantize(v.m_color.r, 1.f / 255.f),
+		quantize(v.m_color.g, 1.f / 255.f),
+		quantize(v.m_color.b, 1.f / 255.f),
+		quantize(v.m_color.a, 1.f / 255.f)};
+		return key;
+	}
+} // namespace
+
+size_t vertexweld::weldVertices(std::vector<Vertex>& vertices,
+                                std::span<uint32_t>  indices,
+                                const Tolerances&    tolerances)
+{
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> cells;
+	cells.reserve(vertices.size());
+
+	// the first vertex to land in a cell represents it
+	std::vector<uint32_t> remap(vertices.size());
+	uint32_t              keptCount = 0;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		auto [cell, inserted] =
+		cells.try_emplace(makeKey(vertices[i], tolerances), keptCount);
+		if (inserted)
+		{
+			vertices[keptCount++] = vertices[i];
+		}
+		remap[i] = cell->second;
+	}
+
+	const size_t removed = vertices.size() - keptCount;
+	if (removed == 0)
+	{
+		return 0;
+	}
+
+	vertices.resize(keptCount);
+	for (uint32_t& index : indices)
+	{
+		index = remap[index];
+	}
+	return removed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Types.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Merging of duplicated vertices, e.g. seams split per primitive or exact
+// copies written by exporters
+namespace vertexweld
+{
+	// Attributes closer than these are treated as equal, 0 only merges
+	// exact copies. Normals and tangents share the normal tolerance, colors
+	// always have to match to 8 bits.
+	struct Tolerances
+	{
+		float m_position = 1e-5f;
+		float m_normal   = 1e-3f;
+		float m_uv       = 1e-5f;
+	};
+
+	// Merge matching vertices and remap the indices to the ones that are
+	// kept. Vertices are hashed into a grid of tolerance sized cells, so
+	// two vertices straddling a cell border are left apart.
+	// Returns the number of vertices removed.
+	size_t weldVertices(std::vector<Vertex>& vertices,
+	                    std::span<uint32_t>  indices,
+	                    const Tolerances&    tolerances);
+} // namespace vertexweld